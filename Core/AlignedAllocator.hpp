@@ -11,6 +11,8 @@
 
 #include <vector>
 
+#include "LargePages.hpp"
+
 template <typename T, std::size_t Alignment>
 class aligned_allocator
 {
@@ -117,4 +119,50 @@ public:
 	// the STL headers, but that warning is useless.
 private:
 	aligned_allocator& operator=(const aligned_allocator&);
-};
\ No newline at end of file
+};
+
+/**
+* Variant for big buffers: allocations of at least Core::LargePageSize go to whole huge pages where the system has them,
+* smaller ones behave like aligned_allocator. Everything is counted in Core::GetAllocationStats.
+*/
+template <typename T, std::size_t Alignment>
+class large_page_allocator : public aligned_allocator<T, Alignment>
+{
+public:
+	template <typename U>
+	struct rebind
+	{
+		typedef large_page_allocator<U, Alignment> other;
+	};
+	large_page_allocator() { }
+	large_page_allocator(const large_page_allocator& other) : aligned_allocator<T, Alignment>(other) { }
+	template <typename U> large_page_allocator(const large_page_allocator<U, Alignment>& other) : aligned_allocator<T, Alignment>(other) { }
+	~large_page_allocator() { }
+	T * allocate(const std::size_t n) const
+	{
+		if (n == 0) {
+			return NULL;
+		}
+		if (n > this->max_size())
+		{
+			throw std::length_error("large_page_allocator<T>::allocate() - Integer overflow.");
+		}
+		void * const pv = Core::AllocateAligned(n * sizeof(T), Alignment);
+		if (pv == NULL)
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T *>(pv);
+	}
+	void deallocate(T * const p, const std::size_t n) const
+	{
+		Core::FreeAligned(p, n * sizeof(T));
+	}
+	template <typename U>
+	T * allocate(const std::size_t n, const U * /* const hint */) const
+	{
+		return allocate(n);
+	}
+private:
+	large_page_allocator& operator=(const large_page_allocator&);
+};
@@ -29,3 +29,30 @@ bool Core::BoundingBox::Contains(const BoundingBox & other) const
 			other.Min.Y >= Min.Y && other.Max.Y < Max.Y &&
 			other.Min.Z >= Min.Z && other.Max.Z < Max.Z);
 }
+
+bool Core::BoundingBox::Intersects(const BoundingBox & other) const
+{
+	return(	other.Min.X < Max.X && other.Max.X >= Min.X &&
+			other.Min.Y < Max.Y && other.Max.Y >= Min.Y &&
+			other.Min.Z < Max.Z && other.Max.Z >= Min.Z);
+}
+
+bool Core::BoundingBox::IntersectsRay(const Vector4& origin, const Vector4& inverseDirection, float maxDistance) const
+{
+	float entry = 0.0f;
+	float exit = maxDistance;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float slabEntry = (Min[axis] - origin[axis]) * inverseDirection[axis];
+		float slabExit = (Max[axis] - origin[axis]) * inverseDirection[axis];
+		if (slabEntry > slabExit)
+		{
+			std::swap(slabEntry, slabExit);
+		}
+
+		//argument order matters - a NaN from 0 * infinity (on a slab, parallel to it) leaves entry and exit alone
+		entry = std::max(entry, slabEntry);
+		exit = std::min(exit, slabExit);
+	}
+	return entry <= exit;
+}
\ No newline at end of file
@@ -14,6 +14,10 @@ namespace Core
 		bool Contains(const Vector4& point) const;
 		bool Contains(const Vector4& center, float radius) const;
 		bool Contains(const BoundingBox& other) const;
+		bool Intersects(const BoundingBox& other) const;
+
+		//slab test against origin + t * direction for t in [0, maxDistance], inverseDirection is 1 / direction per axis
+		bool IntersectsRay(const Vector4& origin, const Vector4& inverseDirection, float maxDistance) const;
 
 		Vector4 Min;
 		Vector4 Max;
@@ -0,0 +1,322 @@
+#include "LargePages.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <mm_malloc.h>
+#endif
+
+namespace Core
+{
+	enum class PageKind : unsigned char
+	{
+		Huge,
+		TransparentHuge,
+		Regular
+	};
+
+	struct LargeAllocation
+	{
+		size_t MappedBytes;
+		PageKind Kind;
+	};
+
+	//large allocations are few and big, so a locked map of them is cheap - small ones only touch the counters
+	struct AllocationRegistry
+	{
+		std::atomic<size_t> BytesAllocated;
+		std::atomic<size_t> PeakBytesAllocated;
+		std::atomic<size_t> NumAllocations;
+		std::atomic<size_t> HugePageBytes;
+		std::atomic<size_t> TransparentHugePageBytes;
+		std::atomic<size_t> NumLargePageFallbacks;
+
+		std::mutex LargeAllocationsMutex;
+		std::unordered_map<void*, LargeAllocation> LargeAllocations;
+
+		AllocationRegistry() :
+			BytesAllocated(0),
+			PeakBytesAllocated(0),
+			NumAllocations(0),
+			HugePageBytes(0),
+			TransparentHugePageBytes(0),
+			NumLargePageFallbacks(0)
+		{}
+	};
+
+	//function-local so it's there for allocations made during static initialization
+	static AllocationRegistry& GetRegistry()
+	{
+		static AllocationRegistry registry;
+		return registry;
+	}
+
+	struct OfferedAllocation
+	{
+		void* Pointer;
+		size_t Bytes;
+	};
+
+	//only ever one, taken by the next allocation of its size on the thread that offered it
+	static thread_local OfferedAllocation Offer = { nullptr, 0 };
+
+	static size_t RoundUp(size_t Value, size_t Multiple)
+	{
+		return (Value + Multiple - 1) / Multiple * Multiple;
+	}
+
+#ifdef _WIN32
+
+	//MEM_LARGE_PAGES needs the lock pages privilege enabled in the process token, not just granted to the account
+	static bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		{
+			return false;
+		}
+
+		TOKEN_PRIVILEGES privileges;
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		//AdjustTokenPrivileges succeeds without enabling anything if the account doesn't hold it, only the last error tells
+		const bool bEnabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+			&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+			&& GetLastError() == ERROR_SUCCESS;
+		CloseHandle(token);
+		return bEnabled;
+	}
+
+	//set after the first large page allocation that fails, they won't be getting any more available than that
+	static std::atomic<bool> bLargePagesFailed(false);
+
+	static void* MapLargePages(size_t Bytes, LargeAllocation& OutAllocation)
+	{
+		//enabled once, on the first large allocation rather than at startup for programs that never make one
+		static const bool bLockMemoryPrivilege = EnableLockMemoryPrivilege();
+
+		const size_t largePageMinimum = GetLargePageMinimum();
+		if (bLockMemoryPrivilege && largePageMinimum != 0 && !bLargePagesFailed)
+		{
+			OutAllocation.MappedBytes = RoundUp(Bytes, largePageMinimum);
+			OutAllocation.Kind = PageKind::Huge;
+			void* pointer = VirtualAlloc(nullptr, OutAllocation.MappedBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (pointer != nullptr)
+			{
+				return pointer;
+			}
+			bLargePagesFailed = true;
+		}
+
+		//no transparent huge pages on Windows, regular ones it is
+		OutAllocation.MappedBytes = Bytes;
+		OutAllocation.Kind = PageKind::Regular;
+		return VirtualAlloc(nullptr, OutAllocation.MappedBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+
+	static void UnmapLargePages(void* Pointer, const LargeAllocation& Allocation)
+	{
+		(void)Allocation; //the whole reservation goes at once
+		VirtualFree(Pointer, 0, MEM_RELEASE);
+	}
+
+#else
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+	static void* MapLargePages(size_t Bytes, LargeAllocation& OutAllocation)
+	{
+		OutAllocation.MappedBytes = RoundUp(Bytes, LargePageSize);
+
+#ifdef MAP_HUGETLB
+		//only succeeds if huge pages were reserved up front (vm.nr_hugepages)
+		void* pointer = mmap(nullptr, OutAllocation.MappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+		if (pointer != MAP_FAILED)
+		{
+			OutAllocation.Kind = PageKind::Huge;
+			return pointer;
+		}
+#endif
+
+		//map a page extra so the start can be moved up to a 2MB boundary, otherwise the kernel can't use huge pages for the first part
+		unsigned char* raw = static_cast<unsigned char*>(mmap(nullptr, OutAllocation.MappedBytes + LargePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (raw == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		unsigned char* aligned = reinterpret_cast<unsigned char*>(RoundUp(reinterpret_cast<uintptr_t>(raw), LargePageSize));
+		if (aligned != raw)
+		{
+			munmap(raw, aligned - raw);
+		}
+		munmap(aligned + OutAllocation.MappedBytes, raw + LargePageSize - aligned);
+
+		OutAllocation.Kind = PageKind::Regular;
+#ifdef MADV_HUGEPAGE
+		if (madvise(aligned, OutAllocation.MappedBytes, MADV_HUGEPAGE) == 0)
+		{
+			OutAllocation.Kind = PageKind::TransparentHuge;
+		}
+#endif
+		return aligned;
+	}
+
+	static void UnmapLargePages(void* Pointer, const LargeAllocation& Allocation)
+	{
+		munmap(Pointer, Allocation.MappedBytes);
+	}
+
+#endif
+
+	static void CountPages(AllocationRegistry& Registry, const LargeAllocation& Allocation, bool bAllocated)
+	{
+		std::atomic<size_t>* counter = nullptr;
+		switch (Allocation.Kind)
+		{
+		case PageKind::Huge:
+			counter = &Registry.HugePageBytes;
+			break;
+		case PageKind::TransparentHuge:
+			counter = &Registry.TransparentHugePageBytes;
+			break;
+		case PageKind::Regular:
+			break;
+		}
+
+		if (counter != nullptr)
+		{
+			if (bAllocated)
+			{
+				*counter += Allocation.MappedBytes;
+			}
+			else
+			{
+				*counter -= Allocation.MappedBytes;
+			}
+		}
+	}
+
+	void* AllocateAligned(size_t Bytes, size_t Alignment)
+	{
+		//already counted when it was first allocated
+		if (Offer.Pointer != nullptr && Offer.Bytes == Bytes)
+		{
+			void* offered = Offer.Pointer;
+			Offer.Pointer = nullptr;
+			return offered;
+		}
+
+		AllocationRegistry& registry = GetRegistry();
+
+		void* pointer = nullptr;
+		if (Bytes >= LargePageSize)
+		{
+			//pages are aligned to at least 4KB, which covers any alignment anything here asks for
+			LargeAllocation allocation;
+			pointer = MapLargePages(Bytes, allocation);
+			if (pointer == nullptr)
+			{
+				return nullptr;
+			}
+			if (allocation.Kind == PageKind::Regular)
+			{
+				++registry.NumLargePageFallbacks;
+			}
+			CountPages(registry, allocation, true);
+
+			registry.LargeAllocationsMutex.lock();
+			registry.LargeAllocations[pointer] = allocation;
+			registry.LargeAllocationsMutex.unlock();
+		}
+		else
+		{
+			pointer = _mm_malloc(Bytes, Alignment);
+			if (pointer == nullptr)
+			{
+				return nullptr;
+			}
+		}
+
+		++registry.NumAllocations;
+		const size_t bytesAllocated = registry.BytesAllocated += Bytes;
+		size_t peak = registry.PeakBytesAllocated;
+		while (bytesAllocated > peak && !registry.PeakBytesAllocated.compare_exchange_weak(peak, bytesAllocated))
+		{
+		}
+		return pointer;
+	}
+
+	void FreeAligned(void* Pointer, size_t Bytes)
+	{
+		if (Pointer == nullptr)
+		{
+			return;
+		}
+
+		AllocationRegistry& registry = GetRegistry();
+		registry.BytesAllocated -= Bytes;
+
+		if (Bytes >= LargePageSize)
+		{
+			registry.LargeAllocationsMutex.lock();
+			auto found = registry.LargeAllocations.find(Pointer);
+			const LargeAllocation allocation = found->second;
+			registry.LargeAllocations.erase(found);
+			registry.LargeAllocationsMutex.unlock();
+
+			CountPages(registry, allocation, false);
+			UnmapLargePages(Pointer, allocation);
+		}
+		else
+		{
+			_mm_free(Pointer);
+		}
+	}
+
+	void OfferAllocation(void* Pointer, size_t Bytes)
+	{
+		WithdrawAllocation();
+		Offer.Pointer = Pointer;
+		Offer.Bytes = Bytes;
+	}
+
+	bool WithdrawAllocation()
+	{
+		if (Offer.Pointer == nullptr)
+		{
+			return true;
+		}
+
+		FreeAligned(Offer.Pointer, Offer.Bytes);
+		Offer.Pointer = nullptr;
+		return false;
+	}
+
+	AllocationStats GetAllocationStats()
+	{
+		AllocationRegistry& registry = GetRegistry();
+
+		AllocationStats stats;
+		stats.BytesAllocated = registry.BytesAllocated;
+		stats.PeakBytesAllocated = registry.PeakBytesAllocated;
+		stats.NumAllocations = registry.NumAllocations;
+		stats.HugePageBytes = registry.HugePageBytes;
+		stats.TransparentHugePageBytes = registry.TransparentHugePageBytes;
+		stats.NumLargePageFallbacks = registry.NumLargePageFallbacks;
+		return stats;
+	}
+}
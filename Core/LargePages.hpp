@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Core
+{
+	//allocations at least this big are given whole 2MB pages, smaller ones go to _mm_malloc as usual
+	static const size_t LargePageSize = 2 * 1024 * 1024;
+
+	//Totals for everything that went through AllocateAligned, in requested bytes except where it says pages.
+	struct AllocationStats
+	{
+		size_t BytesAllocated;
+		size_t PeakBytesAllocated;
+		size_t NumAllocations; //so far, not live
+		//live, rounded up to whole pages - explicit huge pages, and regular pages the kernel was asked to back with transparent ones
+		size_t HugePageBytes;
+		size_t TransparentHugePageBytes;
+		//large allocations that ended up on regular pages
+		size_t NumLargePageFallbacks;
+	};
+
+	//Alignment up to LargePageSize. Large allocations try explicit huge pages first (MAP_HUGETLB, or MEM_LARGE_PAGES, which needs
+	//the lock pages privilege - enabled on the first large allocation, and after one failure Windows doesn't try them again),
+	//then regular pages marked for transparent huge pages where there are any. Null on failure.
+	void* AllocateAligned(size_t Bytes, size_t Alignment);
+	//Bytes has to match the allocation, it decides which way it was allocated
+	void FreeAligned(void* Pointer, size_t Bytes);
+
+	//Hands Pointer, from AllocateAligned(Bytes, ...), to the next AllocateAligned call on this thread for Bytes instead of new
+	//memory - for storage prepared before a container allocates it, like pages faulted in from other threads. The alignment
+	//isn't checked, offer it to the same allocator it came from.
+	void OfferAllocation(void* Pointer, size_t Bytes);
+	//frees the offered allocation if nothing took it, and returns false then
+	bool WithdrawAllocation();
+
+	AllocationStats GetAllocationStats();
+}
@@ -0,0 +1,142 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Core::MappedFile::MappedFile() :
+	Data(nullptr),
+	Size(0)
+#ifdef _WIN32
+	, FileHandle(INVALID_HANDLE_VALUE),
+	MappingHandle(nullptr)
+#endif
+{}
+
+Core::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool Core::MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	FileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (FileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(FileHandle, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!MappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	Data = static_cast<const unsigned char*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!Data)
+	{
+		Close();
+		return false;
+	}
+
+	Size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void Core::MappedFile::Close()
+{
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (MappingHandle)
+	{
+		CloseHandle(MappingHandle);
+	}
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(FileHandle);
+	}
+
+	Data = nullptr;
+	Size = 0;
+	FileHandle = INVALID_HANDLE_VALUE;
+	MappingHandle = nullptr;
+}
+
+#else
+
+bool Core::MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	//the mapping keeps the file alive, so the descriptor isn't needed past this function
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+
+	//it's read front to back once on load
+	madvise(mapped, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+	Data = static_cast<const unsigned char*>(mapped);
+	Size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void Core::MappedFile::Close()
+{
+	if (Data)
+	{
+		munmap(const_cast<unsigned char*>(Data), Size);
+	}
+
+	Data = nullptr;
+	Size = 0;
+}
+
+#endif
+
+const unsigned char* Core::MappedFile::GetData() const
+{
+	return Data;
+}
+
+size_t Core::MappedFile::GetSize() const
+{
+	return Size;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Core
+{
+	//Read-only view of a whole file mapped into memory, unmapped on destruction.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+		~MappedFile();
+
+		//false if the file can't be opened or mapped (an empty file can't be mapped either)
+		bool Open(const std::string& path);
+		void Close();
+
+		//page aligned, null while nothing is mapped
+		const unsigned char* GetData() const;
+		size_t GetSize() const;
+
+	private:
+		const unsigned char* Data;
+		size_t Size;
+#ifdef _WIN32
+		void* FileHandle;
+		void* MappingHandle;
+#endif
+	};
+}
@@ -137,6 +137,11 @@ namespace Core
 			return Rows[index];
 		}
 
+		const Vector4& operator [] (const int index) const
+		{
+			return Rows[index];
+		}
+
 		Vector4* begin()
 		{
 			return &Rows[0];
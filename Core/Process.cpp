@@ -0,0 +1,99 @@
+#include "Process.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+namespace Core
+{
+#ifdef _WIN32
+
+	unsigned long long LaunchSelf(const std::vector<std::string>& Arguments)
+	{
+		char path[MAX_PATH];
+		const DWORD pathLength = GetModuleFileNameA(nullptr, path, MAX_PATH);
+		if (pathLength == 0 || pathLength == MAX_PATH)
+		{
+			return 0;
+		}
+
+		//one command line, quoted so paths with spaces survive
+		std::string commandLine = "\"" + std::string(path) + "\"";
+		for (const std::string& argument : Arguments)
+		{
+			commandLine += " \"" + argument + "\"";
+		}
+
+		STARTUPINFOA startupInfo = {};
+		startupInfo.cb = sizeof(startupInfo);
+		PROCESS_INFORMATION processInfo = {};
+		if (!CreateProcessA(path, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+		{
+			return 0;
+		}
+
+		CloseHandle(processInfo.hThread);
+		return reinterpret_cast<unsigned long long>(processInfo.hProcess);
+	}
+
+	int WaitForProcess(unsigned long long Process)
+	{
+		const HANDLE process = reinterpret_cast<HANDLE>(Process);
+		DWORD exitCode = 0;
+		const bool bExited = WaitForSingleObject(process, INFINITE) == WAIT_OBJECT_0 && GetExitCodeProcess(process, &exitCode);
+		CloseHandle(process);
+		return bExited ? static_cast<int>(exitCode) : -1;
+	}
+
+	unsigned long long GetCurrentProcessNumber()
+	{
+		return GetCurrentProcessId();
+	}
+
+#else
+
+	unsigned long long LaunchSelf(const std::vector<std::string>& Arguments)
+	{
+		//linux keeps a link to the running executable
+		const char* path = "/proc/self/exe";
+
+		std::vector<char*> argv;
+		argv.push_back(const_cast<char*>(path));
+		for (const std::string& argument : Arguments)
+		{
+			argv.push_back(const_cast<char*>(argument.c_str()));
+		}
+		argv.push_back(nullptr);
+
+		pid_t process;
+		if (posix_spawn(&process, path, nullptr, nullptr, argv.data(), environ) != 0)
+		{
+			return 0;
+		}
+		return static_cast<unsigned long long>(process);
+	}
+
+	int WaitForProcess(unsigned long long Process)
+	{
+		int status = 0;
+		if (waitpid(static_cast<pid_t>(Process), &status, 0) < 0 || !WIFEXITED(status))
+		{
+			return -1;
+		}
+		return WEXITSTATUS(status);
+	}
+
+	unsigned long long GetCurrentProcessNumber()
+	{
+		return static_cast<unsigned long long>(getpid());
+	}
+
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Core
+{
+	//Another copy of the running executable, started with arguments (not counting the program name).
+	//Returns an id for WaitForProcess, or 0 if it couldn't be started.
+	unsigned long long LaunchSelf(const std::vector<std::string>& Arguments);
+
+	//blocks until the process exits and returns its exit code, -1 if it couldn't be waited on or didn't exit normally
+	int WaitForProcess(unsigned long long Process);
+
+	//id of the current process, for names that have to be unique on the machine
+	unsigned long long GetCurrentProcessNumber();
+}
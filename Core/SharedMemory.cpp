@@ -0,0 +1,190 @@
+#include "SharedMemory.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Core::SharedMemory::SharedMemory() :
+	Data(nullptr),
+	Size(0),
+	bOwner(false)
+#ifdef _WIN32
+	, MappingHandle(nullptr)
+#endif
+{}
+
+Core::SharedMemory::~SharedMemory()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool Core::SharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	const unsigned long long fullSize = size;
+	MappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(fullSize >> 32), static_cast<DWORD>(fullSize), name.c_str());
+	if (!MappingHandle || GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		Close();
+		return false;
+	}
+
+	//pagefile backed mappings start out zeroed, and live as long as any process has them open, so there's no name to remove
+	Data = MapViewOfFile(MappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!Data)
+	{
+		Close();
+		return false;
+	}
+
+	Size = size;
+	Name = name;
+	bOwner = true;
+	return true;
+}
+
+bool Core::SharedMemory::Open(const std::string& name, size_t size)
+{
+	Close();
+
+	MappingHandle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	if (MappingHandle)
+	{
+		Data = MapViewOfFile(MappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	}
+	if (!Data)
+	{
+		Close();
+		return false;
+	}
+
+	Size = size;
+	Name = name;
+	return true;
+}
+
+void Core::SharedMemory::Close()
+{
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (MappingHandle)
+	{
+		CloseHandle(MappingHandle);
+	}
+
+	Data = nullptr;
+	Size = 0;
+	Name.clear();
+	bOwner = false;
+	MappingHandle = nullptr;
+}
+
+#else
+
+//POSIX names want a single leading slash
+static std::string GetObjectName(const std::string& name)
+{
+	return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+bool Core::SharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	const std::string objectName = GetObjectName(name);
+	const int file = shm_open(objectName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	//a new object is zero length, growing it fills it with zeros
+	void* mapped = MAP_FAILED;
+	if (ftruncate(file, static_cast<off_t>(size)) == 0)
+	{
+		mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	}
+	close(file);
+	if (mapped == MAP_FAILED)
+	{
+		shm_unlink(objectName.c_str());
+		return false;
+	}
+
+	Data = mapped;
+	Size = size;
+	Name = objectName;
+	bOwner = true;
+	return true;
+}
+
+bool Core::SharedMemory::Open(const std::string& name, size_t size)
+{
+	Close();
+
+	const std::string objectName = GetObjectName(name);
+	const int file = shm_open(objectName.c_str(), O_RDWR, 0600);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	void* mapped = MAP_FAILED;
+	if (fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) == size)
+	{
+		mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	}
+	close(file);
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+
+	Data = mapped;
+	Size = size;
+	Name = objectName;
+	return true;
+}
+
+void Core::SharedMemory::Close()
+{
+	if (Data)
+	{
+		munmap(Data, Size);
+	}
+	//anyone still mapping it keeps their view, the name is just gone
+	if (bOwner)
+	{
+		shm_unlink(Name.c_str());
+	}
+
+	Data = nullptr;
+	Size = 0;
+	Name.clear();
+	bOwner = false;
+}
+
+#endif
+
+void* Core::SharedMemory::GetData() const
+{
+	return Data;
+}
+
+size_t Core::SharedMemory::GetSize() const
+{
+	return Size;
+}
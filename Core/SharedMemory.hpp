@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Core
+{
+	//Named block of memory shared between processes on the same machine, zero filled when created.
+	//The creator removes the name on Close, processes that opened it only unmap.
+	class SharedMemory
+	{
+	public:
+		SharedMemory();
+		SharedMemory(const SharedMemory& other) = delete;
+		SharedMemory& operator=(const SharedMemory& other) = delete;
+		~SharedMemory();
+
+		//false if the name is already taken or the memory can't be had
+		bool Create(const std::string& name, size_t size);
+		//size has to match the creator's
+		bool Open(const std::string& name, size_t size);
+		void Close();
+
+		//page aligned, null while nothing is mapped
+		void* GetData() const;
+		size_t GetSize() const;
+
+	private:
+		void* Data;
+		size_t Size;
+		std::string Name;
+		bool bOwner;
+#ifdef _WIN32
+		void* MappingHandle;
+#endif
+	};
+}
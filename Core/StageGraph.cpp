@@ -0,0 +1,148 @@
+#include "StageGraph.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Core
+{
+	StageGraph::StageGraph(unsigned int NumHelperThreads) :
+		NumFinishedStages(0),
+		bRunning(false),
+		bShutdown(false)
+	{
+		for (unsigned int thread = 0; thread < NumHelperThreads; ++thread)
+		{
+			HelperThreads.push_back(std::thread(&StageGraph::ThreadWork, this));
+		}
+	}
+
+	StageGraph::~StageGraph()
+	{
+		bShutdown = true;
+		for (auto& thread : HelperThreads)
+		{
+			thread.join();
+		}
+	}
+
+	static bool SharesResource(const std::vector<unsigned int>& A, const std::vector<unsigned int>& B)
+	{
+		return std::any_of(A.begin(), A.end(), [&B](unsigned int resource) { return std::find(B.begin(), B.end(), resource) != B.end(); });
+	}
+
+	size_t StageGraph::AddStage(const std::string& Name, std::initializer_list<unsigned int> Reads, std::initializer_list<unsigned int> Writes, std::function<void()> Function)
+	{
+		Stage stage;
+		stage.Name = Name;
+		stage.Reads = Reads;
+		stage.Writes = Writes;
+		stage.Function = Function;
+		stage.NumWaiting = 0;
+		stage.Seconds = 0.0;
+
+		const size_t index = Stages.size();
+		for (size_t earlier = 0; earlier < index; ++earlier)
+		{
+			Stage& other = Stages[earlier];
+			if (SharesResource(other.Writes, stage.Reads) || SharesResource(other.Writes, stage.Writes) || SharesResource(other.Reads, stage.Writes))
+			{
+				stage.Dependencies.push_back(earlier);
+				other.Dependents.push_back(index);
+			}
+		}
+
+		Stages.push_back(stage);
+		return index;
+	}
+
+	void StageGraph::Run()
+	{
+		ReadyMutex.lock();
+		ReadyStages.clear();
+		for (size_t stage = 0; stage < Stages.size(); ++stage)
+		{
+			Stages[stage].NumWaiting = Stages[stage].Dependencies.size();
+			if (Stages[stage].NumWaiting == 0)
+			{
+				ReadyStages.push_back(stage);
+			}
+		}
+		NumFinishedStages = 0;
+		ReadyMutex.unlock();
+
+		//this thread works through the graph too, the helpers only pick up what's ready alongside it
+		bRunning = true;
+		while (NumFinishedStages < Stages.size())
+		{
+			if (!RunReadyStage())
+			{
+				std::this_thread::yield();
+			}
+		}
+		bRunning = false;
+	}
+
+	bool StageGraph::RunReadyStage()
+	{
+		//earliest first, it's the one most likely to be holding up the rest
+		ReadyMutex.lock();
+		if (ReadyStages.empty())
+		{
+			ReadyMutex.unlock();
+			return false;
+		}
+		auto earliest = std::min_element(ReadyStages.begin(), ReadyStages.end());
+		const size_t index = *earliest;
+		ReadyStages.erase(earliest);
+		ReadyMutex.unlock();
+
+		Stage& stage = Stages[index];
+		const auto start = std::chrono::high_resolution_clock::now();
+		stage.Function();
+		stage.Seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		ReadyMutex.lock();
+		for (size_t dependent : stage.Dependents)
+		{
+			if (--Stages[dependent].NumWaiting == 0)
+			{
+				ReadyStages.push_back(dependent);
+			}
+		}
+		ReadyMutex.unlock();
+
+		++NumFinishedStages;
+		return true;
+	}
+
+	void StageGraph::ThreadWork()
+	{
+		while (!bShutdown)
+		{
+			if (!bRunning || !RunReadyStage())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	size_t StageGraph::GetNumStages() const
+	{
+		return Stages.size();
+	}
+
+	const std::string& StageGraph::GetStageName(size_t Stage) const
+	{
+		return Stages[Stage].Name;
+	}
+
+	const std::vector<size_t>& StageGraph::GetDependencies(size_t Stage) const
+	{
+		return Stages[Stage].Dependencies;
+	}
+
+	double StageGraph::GetStageSeconds(size_t Stage) const
+	{
+		return Stages[Stage].Seconds;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <initializer_list>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace Core
+{
+	//A fixed pipeline of stages, each declaring the resources (any numbers the owner picks for its data) it reads and writes.
+	//A stage depends on every earlier one that writes something it reads or writes, and every earlier one that reads something
+	//it writes, so a run gives the same results as calling the stages in the order they were added - but stages that don't
+	//share anything run at the same time, without a barrier between every step.
+	class StageGraph
+	{
+	public:
+		//NumHelperThreads run stages alongside the thread calling Run, waiting in between like Task's workers
+		StageGraph(unsigned int NumHelperThreads = 1);
+		StageGraph(const StageGraph& other) = delete;
+		StageGraph& operator=(const StageGraph& other) = delete;
+		~StageGraph();
+
+		//only add stages between runs, returns the new stage's index
+		size_t AddStage(const std::string& Name, std::initializer_list<unsigned int> Reads, std::initializer_list<unsigned int> Writes, std::function<void()> Function);
+
+		//every stage once, returns when they've all finished
+		void Run();
+
+		size_t GetNumStages() const;
+		const std::string& GetStageName(size_t Stage) const;
+		//the earlier stages this one waits for
+		const std::vector<size_t>& GetDependencies(size_t Stage) const;
+		//how long the stage took in the last run
+		double GetStageSeconds(size_t Stage) const;
+
+	private:
+
+		struct Stage
+		{
+			std::string Name;
+			std::vector<unsigned int> Reads;
+			std::vector<unsigned int> Writes;
+			std::function<void()> Function;
+			std::vector<size_t> Dependencies;
+			std::vector<size_t> Dependents;
+			//dependencies still running in the current run
+			size_t NumWaiting;
+			double Seconds;
+		};
+
+		//false if nothing was ready
+		bool RunReadyStage();
+		void ThreadWork();
+
+		std::vector<Stage> Stages;
+
+		//lock when touching the ready list or the waiting counts
+		std::mutex ReadyMutex;
+		std::vector<size_t> ReadyStages;
+		std::atomic<size_t> NumFinishedStages;
+
+		std::vector<std::thread> HelperThreads;
+		std::atomic<bool> bRunning;
+		std::atomic<bool> bShutdown;
+	};
+}
@@ -2,6 +2,11 @@
 
 #include <vector>
 #include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+#include "Topology.hpp"
 
 //a pool of threads dedicated to running a particular function on input and output buffers of data
 template <class InputDataContainerType, class OutputDataContainerType, class FunctionType, class ExtraObjectType>
@@ -10,16 +15,25 @@ class Task
 public:
 	//double-pointers so the application can manage which buffers we read/write
 	Task(unsigned int NumThreads, InputDataContainerType** InInputBuffer, OutputDataContainerType** InOutputBuffer, ExtraObjectType* ExtraObject)
-		:	InputBuffer(InInputBuffer),
-			OutputBuffer(InOutputBuffer),
+		:	Ranges(new WorkRange[NumThreads > 0 ? NumThreads : 1]),
+			NumRanges(1),
+			bPartitioned(false),
+			bCostBalanced(false),
+			NumChunks(0),
+			NumItems(0),
 			bShutdown(false),
-			bFinished(false),
 			bDoWork(false),
-			CurrentDataIndex(0)
+			NumActiveThreads(0),
+			NumCompletedItems(0),
+			NumShutdownThreads(0),
+			PinGeneration(0),
+			NumPinnedThreads(0),
+			InputBuffer(InInputBuffer),
+			OutputBuffer(InOutputBuffer)
 	{
-		for (size_t threadIndex = 0; threadIndex < NumThreads; ++threadIndex)
+		for (unsigned int threadIndex = 0; threadIndex < NumThreads; ++threadIndex)
 		{
-			BackgroundThreads.push_back(std::thread(&Task::ThreadWork, this, ExtraObject));
+			BackgroundThreads.push_back(std::thread(&Task::ThreadWork, this, threadIndex, ExtraObject));
 		}
 
 		for (auto& thread : BackgroundThreads)
@@ -42,49 +56,188 @@ public:
 	//manage flags to make threads iterate through data buffer and do work, returns when finished
 	void Work()
 	{
-		CurrentDataIndex = 0;
-		bFinished = false;
+		const size_t numItems = (**InputBuffer).size();
+
+		//nobody is left in the last call's loop once this is zero, so the ranges are safe to reset
+		while (NumActiveThreads > 0)
+		{
+			std::this_thread::yield();
+		}
+
+		NumCompletedItems = 0;
+		NumItems = numItems;
+		if (bCostBalanced && !BackgroundThreads.empty())
+		{
+			SplitChunksByCost(numItems);
+		}
+		else
+		{
+			const size_t numRanges = bPartitioned && !BackgroundThreads.empty() ? BackgroundThreads.size() : 1;
+			for (size_t range = 0; range < numRanges; ++range)
+			{
+				Ranges[range].NextIndex = numItems * range / numRanges;
+				Ranges[range].EndIndex = numItems * (range + 1) / numRanges;
+			}
+			NumRanges = numRanges;
+			NumChunks = 0;
+		}
 		bDoWork = true;
-		while (!bFinished)
+
+		//wait until every item has finished, not just been handed out - the last index can complete before earlier ones
+		while (NumCompletedItems < numItems)
 		{
 			std::this_thread::yield();
 		}
 		bDoWork = false;
 	}
 
+	//Partitioned, each thread starts on its own contiguous slice of the items and only moves on to the others' once it's
+	//done, so the same thread keeps coming back to the same part of the data every call. Otherwise items go to whoever
+	//asks next. Only change it between calls to Work.
+	void SetPartitioned(bool partitioned)
+	{
+		bPartitioned = partitioned;
+	}
+
+	//Cost balanced, the items are grouped into a fixed number of contiguous chunks, each timed as it runs. The next call
+	//splits the chunks between the threads so each one's share took about the same time last call, and threads move on
+	//to each other's chunks only once they're through their own. For items whose cost varies with where they are, as
+	//long as their order stays roughly the same between calls. Overrides partitioned. Only change it between calls to Work.
+	void SetCostBalanced(bool costBalanced)
+	{
+		bCostBalanced = costBalanced;
+	}
+
+	//pins thread i to Cores[i], or unpins every thread if Cores is empty - returns once they all have
+	void SetThreadCores(const std::vector<unsigned int>& Cores)
+	{
+		//threads only read the list after seeing a new generation, and the last change waited for all of them to read it
+		ThreadCores = Cores;
+		NumPinnedThreads = 0;
+		++PinGeneration;
+
+		while (NumPinnedThreads < BackgroundThreads.size())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	unsigned int GetNumThreads() const
+	{
+		return static_cast<unsigned int>(BackgroundThreads.size());
+	}
+
 private:
 
-	void ThreadWork(ExtraObjectType* ExtraObject)
+	//padded out to a cache line, so threads working through their own ranges don't fight over the line
+	struct WorkRange
+	{
+		std::atomic<size_t> NextIndex;
+		std::atomic<size_t> EndIndex;
+		char Padding[64 - 2 * sizeof(std::atomic<size_t>)];
+	};
+
+	//chunks per thread - enough for the split to follow the costs closely and for stealing to even out the rest
+	static const size_t ChunksPerThread = 16;
+
+	//contiguous ranges of chunks, cut where the running total of last call's costs crosses each thread's share
+	void SplitChunksByCost(size_t numItems)
 	{
+		const size_t numRanges = BackgroundThreads.size();
+		const size_t numChunks = std::min(numItems, numRanges * ChunksPerThread);
+		if (ChunkCosts.size() != numChunks)
+		{
+			//nothing to go on, so equal counts to start with
+			ChunkCosts.assign(numChunks, 1.0f);
+		}
+
+		float totalCost = 0.0f;
+		for (float cost : ChunkCosts)
+		{
+			totalCost += cost;
+		}
+
+		float runningCost = 0.0f;
+		size_t chunk = 0;
+		for (size_t range = 0; range < numRanges; ++range)
+		{
+			Ranges[range].NextIndex = chunk;
+			const float rangeEndCost = totalCost * (range + 1) / numRanges;
+			while (chunk < numChunks && (range + 1 == numRanges || runningCost + ChunkCosts[chunk] * 0.5f <= rangeEndCost))
+			{
+				runningCost += ChunkCosts[chunk];
+				++chunk;
+			}
+			Ranges[range].EndIndex = chunk;
+		}
+		NumRanges = numRanges;
+		NumChunks = numChunks;
+	}
+
+	void RunChunk(size_t Chunk, size_t NumItemsInCall, size_t NumChunksInCall, ExtraObjectType* ExtraObject)
+	{
+		const size_t begin = NumItemsInCall * Chunk / NumChunksInCall;
+		const size_t end = NumItemsInCall * (Chunk + 1) / NumChunksInCall;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t index = begin; index < end; ++index)
+		{
+			InnerFunction(InputBuffer, OutputBuffer, index, ExtraObject);
+		}
+		//only this thread has the chunk, and the count below publishes the cost to the next call's split
+		ChunkCosts[Chunk] = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		NumCompletedItems += end - begin;
+	}
+
+	void ThreadWork(unsigned int ThreadIndex, ExtraObjectType* ExtraObject)
+	{
+		unsigned int pinGeneration = 0;
 		while (!bShutdown)
 		{
-			if (bDoWork)
+			if (PinGeneration != pinGeneration)
 			{
-				size_t currentIndex;
-				while ((currentIndex = CurrentDataIndex++) < (**InputBuffer).size())
+				pinGeneration = PinGeneration;
+				if (ThreadIndex < ThreadCores.size())
 				{
-					InnerFunction(InputBuffer, OutputBuffer, currentIndex, ExtraObject);	
-
-					if (currentIndex == (**InputBuffer).size() - 1)
-					{
-						bFinished = true;
-						break;
-					}
+					Core::PinCurrentThread(ThreadCores[ThreadIndex]);
 				}
-				
-				if ((**InputBuffer).empty())
+				else
 				{
-					bFinished = true;
+					Core::UnpinCurrentThread();
 				}
-
-				//yield if we're out of the loop, to avoid spending time aggressively checking array bounds if we've finished
-				std::this_thread::yield();
+				++NumPinnedThreads;
 			}
-			else
+
+			//counted as active before looking at the flag, so Work can't reset the ranges under us
+			++NumActiveThreads;
+			if (bDoWork)
 			{
-				//yield to other threads while we wait for our turn
-				std::this_thread::yield();
+				//own range first, then help out with the others in turn - ranges are of chunks when cost balanced, of items otherwise
+				const size_t numRanges = NumRanges;
+				const size_t numChunks = NumChunks;
+				const size_t numItems = NumItems;
+				for (size_t offset = 0; offset < numRanges; ++offset)
+				{
+					WorkRange& range = Ranges[(ThreadIndex + offset) % numRanges];
+					size_t currentIndex;
+					while ((currentIndex = range.NextIndex++) < range.EndIndex)
+					{
+						if (numChunks > 0)
+						{
+							RunChunk(currentIndex, numItems, numChunks, ExtraObject);
+						}
+						else
+						{
+							InnerFunction(InputBuffer, OutputBuffer, currentIndex, ExtraObject);
+							++NumCompletedItems;
+						}
+					}
+				}
 			}
+			--NumActiveThreads;
+
+			//yield to other threads while we wait for our turn, or if we've finished, to avoid aggressively checking array bounds
+			std::this_thread::yield();
 		}
 
 		//signal the main thread that this thread is done
@@ -93,14 +246,30 @@ private:
 
 	std::vector<std::thread> BackgroundThreads;
 
-	std::atomic<size_t> CurrentDataIndex;
+	//one per thread when partitioned, otherwise only the first is used
+	std::unique_ptr<WorkRange[]> Ranges;
+	std::atomic<size_t> NumRanges;
+	bool bPartitioned;
+
+	bool bCostBalanced;
+	//0 when the ranges are of items
+	std::atomic<size_t> NumChunks;
+	std::atomic<size_t> NumItems;
+	//seconds each chunk took last call
+	std::vector<float> ChunkCosts;
+
 	std::atomic<bool> bShutdown;
 	std::atomic<bool> bDoWork;
-	std::atomic<bool> bFinished;
+	std::atomic<unsigned int> NumActiveThreads;
+	std::atomic<size_t> NumCompletedItems;
 	std::atomic<unsigned int> NumShutdownThreads;
 
+	std::vector<unsigned int> ThreadCores;
+	std::atomic<unsigned int> PinGeneration;
+	std::atomic<unsigned int> NumPinnedThreads;
+
 	FunctionType InnerFunction;
 
 	InputDataContainerType** InputBuffer;
 	OutputDataContainerType** OutputBuffer;
-};
\ No newline at end of file
+};
@@ -0,0 +1,166 @@
+#include "Topology.hpp"
+
+#include <thread>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#endif
+
+namespace Core
+{
+#ifdef _WIN32
+
+	std::vector<std::vector<unsigned int>> GetNumaNodeCores()
+	{
+		const unsigned int numCores = std::max(std::thread::hardware_concurrency(), 1u);
+		ULONG highestNode = 0;
+		if (!GetNumaHighestNodeNumber(&highestNode))
+		{
+			highestNode = 0;
+		}
+
+		std::vector<std::vector<unsigned int>> nodes(highestNode + 1);
+		for (unsigned int core = 0; core < numCores; ++core)
+		{
+			UCHAR node = 0;
+			if (core > 0xff || !GetNumaProcessorNode(static_cast<UCHAR>(core), &node) || node > highestNode)
+			{
+				node = 0;
+			}
+			nodes[node].push_back(core);
+		}
+
+		nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [](const std::vector<unsigned int>& node) { return node.empty(); }), nodes.end());
+		return nodes;
+	}
+
+	bool PinCurrentThread(unsigned int CoreIndex)
+	{
+		//one processor group only, which covers up to 64 cores
+		if (CoreIndex >= sizeof(DWORD_PTR) * 8)
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << CoreIndex) != 0;
+	}
+
+	bool UnpinCurrentThread()
+	{
+		DWORD_PTR processMask, systemMask;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), processMask) != 0;
+	}
+
+#else
+
+	//cpulist format, e.g. "0-7,16-23"
+	static std::vector<unsigned int> ParseCoreList(const std::string& List)
+	{
+		std::vector<unsigned int> cores;
+		std::stringstream stream(List);
+		std::string range;
+		while (std::getline(stream, range, ','))
+		{
+			unsigned int first, last;
+			const int numRead = std::sscanf(range.c_str(), "%u-%u", &first, &last);
+			if (numRead < 1)
+			{
+				continue;
+			}
+			if (numRead == 1)
+			{
+				last = first;
+			}
+			for (unsigned int core = first; core <= last; ++core)
+			{
+				cores.push_back(core);
+			}
+		}
+		return cores;
+	}
+
+	std::vector<std::vector<unsigned int>> GetNumaNodeCores()
+	{
+		std::vector<std::vector<unsigned int>> nodes;
+		for (unsigned int node = 0; ; ++node)
+		{
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!file)
+			{
+				break;
+			}
+			std::string list;
+			std::getline(file, list);
+			std::vector<unsigned int> cores = ParseCoreList(list);
+			if (!cores.empty())
+			{
+				nodes.push_back(std::move(cores));
+			}
+		}
+
+		if (nodes.empty())
+		{
+			const unsigned int numCores = std::max(std::thread::hardware_concurrency(), 1u);
+			nodes.resize(1);
+			for (unsigned int core = 0; core < numCores; ++core)
+			{
+				nodes[0].push_back(core);
+			}
+		}
+		return nodes;
+	}
+
+	bool PinCurrentThread(unsigned int CoreIndex)
+	{
+		if (CoreIndex >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(CoreIndex, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+
+	bool UnpinCurrentThread()
+	{
+		//whatever the main thread is allowed, which is the process' own mask unless someone pinned it
+		cpu_set_t set;
+		if (sched_getaffinity(getpid(), sizeof(set), &set) != 0)
+		{
+			return false;
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+
+#endif
+
+	std::vector<unsigned int> GetThreadCores(unsigned int NumThreads)
+	{
+		const std::vector<std::vector<unsigned int>> nodes = GetNumaNodeCores();
+
+		std::vector<unsigned int> cores(NumThreads);
+		for (unsigned int thread = 0; thread < NumThreads; ++thread)
+		{
+			//an even share of the threads per node, then round robin over the node's cores
+			const size_t node = static_cast<size_t>(thread) * nodes.size() / NumThreads;
+			const unsigned int firstThread = static_cast<unsigned int>((node * NumThreads + nodes.size() - 1) / nodes.size());
+			cores[thread] = nodes[node][(thread - firstThread) % nodes[node].size()];
+		}
+		return cores;
+	}
+}
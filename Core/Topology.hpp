@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+namespace Core
+{
+	//Logical cores grouped by NUMA node. A single node holding every core when the platform can't tell.
+	std::vector<std::vector<unsigned int>> GetNumaNodeCores();
+
+	//A core for each of NumThreads threads, handed out to the nodes in contiguous blocks - threads next to each other
+	//share a node, so work split into contiguous ranges per thread splits the same way across the nodes.
+	std::vector<unsigned int> GetThreadCores(unsigned int NumThreads);
+
+	//false if the platform refused
+	bool PinCurrentThread(unsigned int CoreIndex);
+	//back to running anywhere in the process
+	bool UnpinCurrentThread();
+}
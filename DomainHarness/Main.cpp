@@ -0,0 +1,60 @@
+#include <iostream>
+#include <random>
+#include <memory>
+
+#include "../Physics/Domains.hpp"
+
+using namespace Physics;
+using namespace Core;
+
+//Same seed in every process, each domain keeps the objects in its own slab
+static void BuildScene(PhysicsManager& Manager, DomainNode& Node)
+{
+	Manager.AddForceGenerator(std::shared_ptr<ForceGenerator>(new UniformGravity(Vector4(0.0f, -9.8f, 0.0f))));
+	Manager.AddPlane(Vector4(0.0f, 1.0f, 0.0f), 0.0f, 0.3f);
+
+	std::mt19937 engine(7);
+	std::uniform_real_distribution<float> horizontal(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> height(1.0f, 30.0f);
+	std::uniform_real_distribution<float> speed(-8.0f, 8.0f);
+
+	//fast enough sideways that plenty of objects cross the slab boundaries
+	for (uint32_t id = 0; id < 8000; ++id)
+	{
+		const Vector4 position(horizontal(engine), height(engine), horizontal(engine));
+		const Vector4 velocity(speed(engine), 0.0f, speed(engine));
+		switch (id % 10)
+		{
+		case 3:
+			Node.AddCapsule(id, position, velocity, Vector4(1.0f, 0.0f, 0.0f), 0.5f, 0.4f, 1.0f, 0.3f);
+			break;
+		case 7:
+			Node.AddBox(id, position, velocity, Vector4(0.5f, 0.5f, 0.5f), Matrix4(), 1.0f, 0.3f);
+			break;
+		default:
+			Node.AddCollisionObject(id, position, velocity, 0.5f, 1.0f, 0.3f);
+			break;
+		}
+	}
+}
+
+//Runs a scene split over four domain processes, launched as copies of this executable, and exits with 1 if any of them
+//failed or an object was lost or duplicated on the way. The settings have to be the same in every process, so there are no arguments.
+int main(int argc, char** argv)
+{
+	DomainHarnessSettings settings;
+	settings.Layout.NumDomains = 4;
+	settings.Layout.Min = -40.0f;
+	settings.Layout.Max = 40.0f;
+	settings.NumFrames = 300;
+	settings.Build = BuildScene;
+
+	if (IsDomainProcess(argc, argv))
+	{
+		return RunDomainProcess(argc, argv, settings);
+	}
+
+	const DomainHarnessReport report = RunDomainHarness(settings);
+	PrintDomainHarnessReport(report, std::cout);
+	return report.bPassed ? 0 : 1;
+}
@@ -14,6 +14,7 @@ static const size_t NumObjects = 30000;
 namespace Engine
 {
 	Engine::Engine(std::shared_ptr<Rendering::OpenGLRenderer> InRenderer) :
+		NumCollisions(0),
 		PhysicsManager(32, NumObjects),
 		Renderer(InRenderer),
 		RandomEngine((unsigned int)chrono::high_resolution_clock::now().time_since_epoch().count()),
@@ -21,16 +22,26 @@ namespace Engine
 		VelocityDist(-10.0f, 10.0f),
 		NumSpheres(NumObjects)
 	{
+		//random numbers up front, the engine isn't thread safe - the objects themselves are built in one parallel batch
+		simd_vector<Vector4> positions(NumSpheres);
+		simd_vector<Vector4> velocities(NumSpheres);
 		for (int i = 0; i < NumSpheres; ++i)
 		{
 			float distance = PositionDist(RandomEngine);
 			Vector4 direction(PositionDist(RandomEngine), PositionDist(RandomEngine), PositionDist(RandomEngine));
-			Vector4 position = direction * ((1000.0f * std::cbrt(distance)) / direction.length3());
-
-			PhysicsManager.AddCollisionObject(position,
-				Vector4(VelocityDist(RandomEngine), VelocityDist(RandomEngine), VelocityDist(RandomEngine)),
-				1.0f);
+			positions[i] = direction * ((1000.0f * std::cbrt(distance)) / direction.length3());
+			velocities[i] = Vector4(VelocityDist(RandomEngine), VelocityDist(RandomEngine), VelocityDist(RandomEngine));
 		}
+		PhysicsManager.AddCollisionObjects(positions.data(), velocities.data(), nullptr, NumSpheres);
+
+		//constant pull toward the center keeps the ball of spheres together
+		PhysicsManager.AddForceGenerator(std::shared_ptr<ForceGenerator>(new PointAttractor(Vector4(0.0f, 0.0f, 0.0f), 0.6f, 0.0f)));
+
+		//frames finish on the physics side while the main loop is busy rendering, so they count their own collisions
+		PhysicsManager.SetFrameCallback([this](bool)
+		{
+			NumCollisions += PhysicsManager.NumFrameCollisions.exchange(0);
+		});
 	}
 
 	int Engine::MainLoop()
@@ -41,7 +52,6 @@ namespace Engine
 		unsigned int frameCounter = 0;
 
 		bool bRunning = true;
-		unsigned int numCollisions = 0;
 		while (bRunning)
 		{
 			if (PlatformManager.PumpMessage() == Quit)
@@ -58,8 +68,6 @@ namespace Engine
 					chrono::duration<float> interval(chrono::high_resolution_clock::now() - lastTime);
 					lastTime = chrono::high_resolution_clock::now();
 					Simulate(interval.count());
-					numCollisions += PhysicsManager.NumFrameCollisions;
-					PhysicsManager.NumFrameCollisions = 0;
 					frame += interval;
 					second += interval;
 					++frameCounter;
@@ -67,16 +75,16 @@ namespace Engine
 
 				frame = frame.zero();
 
+				//the last frame is still running, this draws the one before it
 				Render();
 
 				char str[16];
 
 				if (second.count() >= 1.0f)
 				{
-					sprintf_s(str, "%d %d\n", frameCounter, numCollisions);
+					sprintf_s(str, "%d %d\n", frameCounter, NumCollisions.exchange(0));
 					OutputDebugString(str);
 					frameCounter = 0;
-					numCollisions = 0;
 					second = second.zero();
 				}
 
@@ -85,9 +93,10 @@ namespace Engine
 		return 0;
 	}
 
+	//waits for the previous frame if it's still going, then starts this one and returns
 	void Engine::Simulate(float deltaTime)
 	{
-		PhysicsManager.RunFrame(deltaTime);
+		PhysicsManager.RunFrameAsync(deltaTime);
 	}
 
 	void Engine::Render()
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <random>
+#include <atomic>
 
 #include "../Physics/PhysicsManager.hpp"
 #include "../OpenGLRenderer/OpenGLRenderer.hpp"
@@ -24,6 +25,8 @@ namespace Engine
 		std::shared_ptr<Rendering::OpenGLRenderer> Renderer;
 
 		SpriteTechnique SpriteTechnique;
+		//before the manager, so it outlives the frame callback that adds to it
+		std::atomic<unsigned int> NumCollisions;
 		Physics::PhysicsManager PhysicsManager;
 		PlatformManager PlatformManager;
 
@@ -0,0 +1,18 @@
+#include "BarnesHutGravity.hpp"
+
+using namespace Core;
+namespace Physics
+{
+	BarnesHutGravity::BarnesHutGravity(const Octree& tree, float gravitationalConstant, float openingAngle, float softening) :
+		GravitationalConstant(gravitationalConstant),
+		OpeningAngle(openingAngle),
+		Softening(softening),
+		Tree(tree)
+	{}
+
+	Vector4 BarnesHutGravity::GetAcceleration(const simd_vector<PhysicsObject>&, const PhysicsObject& Object, const Vector4& Position, const Vector4&) const
+	{
+		//the tree points into the front buffer, so skip ourselves by index rather than address
+		return Tree.GetGravitationalAcceleration(Position, Object.Index, GravitationalConstant, OpeningAngle, Softening);
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ForceGenerators.hpp"
+#include "Octree.hpp"
+
+namespace Physics
+{
+	//Mutual gravity between every object in O(n log n), approximating distant octree nodes by their center of mass.
+	//Reads the collision octree, which is rebuilt at the start of each frame from the same state the integrator starts from.
+	class BarnesHutGravity : public ForceGenerator
+	{
+	public:
+		BarnesHutGravity(const Octree& tree, float gravitationalConstant, float openingAngle = 0.5f, float softening = 0.1f);
+
+		virtual Core::Vector4 GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Core::Vector4& Position, const Core::Vector4& Velocity) const;
+
+		float GravitationalConstant;
+		//node width / distance below which a node is treated as a point mass - 0 is exact (and O(n^2)), ~1 is fast and rough
+		float OpeningAngle;
+		float Softening;
+
+	private:
+
+		const Octree& Tree;
+	};
+}
@@ -0,0 +1,120 @@
+#include "ContactManager.hpp"
+
+using namespace Core;
+namespace Physics
+{
+	ContactManager::ContactManager() :
+		RevalidationThreshold(0.01f),
+		CurrentFrame(0)
+	{}
+
+	const CachedContact* ContactManager::Find(size_t IndexA, size_t IndexB) const
+	{
+		auto cached = Cache.find(MakePairKey(IndexA, IndexB));
+		return cached != Cache.end() ? &cached->second : nullptr;
+	}
+
+	bool ContactManager::CanReuse(const CachedContact& Cached, const Vector4& RelativePosition) const
+	{
+		return (RelativePosition - Cached.Data.RelativePosition).length3Squared() < RevalidationThreshold * RevalidationThreshold;
+	}
+
+	void ContactManager::Update(const simd_vector<Contact>& Contacts)
+	{
+		++CurrentFrame;
+		Events.clear();
+
+		for (auto& contact : Contacts)
+		{
+			auto inserted = Cache.insert(std::make_pair(MakePairKey(contact.IndexA, contact.IndexB), CachedContact{ contact, CurrentFrame }));
+			if (inserted.second)
+			{
+				Events.push_back(ContactEvent{ contact.IndexA, contact.IndexB, ContactEventType::Begin });
+			}
+			else
+			{
+				inserted.first->second.Data = contact;
+				inserted.first->second.LastFrameSeen = CurrentFrame;
+				Events.push_back(ContactEvent{ contact.IndexA, contact.IndexB, ContactEventType::Persist });
+			}
+		}
+
+		//anything we didn't see this frame has separated
+		for (auto cached = Cache.begin(); cached != Cache.end();)
+		{
+			if (cached->second.LastFrameSeen != CurrentFrame)
+			{
+				Events.push_back(ContactEvent{ cached->second.Data.IndexA, cached->second.Data.IndexB, ContactEventType::End });
+				cached = Cache.erase(cached);
+			}
+			else
+			{
+				++cached;
+			}
+		}
+	}
+
+	const std::vector<ContactEvent>& ContactManager::GetEvents() const
+	{
+		return Events;
+	}
+
+	void ContactManager::Remap(const std::vector<size_t>& NewIndices)
+	{
+		ContactMap remapped;
+		remapped.reserve(Cache.size());
+		for (auto& cached : Cache)
+		{
+			CachedContact entry = cached.second;
+			entry.Data.IndexA = NewIndices[entry.Data.IndexA];
+			entry.Data.IndexB = NewIndices[entry.Data.IndexB];
+			if (entry.Data.IndexA == InvalidObjectIndex || entry.Data.IndexB == InvalidObjectIndex)
+			{
+				continue;
+			}
+
+			//pairs are always built lower index first, so flip the cached geometry if the move swapped their order
+			if (entry.Data.IndexA > entry.Data.IndexB)
+			{
+				std::swap(entry.Data.IndexA, entry.Data.IndexB);
+				entry.Data.Normal = Vector4(0.0f) - entry.Data.Normal;
+				entry.Data.RelativePosition = Vector4(0.0f) - entry.Data.RelativePosition;
+			}
+			remapped.insert(std::make_pair(MakePairKey(entry.Data.IndexA, entry.Data.IndexB), entry));
+		}
+		Cache = std::move(remapped);
+	}
+
+	void ContactManager::SaveSnapshot(SnapshotWriter& Writer) const
+	{
+		simd_vector<CachedContact> contacts;
+		contacts.reserve(Cache.size());
+		for (auto& cached : Cache)
+		{
+			contacts.push_back(cached.second);
+		}
+
+		Writer.Write(SnapshotSection::Contacts, 0, contacts);
+		Writer.Write(SnapshotSection::ContactFrame, 0, &CurrentFrame, 1);
+	}
+
+	bool ContactManager::LoadSnapshot(const SnapshotReader& Reader)
+	{
+		const CachedContact* contacts;
+		size_t numContacts;
+		const unsigned int* frame;
+		size_t numFrames;
+		if (!Reader.Find(SnapshotSection::Contacts, 0, contacts, numContacts) || !Reader.Find(SnapshotSection::ContactFrame, 0, frame, numFrames) || numFrames != 1)
+		{
+			return false;
+		}
+
+		CurrentFrame = *frame;
+		Cache.reserve(numContacts);
+		for (size_t i = 0; i < numContacts; ++i)
+		{
+			Cache.insert(std::make_pair(MakePairKey(contacts[i].Data.IndexA, contacts[i].Data.IndexB), contacts[i]));
+		}
+		return true;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+#include "Types.hpp"
+#include "Snapshot.hpp"
+
+namespace Physics
+{
+	enum class ContactEventType
+	{
+		Begin,
+		Persist,
+		End
+	};
+
+	struct ContactEvent
+	{
+		size_t IndexA;
+		size_t IndexB;
+		ContactEventType Type;
+	};
+
+	struct CachedContact
+	{
+		Contact Data;
+		unsigned int LastFrameSeen;
+	};
+
+	//keeps contacts alive across frames, keyed by object index pair, for warm starting and contact events
+	class ContactManager
+	{
+	public:
+		ContactManager();
+
+		//null if the pair wasn't touching last frame - only read from worker threads while nothing is updating the cache
+		const CachedContact* Find(size_t IndexA, size_t IndexB) const;
+
+		//true if the pair has moved so little relative to each other that the cached normal is still good
+		bool CanReuse(const CachedContact& Cached, const Core::Vector4& RelativePosition) const;
+
+		//merge this frame's solved contacts into the cache, generating begin/persist/end events
+		void Update(const simd_vector<Contact>& Contacts);
+
+		const std::vector<ContactEvent>& GetEvents() const;
+
+		//objects have moved to NewIndices[old index] - contacts with removed objects (InvalidObjectIndex) are dropped without an end event
+		void Remap(const std::vector<size_t>& NewIndices);
+
+		//the cached contacts, for warm starting straight away after a restart - load into an empty cache, false if the sections are missing
+		void SaveSnapshot(SnapshotWriter& Writer) const;
+		bool LoadSnapshot(const SnapshotReader& Reader);
+
+		//relative displacement since the last full narrowphase test below which the cached normal is reused
+		//(not for two spheres, their full test is cheaper than the check)
+		float RevalidationThreshold;
+
+	private:
+
+		typedef std::unordered_map<uint64_t, CachedContact, std::hash<uint64_t>, std::equal_to<uint64_t>, aligned_allocator<std::pair<const uint64_t, CachedContact>, 16>> ContactMap;
+
+		ContactMap Cache;
+		std::vector<ContactEvent> Events;
+		unsigned int CurrentFrame;
+	};
+}
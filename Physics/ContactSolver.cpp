@@ -0,0 +1,215 @@
+#include "ContactSolver.hpp"
+
+#include <algorithm>
+
+using namespace Core;
+namespace Physics
+{
+	SolverSettings::SolverSettings() :
+		NumIterations(8),
+		BaumgarteFactor(0.2f),
+		PenetrationSlop(0.01f),
+		RestitutionThreshold(0.5f),
+		bWarmStart(true)
+	{}
+
+	//warm start impulse from the cache, applied before the first iteration
+	static void WarmStartContact(const Contact& Contact, simd_vector<PhysicsObject>& Objects)
+	{
+		PhysicsObject& first = Objects[Contact.IndexA];
+		PhysicsObject& second = Objects[Contact.IndexB];
+
+		//immovable objects are shared between islands, so they're never written
+		if (first.InverseMass != 0.0f)
+		{
+			first.Velocity += Contact.Normal * (Contact.NormalImpulse * first.InverseMass);
+		}
+		if (second.InverseMass != 0.0f)
+		{
+			second.Velocity -= Contact.Normal * (Contact.NormalImpulse * second.InverseMass);
+		}
+	}
+
+	static void SolveContact(Contact& Contact, simd_vector<PhysicsObject>& Objects)
+	{
+		PhysicsObject& first = Objects[Contact.IndexA];
+		PhysicsObject& second = Objects[Contact.IndexB];
+
+		const float normalSpeed = (first.Velocity - second.Velocity).dot3(Contact.Normal);
+		float impulse = Contact.NormalMass * (Contact.VelocityBias - normalSpeed);
+
+		//clamp the accumulated impulse rather than this iteration's, so earlier overshoot can be taken back
+		const float newImpulse = std::max(Contact.NormalImpulse + impulse, 0.0f);
+		impulse = newImpulse - Contact.NormalImpulse;
+		Contact.NormalImpulse = newImpulse;
+
+		if (first.InverseMass != 0.0f)
+		{
+			first.Velocity += Contact.Normal * (impulse * first.InverseMass);
+		}
+		if (second.InverseMass != 0.0f)
+		{
+			second.Velocity -= Contact.Normal * (impulse * second.InverseMass);
+		}
+	}
+
+	ContactSolver::ContactSolver()
+	{}
+
+	void ContactSolver::PrepareContact(const PhysicsObject& First, const PhysicsObject& Second, const Vector4& FirstAcceleration, const Vector4& SecondAcceleration, float DeltaTime, float CachedImpulse, Contact& OutContact) const
+	{
+		const float inverseMassSum = First.InverseMass + Second.InverseMass;
+		OutContact.NormalMass = inverseMassSum > 0.0f ? 1.0f / inverseMassSum : 0.0f;
+
+		//bounce off the approach speed, or push out the penetration, whichever asks for more separation
+		const float approachSpeed = (First.Velocity - Second.Velocity).dot3(OutContact.Normal);
+		const float restitution = std::min(First.Restitution, Second.Restitution);
+		const float restitutionBias = approachSpeed < -Settings.RestitutionThreshold ? -restitution * approachSpeed : 0.0f;
+		const float correctionBias = DeltaTime > 0.0f ? Settings.BaumgarteFactor / DeltaTime * std::max(OutContact.Penetration - Settings.PenetrationSlop, 0.0f) : 0.0f;
+
+		//integration adds this frame's accelerations after the solve, so aim for a velocity that's still separating once they're applied
+		//(this is what lets a stack rest under gravity instead of sinking a little every frame)
+		const float accelerationSpeed = (FirstAcceleration - SecondAcceleration).dot3(OutContact.Normal) * DeltaTime;
+		OutContact.VelocityBias = std::max(restitutionBias, correctionBias) - accelerationSpeed;
+
+		OutContact.NormalImpulse = Settings.bWarmStart ? CachedImpulse : 0.0f;
+	}
+
+	void ContactSolver::Solve(simd_vector<Contact>& Contacts, simd_vector<PhysicsObject>& Objects)
+	{
+		if (Settings.bWarmStart)
+		{
+			for (auto& contact : Contacts)
+			{
+				WarmStartContact(contact, Objects);
+			}
+		}
+
+		for (unsigned int iteration = 0; iteration < Settings.NumIterations; ++iteration)
+		{
+			for (auto& contact : Contacts)
+			{
+				SolveContact(contact, Objects);
+			}
+		}
+	}
+
+	void ContactSolver::BuildIslandBatches(const simd_vector<Contact>& Contacts, const simd_vector<PhysicsObject>& Objects, size_t BatchSize, std::vector<BatchRange>& OutBatches)
+	{
+		OutBatches.clear();
+		IslandParents.resize(Objects.size());
+		RootIslands.resize(Objects.size());
+		for (auto& contact : Contacts)
+		{
+			IslandParents[contact.IndexA] = contact.IndexA;
+			IslandParents[contact.IndexB] = contact.IndexB;
+			RootIslands[contact.IndexA] = InvalidObjectIndex;
+			RootIslands[contact.IndexB] = InvalidObjectIndex;
+		}
+
+		//immovable objects don't join islands, the same as for sleeping - they're only ever read
+		for (auto& contact : Contacts)
+		{
+			if (Objects[contact.IndexA].InverseMass == 0.0f || Objects[contact.IndexB].InverseMass == 0.0f)
+			{
+				continue;
+			}
+
+			const size_t islandA = FindIsland(contact.IndexA);
+			const size_t islandB = FindIsland(contact.IndexB);
+			if (islandA != islandB)
+			{
+				IslandParents[std::max(islandA, islandB)] = std::min(islandA, islandB);
+			}
+		}
+
+		//number the islands in order of their first contact and count their contacts
+		const size_t numContacts = Contacts.size();
+		ContactIslands.resize(numContacts);
+		Islands.clear();
+		for (size_t contact = 0; contact < numContacts; ++contact)
+		{
+			//a contact always has at least one movable object, and that's the one in an island
+			const Contact& data = Contacts[contact];
+			const size_t root = FindIsland(Objects[data.IndexA].InverseMass != 0.0f ? data.IndexA : data.IndexB);
+			if (RootIslands[root] == InvalidObjectIndex)
+			{
+				RootIslands[root] = Islands.size();
+				Islands.push_back(BatchRange{ 0, 0 });
+			}
+			ContactIslands[contact] = RootIslands[root];
+			++Islands[RootIslands[root]].End;
+		}
+
+		//biggest islands first, so the threads start on the ones that take longest (ties by number, so it's the same every run)
+		IslandOrder.resize(Islands.size());
+		for (size_t island = 0; island < Islands.size(); ++island)
+		{
+			IslandOrder[island] = island;
+		}
+		std::sort(IslandOrder.begin(), IslandOrder.end(), [this](size_t A, size_t B)
+		{
+			return Islands[A].End != Islands[B].End ? Islands[A].End > Islands[B].End : A < B;
+		});
+
+		//lay the islands out in that order, cutting a batch whenever it's reached BatchSize
+		size_t offset = 0;
+		size_t batchBegin = 0;
+		for (size_t island : IslandOrder)
+		{
+			const size_t count = Islands[island].End;
+			Islands[island].Begin = offset;
+			//counted back up as the contacts go in
+			Islands[island].End = offset;
+			offset += count;
+
+			if (offset - batchBegin >= BatchSize)
+			{
+				OutBatches.push_back(BatchRange{ batchBegin, offset });
+				batchBegin = offset;
+			}
+		}
+		if (offset > batchBegin)
+		{
+			OutBatches.push_back(BatchRange{ batchBegin, offset });
+		}
+
+		IslandContacts.resize(numContacts);
+		for (size_t contact = 0; contact < numContacts; ++contact)
+		{
+			IslandContacts[Islands[ContactIslands[contact]].End++] = contact;
+		}
+	}
+
+	void ContactSolver::SolveIslandBatch(simd_vector<Contact>& Contacts, simd_vector<PhysicsObject>& Objects, const BatchRange& Batch) const
+	{
+		//Whole islands, so the same passes as Solve over just these contacts. The islands in a batch are independent, so
+		//interleaving their passes like this changes nothing.
+		if (Settings.bWarmStart)
+		{
+			for (size_t i = Batch.Begin; i < Batch.End; ++i)
+			{
+				WarmStartContact(Contacts[IslandContacts[i]], Objects);
+			}
+		}
+
+		for (unsigned int iteration = 0; iteration < Settings.NumIterations; ++iteration)
+		{
+			for (size_t i = Batch.Begin; i < Batch.End; ++i)
+			{
+				SolveContact(Contacts[IslandContacts[i]], Objects);
+			}
+		}
+	}
+
+	size_t ContactSolver::FindIsland(size_t Index)
+	{
+		//path halving keeps the trees flat without recursion
+		while (IslandParents[Index] != Index)
+		{
+			IslandParents[Index] = IslandParents[IslandParents[Index]];
+			Index = IslandParents[Index];
+		}
+		return Index;
+	}
+}
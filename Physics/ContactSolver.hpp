@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.hpp"
+
+namespace Physics
+{
+	struct SolverSettings
+	{
+		SolverSettings();
+
+		//sequential impulse passes over the whole contact set per frame
+		unsigned int NumIterations;
+		//fraction of the penetration (beyond the slop) pushed out per second, Baumgarte style
+		float BaumgarteFactor;
+		//penetration tolerated without correction, keeps resting contacts from jittering
+		float PenetrationSlop;
+		//approach speed below which contacts don't bounce
+		float RestitutionThreshold;
+		//seed each contact with last frame's accumulated impulse
+		bool bWarmStart;
+	};
+
+	//iterative sequential impulse solver over the frame's contact set
+	class ContactSolver
+	{
+	public:
+		ContactSolver();
+
+		//fill in the per-contact solver data once the geometry is known - safe to call from worker threads during preparation
+		//the objects should be this frame's state with external impulses applied, and the accelerations what integration will add
+		void PrepareContact(const PhysicsObject& First, const PhysicsObject& Second, const Core::Vector4& FirstAcceleration, const Core::Vector4& SecondAcceleration, float DeltaTime, float CachedImpulse, Contact& OutContact) const;
+
+		//apply impulses to the velocities in Objects until the contacts are satisfied (or we run out of iterations)
+		void Solve(simd_vector<Contact>& Contacts, simd_vector<PhysicsObject>& Objects);
+
+		//Group the contacts into islands, movable objects connected through contacts, and the islands into batches of at
+		//least BatchSize contacts, largest islands first. Nothing outside an island touches its objects, so batches can be
+		//solved on different threads, and with each island's contacts kept in their order the results match Solve's.
+		void BuildIslandBatches(const simd_vector<Contact>& Contacts, const simd_vector<PhysicsObject>& Objects, size_t BatchSize, std::vector<BatchRange>& OutBatches);
+
+		//Solve for one batch from BuildIslandBatches - safe to call from worker threads for different batches
+		void SolveIslandBatch(simd_vector<Contact>& Contacts, simd_vector<PhysicsObject>& Objects, const BatchRange& Batch) const;
+
+		SolverSettings Settings;
+
+	private:
+
+		size_t FindIsland(size_t Index);
+
+		//union-find over object indices, only valid for the objects in contacts during BuildIslandBatches
+		std::vector<size_t> IslandParents;
+		//contact indices grouped by island, what the batches index into
+		std::vector<size_t> IslandContacts;
+		//scratch: island number of each root object and of each contact, the islands' ranges of IslandContacts, and the
+		//order they're laid out in
+		std::vector<size_t> RootIslands;
+		std::vector<size_t> ContactIslands;
+		std::vector<BatchRange> Islands;
+		std::vector<size_t> IslandOrder;
+	};
+}
@@ -0,0 +1,55 @@
+#include "ContinuousCollision.hpp"
+
+#include <cmath>
+
+using namespace Core;
+namespace Physics
+{
+	ContinuousCollisionSettings::ContinuousCollisionSettings() :
+		bEnabled(true),
+		FastMotionFraction(0.5f),
+		ContactOverlap(0.01f)
+	{}
+
+	float SweptSphereTimeOfImpact(const Vector4& StartA, const Vector4& DisplacementA, const Vector4& StartB, const Vector4& DisplacementB, float Distance)
+	{
+		//work in A's frame: solve |offset + motion * t| = Distance for the smallest t
+		const Vector4 offset = StartB - StartA;
+		const Vector4 motion = DisplacementB - DisplacementA;
+
+		const float c = offset.length3Squared() - Distance * Distance;
+		if (c <= 0.0f)
+		{
+			return 2.0f;
+		}
+
+		const float a = motion.length3Squared();
+		const float b = 2.0f * offset.dot3(motion);
+
+		//not approaching
+		if (a <= 0.0f || b >= 0.0f)
+		{
+			return 2.0f;
+		}
+
+		const float discriminant = b * b - 4.0f * a * c;
+		if (discriminant < 0.0f)
+		{
+			return 2.0f;
+		}
+
+		return (-b - std::sqrt(discriminant)) / (2.0f * a);
+	}
+
+	float SweptSpherePlaneTimeOfImpact(const Vector4& Start, const Vector4& Displacement, const Vector4& PlaneNormal, float PlaneDistance, float Distance)
+	{
+		const float startGap = PlaneNormal.dot3(Start) - PlaneDistance - Distance;
+		const float closingSpeed = -PlaneNormal.dot3(Displacement);
+		if (startGap <= 0.0f || closingSpeed <= 0.0f)
+		{
+			return 2.0f;
+		}
+
+		return startGap / closingSpeed;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Types.hpp"
+
+namespace Physics
+{
+	struct ContinuousCollisionSettings
+	{
+		ContinuousCollisionSettings();
+
+		bool bEnabled;
+		//objects moving further than this fraction of their radius in a frame get swept tests
+		float FastMotionFraction;
+		//how far into each other swept objects are allowed to end up, so the discrete pass sees the contact next frame
+		float ContactOverlap;
+	};
+
+	//Earliest fraction of the frame [0, 1] at which two spheres moving linearly from their start positions
+	//come within Distance of each other, or a value above 1 if they don't. Spheres already closer than Distance return above 1,
+	//since the discrete pass already handles them.
+	float SweptSphereTimeOfImpact(const Core::Vector4& StartA, const Core::Vector4& DisplacementA, const Core::Vector4& StartB, const Core::Vector4& DisplacementB, float Distance);
+
+	//Same for a sphere against a static plane (Normal . x == PlaneDistance), coming within Distance of its positive side.
+	float SweptSpherePlaneTimeOfImpact(const Core::Vector4& Start, const Core::Vector4& Displacement, const Core::Vector4& PlaneNormal, float PlaneDistance, float Distance);
+}
\ No newline at end of file
@@ -0,0 +1,587 @@
+#include "Domains.hpp"
+
+#include "../Core/Process.hpp"
+
+#include <chrono>
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+using namespace Core;
+namespace Physics
+{
+	//slot markers in a node's SlotIds, ids from the scene are never this big
+	static const uint32_t UntrackedObjectId = ~0u;
+	static const uint32_t GhostObjectId = ~0u - 1;
+
+	//a domain that stops turning up at the barrier for this long is taken to have died
+	static const double ExchangeTimeoutSeconds = 60.0;
+
+	static const char* DomainArgument = "--domain";
+
+	//keeps each part of the shared block on its own cache lines
+	static const size_t ExchangeAlignment = 64;
+
+	static size_t AlignExchangeSize(size_t size)
+	{
+		return (size + ExchangeAlignment - 1) / ExchangeAlignment * ExchangeAlignment;
+	}
+
+	struct DomainExchange::ExchangeHeader
+	{
+		//what it was created with, for Open to check against
+		DomainLayout Layout;
+
+		//generation moves on each time the last domain arrives
+		std::atomic<uint32_t> NumArrived;
+		std::atomic<uint32_t> Generation;
+		std::atomic<uint32_t> bAborted;
+	};
+
+	DomainLayout::DomainLayout() :
+		NumDomains(2),
+		Axis(0),
+		Min(-50.0f),
+		Max(50.0f),
+		GhostMargin(2.0f),
+		MaxExchangeObjects(4096)
+	{}
+
+	unsigned int DomainLayout::GetDomainIndex(float coordinate) const
+	{
+		const float slab = (coordinate - Min) / (Max - Min) * NumDomains;
+		if (!(slab > 0.0f))
+		{
+			return 0;
+		}
+		return std::min(static_cast<unsigned int>(slab), NumDomains - 1);
+	}
+
+	float DomainLayout::GetLowerBound(unsigned int domain) const
+	{
+		return domain == 0 ? -std::numeric_limits<float>::infinity() : Min + (Max - Min) * domain / NumDomains;
+	}
+
+	float DomainLayout::GetUpperBound(unsigned int domain) const
+	{
+		return domain + 1 >= NumDomains ? std::numeric_limits<float>::infinity() : Min + (Max - Min) * (domain + 1) / NumDomains;
+	}
+
+	DomainStats::DomainStats() :
+		NumObjects(0),
+		IdSum(0),
+		NumMigratedIn(0),
+		NumMigratedOut(0),
+		NumGhostsSent(0),
+		StepSeconds(0.0),
+		WaitSeconds(0.0)
+	{}
+
+	DomainExchange::DomainExchange() :
+		Header(nullptr),
+		MailboxSize(0)
+	{}
+
+	bool DomainExchange::Create(const std::string& name, const DomainLayout& layout)
+	{
+		Close();
+
+		Layout = layout;
+		MailboxSize = AlignExchangeSize(sizeof(DomainMailbox)) + AlignExchangeSize(sizeof(DomainObject) * Layout.MaxExchangeObjects);
+		if (!Memory.Create(name, GetMailboxOffset(Layout.NumDomains, 0, 0)))
+		{
+			return false;
+		}
+
+		//the rest starts out zeroed, which is an empty mailbox and a blank result
+		Header = new (Memory.GetData()) ExchangeHeader();
+		Header->Layout = Layout;
+		Header->NumArrived = 0;
+		Header->Generation = 0;
+		Header->bAborted = 0;
+		return true;
+	}
+
+	bool DomainExchange::Open(const std::string& name, const DomainLayout& layout)
+	{
+		Close();
+
+		Layout = layout;
+		MailboxSize = AlignExchangeSize(sizeof(DomainMailbox)) + AlignExchangeSize(sizeof(DomainObject) * Layout.MaxExchangeObjects);
+		if (!Memory.Open(name, GetMailboxOffset(Layout.NumDomains, 0, 0)))
+		{
+			return false;
+		}
+
+		Header = static_cast<ExchangeHeader*>(Memory.GetData());
+		const DomainLayout& created = Header->Layout;
+		if (created.NumDomains != Layout.NumDomains || created.Axis != Layout.Axis || created.Min != Layout.Min || created.Max != Layout.Max
+			|| created.GhostMargin != Layout.GhostMargin || created.MaxExchangeObjects != Layout.MaxExchangeObjects)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void DomainExchange::Close()
+	{
+		Memory.Close();
+		Header = nullptr;
+		MailboxSize = 0;
+	}
+
+	const DomainLayout& DomainExchange::GetLayout() const
+	{
+		return Layout;
+	}
+
+	//the header, then a result per domain, then the mailboxes by sending domain, side and frame parity
+	size_t DomainExchange::GetResultOffset(unsigned int domain) const
+	{
+		return AlignExchangeSize(sizeof(ExchangeHeader)) + AlignExchangeSize(sizeof(DomainResult)) * domain;
+	}
+
+	size_t DomainExchange::GetMailboxOffset(unsigned int from, unsigned int side, size_t frame) const
+	{
+		return GetResultOffset(Layout.NumDomains) + ((from * 2 + side) * 2 + frame % 2) * MailboxSize;
+	}
+
+	DomainMailbox& DomainExchange::GetMailbox(unsigned int from, unsigned int side, size_t frame)
+	{
+		return *reinterpret_cast<DomainMailbox*>(static_cast<unsigned char*>(Memory.GetData()) + GetMailboxOffset(from, side, frame));
+	}
+
+	DomainObject* DomainExchange::GetMailboxObjects(unsigned int from, unsigned int side, size_t frame)
+	{
+		return reinterpret_cast<DomainObject*>(static_cast<unsigned char*>(Memory.GetData()) + GetMailboxOffset(from, side, frame) + AlignExchangeSize(sizeof(DomainMailbox)));
+	}
+
+	DomainResult& DomainExchange::GetResult(unsigned int domain)
+	{
+		return *reinterpret_cast<DomainResult*>(static_cast<unsigned char*>(Memory.GetData()) + GetResultOffset(domain));
+	}
+
+	bool DomainExchange::Wait()
+	{
+		//the generation has to be read before arriving, the last one in moves it on straight away
+		const uint32_t generation = Header->Generation;
+		if (++Header->NumArrived == Layout.NumDomains)
+		{
+			Header->NumArrived = 0;
+			++Header->Generation;
+			return !IsAborted();
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		while (Header->Generation == generation)
+		{
+			if (IsAborted())
+			{
+				return false;
+			}
+			if (std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() > ExchangeTimeoutSeconds)
+			{
+				Abort();
+				return false;
+			}
+			std::this_thread::yield();
+		}
+		return !IsAborted();
+	}
+
+	void DomainExchange::Abort()
+	{
+		Header->bAborted = 1;
+	}
+
+	bool DomainExchange::IsAborted() const
+	{
+		return Header->bAborted != 0;
+	}
+
+	DomainNode::DomainNode(PhysicsManager& manager, DomainExchange& exchange, unsigned int domainIndex) :
+		Manager(manager),
+		Exchange(exchange),
+		DomainIndex(domainIndex),
+		FrameIndex(0)
+	{}
+
+	bool DomainNode::AddCollisionObject(uint32_t id, const Vector4& position, const Vector4& velocity, float radius, float mass, float restitution)
+	{
+		DomainObject object = {};
+		object.Position = position;
+		object.Velocity = velocity;
+		object.Extents = Vector4(radius, 0.0f, 0.0f, 0.0f);
+		object.InverseMass = mass > 0.0f ? 1.0f / mass : 0.0f;
+		object.Restitution = restitution;
+		object.Shape = static_cast<uint32_t>(ShapeType::Sphere);
+		object.Id = id;
+		return AddIfInside(object);
+	}
+
+	bool DomainNode::AddCapsule(uint32_t id, const Vector4& position, const Vector4& velocity, const Vector4& axis, float halfHeight, float radius, float mass, float restitution)
+	{
+		DomainObject object = {};
+		object.Position = position;
+		object.Velocity = velocity;
+		object.Axes[0] = axis.getNormalized3();
+		object.Extents = Vector4(halfHeight, radius, 0.0f, 0.0f);
+		object.InverseMass = mass > 0.0f ? 1.0f / mass : 0.0f;
+		object.Restitution = restitution;
+		object.Shape = static_cast<uint32_t>(ShapeType::Capsule);
+		object.Id = id;
+		return AddIfInside(object);
+	}
+
+	bool DomainNode::AddBox(uint32_t id, const Vector4& position, const Vector4& velocity, const Vector4& halfExtents, const Matrix4& orientation, float mass, float restitution)
+	{
+		DomainObject object = {};
+		object.Position = position;
+		object.Velocity = velocity;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			object.Axes[axis] = orientation[axis].getNormalized3();
+		}
+		object.Extents = halfExtents;
+		object.InverseMass = mass > 0.0f ? 1.0f / mass : 0.0f;
+		object.Restitution = restitution;
+		object.Shape = static_cast<uint32_t>(ShapeType::Box);
+		object.Id = id;
+		return AddIfInside(object);
+	}
+
+	bool DomainNode::AddIfInside(const DomainObject& object)
+	{
+		const DomainLayout& layout = Exchange.GetLayout();
+		if (layout.GetDomainIndex(object.Position[layout.Axis]) != DomainIndex)
+		{
+			return false;
+		}
+
+		TrackObject(AddToManager(object, false), object.Id);
+		return true;
+	}
+
+	ObjectHandle DomainNode::AddToManager(const DomainObject& object, bool bGhost)
+	{
+		const float mass = bGhost || object.InverseMass == 0.0f ? 0.0f : 1.0f / object.InverseMass;
+		switch (static_cast<ShapeType>(object.Shape))
+		{
+		case ShapeType::Capsule:
+			return Manager.AddCapsule(object.Position, object.Velocity, object.Axes[0], object.Extents[0], object.Extents[1], mass, object.Restitution);
+		case ShapeType::Box:
+			return Manager.AddBox(object.Position, object.Velocity, object.Extents, Matrix4(object.Axes[0], object.Axes[1], object.Axes[2], Vector4(0.0f, 0.0f, 0.0f, 1.0f)), mass, object.Restitution);
+		default:
+			return Manager.AddCollisionObject(object.Position, object.Velocity, object.Extents[0], mass, object.Restitution);
+		}
+	}
+
+	void DomainNode::TrackObject(ObjectHandle handle, uint32_t id)
+	{
+		if (handle.Slot >= SlotIds.size())
+		{
+			SlotIds.resize(handle.Slot + 1, UntrackedObjectId);
+		}
+		SlotIds[handle.Slot] = id;
+
+		if (id != GhostObjectId)
+		{
+			++Stats.NumObjects;
+			Stats.IdSum += id;
+		}
+	}
+
+	void DomainNode::ForgetObject(ObjectHandle handle)
+	{
+		const uint32_t id = SlotIds[handle.Slot];
+		if (id != GhostObjectId)
+		{
+			--Stats.NumObjects;
+			Stats.IdSum -= id;
+		}
+
+		SlotIds[handle.Slot] = UntrackedObjectId;
+		//ghosts are immovable, but they're sent again every step wherever their objects are - waking everything for them
+		//would keep the whole domain awake
+		Manager.RemoveObject(handle, id != GhostObjectId);
+	}
+
+	//back into exchange form from the manager's state
+	static DomainObject MakeDomainObject(const PhysicsObject& Object, const ShapeData& Shapes, uint32_t Id)
+	{
+		DomainObject object = {};
+		object.Position = Object.Position;
+		object.Velocity = Object.Velocity;
+		object.InverseMass = Object.InverseMass;
+		object.Restitution = Object.Restitution;
+		object.Shape = static_cast<uint32_t>(Object.Shape);
+		object.Id = Id;
+
+		switch (Object.Shape)
+		{
+		case ShapeType::Capsule:
+		{
+			const CapsuleShape& capsule = Shapes.Capsules[Object.ShapeIndex];
+			object.Axes[0] = capsule.Axis;
+			object.Extents = Vector4(capsule.HalfHeight, capsule.Radius, 0.0f, 0.0f);
+			break;
+		}
+		case ShapeType::Box:
+		{
+			const BoxShape& box = Shapes.Boxes[Object.ShapeIndex];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				object.Axes[axis] = box.Axes[axis];
+			}
+			object.Extents = box.HalfExtents;
+			break;
+		}
+		default:
+			object.Extents = Vector4(Object.CollisionRadius, 0.0f, 0.0f, 0.0f);
+			break;
+		}
+		return object;
+	}
+
+	bool DomainNode::Step(float deltaTime)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		Manager.RunFrame(deltaTime);
+
+		const DomainLayout& layout = Exchange.GetLayout();
+		const float lowerBound = layout.GetLowerBound(DomainIndex);
+		const float upperBound = layout.GetUpperBound(DomainIndex);
+		const uint32_t capacity = static_cast<uint32_t>(layout.MaxExchangeObjects);
+
+		//no neighbour below the first domain or above the last
+		DomainMailbox* outboxes[2] = {};
+		DomainObject* outboxObjects[2] = {};
+		for (unsigned int side = 0; side < 2; ++side)
+		{
+			if (side == 0 ? DomainIndex > 0 : DomainIndex + 1 < layout.NumDomains)
+			{
+				outboxes[side] = &Exchange.GetMailbox(DomainIndex, side, FrameIndex);
+				outboxObjects[side] = Exchange.GetMailboxObjects(DomainIndex, side, FrameIndex);
+				outboxes[side]->NumGhosts = 0;
+				outboxes[side]->NumMigrants = 0;
+			}
+		}
+
+		//ghosts fill the mailbox from the front and migrants from the back, it's full when they meet
+		bool bOverflowed = false;
+		auto post = [&](unsigned int side, const DomainObject& object, bool bMigrant)
+		{
+			DomainMailbox& mailbox = *outboxes[side];
+			if (mailbox.NumGhosts + mailbox.NumMigrants >= capacity)
+			{
+				bOverflowed = true;
+				return;
+			}
+
+			if (bMigrant)
+			{
+				outboxObjects[side][capacity - ++mailbox.NumMigrants] = object;
+			}
+			else
+			{
+				outboxObjects[side][mailbox.NumGhosts++] = object;
+			}
+		};
+
+		//last frame's ghosts go, this frame's owned objects near the edges go out as new ones and the ones outside leave
+		Manager.CopyQueryState(Objects, Handles, Shapes);
+		for (size_t index = 0; index < Objects.size(); ++index)
+		{
+			const PhysicsObject& object = Objects[index];
+			const ObjectHandle handle = Handles[index];
+			const uint32_t id = handle.Slot < SlotIds.size() ? SlotIds[handle.Slot] : UntrackedObjectId;
+			if (id == UntrackedObjectId || IsWorldShape(object.Shape))
+			{
+				continue;
+			}
+			if (id == GhostObjectId)
+			{
+				ForgetObject(handle);
+				continue;
+			}
+
+			const float coordinate = object.Position[layout.Axis];
+			if (coordinate < lowerBound || coordinate >= upperBound)
+			{
+				//a fast object can skip a whole slab, the next domain passes it on after its frame
+				post(coordinate < lowerBound ? 0 : 1, MakeDomainObject(object, Shapes, id), true);
+				ForgetObject(handle);
+				++Stats.NumMigratedOut;
+				continue;
+			}
+
+			for (unsigned int side = 0; side < 2; ++side)
+			{
+				if (outboxes[side] && (side == 0 ? coordinate < lowerBound + layout.GhostMargin : coordinate >= upperBound - layout.GhostMargin))
+				{
+					post(side, MakeDomainObject(object, Shapes, id), false);
+					++Stats.NumGhostsSent;
+				}
+			}
+		}
+
+		if (bOverflowed)
+		{
+			Exchange.Abort();
+		}
+
+		const auto waitStart = std::chrono::high_resolution_clock::now();
+		const bool bExchanged = !bOverflowed && Exchange.Wait();
+		Stats.WaitSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+		//what the neighbours sent this way - their mailboxes toward this domain are their upper side below and lower side above
+		if (bExchanged)
+		{
+			for (unsigned int side = 0; side < 2; ++side)
+			{
+				if (!outboxes[side])
+				{
+					continue;
+				}
+
+				const unsigned int neighbour = side == 0 ? DomainIndex - 1 : DomainIndex + 1;
+				const DomainMailbox& mailbox = Exchange.GetMailbox(neighbour, 1 - side, FrameIndex);
+				const DomainObject* objects = Exchange.GetMailboxObjects(neighbour, 1 - side, FrameIndex);
+				for (uint32_t ghost = 0; ghost < mailbox.NumGhosts; ++ghost)
+				{
+					TrackObject(AddToManager(objects[ghost], true), GhostObjectId);
+				}
+				for (uint32_t migrant = capacity - mailbox.NumMigrants; migrant < capacity; ++migrant)
+				{
+					TrackObject(AddToManager(objects[migrant], false), objects[migrant].Id);
+					++Stats.NumMigratedIn;
+				}
+			}
+		}
+
+		++FrameIndex;
+		Stats.StepSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return bExchanged;
+	}
+
+	unsigned int DomainNode::GetDomainIndex() const
+	{
+		return DomainIndex;
+	}
+
+	const DomainStats& DomainNode::GetStats() const
+	{
+		return Stats;
+	}
+
+	DomainHarnessSettings::DomainHarnessSettings() :
+		NumFrames(300),
+		DeltaTime(1.0f / 60.0f),
+		NumThreads(1)
+	{}
+
+	bool IsDomainProcess(int argc, char** argv)
+	{
+		return argc >= 4 && std::strcmp(argv[1], DomainArgument) == 0;
+	}
+
+	int RunDomainProcess(int argc, char** argv, const DomainHarnessSettings& Settings)
+	{
+		if (!IsDomainProcess(argc, argv))
+		{
+			return 1;
+		}
+
+		const unsigned int domainIndex = static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10));
+		DomainExchange exchange;
+		if (domainIndex >= Settings.Layout.NumDomains || !exchange.Open(argv[3], Settings.Layout))
+		{
+			return 2;
+		}
+
+		PhysicsManager manager(Settings.NumThreads);
+		DomainNode node(manager, exchange, domainIndex);
+		if (Settings.Build)
+		{
+			Settings.Build(manager, node);
+		}
+
+		DomainResult& result = exchange.GetResult(domainIndex);
+		result.Initial = node.GetStats();
+
+		bool bExchanged = true;
+		for (size_t frame = 0; frame < Settings.NumFrames && bExchanged; ++frame)
+		{
+			bExchanged = node.Step(Settings.DeltaTime);
+		}
+
+		result.Final = node.GetStats();
+		return bExchanged ? 0 : 3;
+	}
+
+	DomainHarnessReport RunDomainHarness(const DomainHarnessSettings& Settings)
+	{
+		DomainHarnessReport report;
+		report.bPassed = false;
+		report.Seconds = 0.0;
+
+		//unique to this run, so harnesses running side by side don't share
+		const std::string name = "PhysicsDomains" + std::to_string(GetCurrentProcessNumber());
+		DomainExchange exchange;
+		if (Settings.Layout.NumDomains == 0 || !exchange.Create(name, Settings.Layout))
+		{
+			return report;
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		std::vector<unsigned long long> processes;
+		for (unsigned int domain = 0; domain < Settings.Layout.NumDomains; ++domain)
+		{
+			processes.push_back(LaunchSelf({ DomainArgument, std::to_string(domain), name }));
+			if (!processes.back())
+			{
+				//the ones already running give up at the first barrier instead of waiting for it to time out
+				exchange.Abort();
+			}
+		}
+
+		for (unsigned long long process : processes)
+		{
+			report.ExitCodes.push_back(process ? WaitForProcess(process) : -1);
+		}
+		report.Seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		uint64_t initialObjects = 0;
+		uint64_t initialIdSum = 0;
+		uint64_t finalObjects = 0;
+		uint64_t finalIdSum = 0;
+		report.bPassed = true;
+		for (unsigned int domain = 0; domain < Settings.Layout.NumDomains; ++domain)
+		{
+			report.Domains.push_back(exchange.GetResult(domain));
+			initialObjects += report.Domains.back().Initial.NumObjects;
+			initialIdSum += report.Domains.back().Initial.IdSum;
+			finalObjects += report.Domains.back().Final.NumObjects;
+			finalIdSum += report.Domains.back().Final.IdSum;
+			report.bPassed = report.bPassed && report.ExitCodes[domain] == 0;
+		}
+		report.bPassed = report.bPassed && initialObjects == finalObjects && initialIdSum == finalIdSum;
+		return report;
+	}
+
+	void PrintDomainHarnessReport(const DomainHarnessReport& Report, std::ostream& Output)
+	{
+		Output << "Domains over " << Report.Domains.size() << " processes: " << (Report.bPassed ? "passed" : "FAILED") << ", " << Report.Seconds << "s" << std::endl;
+		for (size_t domain = 0; domain < Report.Domains.size(); ++domain)
+		{
+			const DomainResult& result = Report.Domains[domain];
+			Output << "  domain " << domain << ": exit " << Report.ExitCodes[domain] << ", objects " << result.Initial.NumObjects << " -> " << result.Final.NumObjects
+				<< ", migrated in " << result.Final.NumMigratedIn << " out " << result.Final.NumMigratedOut << ", ghosts sent " << result.Final.NumGhostsSent
+				<< ", step " << result.Final.StepSeconds << "s (waiting " << result.Final.WaitSeconds << "s)" << std::endl;
+		}
+	}
+}
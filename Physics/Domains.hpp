@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+
+#include "../Core/SharedMemory.hpp"
+
+#include "PhysicsManager.hpp"
+
+namespace Physics
+{
+	//Spatial domain decomposition over several processes, for scenes that outgrow one machine's worth of cores or memory.
+	//The world is cut into slabs along one axis, each simulated by its own process and PhysicsManager. After every frame a
+	//domain sends each neighbour copies of its objects within GhostMargin of their shared boundary (ghosts, added on the
+	//other side as immovable for the next frame, so contacts across the boundary push only the owner's side) and hands over
+	//the objects that left its slab. It all goes through one block of shared memory with a barrier per frame.
+	//Spheres, capsules and boxes are exchanged - planes and meshes aren't, every domain adds the static world itself.
+
+	struct DomainLayout
+	{
+		DomainLayout();
+
+		unsigned int NumDomains;
+		//0, 1 or 2 for x, y or z
+		unsigned int Axis;
+		//split into equal slabs between these, the outermost slabs carry on to infinity
+		float Min;
+		float Max;
+		float GhostMargin;
+		//ghosts plus migrants one domain can send one neighbour in a frame, more than that fails the step
+		size_t MaxExchangeObjects;
+
+		unsigned int GetDomainIndex(float coordinate) const;
+		float GetLowerBound(unsigned int domain) const;
+		float GetUpperBound(unsigned int domain) const;
+	};
+
+	//an object as it goes through the exchange
+	struct DomainObject
+	{
+		Core::Vector4 Position;
+		Core::Vector4 Velocity;
+		Core::Vector4 Axes[3]; //capsule axis in the first, box axes
+		Core::Vector4 Extents; //sphere radius in x, capsule half height and radius in x and y, box half extents
+		float InverseMass;
+		float Restitution;
+		uint32_t Shape; //ShapeType
+		uint32_t Id; //given when the scene is built, kept across domains
+	};
+
+	//ghosts first, migrants after them
+	struct DomainMailbox
+	{
+		uint32_t NumGhosts;
+		uint32_t NumMigrants;
+	};
+
+	struct DomainStats
+	{
+		DomainStats();
+
+		//owned objects, ghosts aren't counted
+		uint64_t NumObjects;
+		//of the owned objects' ids, so the harness can tell nothing was lost or duplicated on the way
+		uint64_t IdSum;
+		uint64_t NumMigratedIn;
+		uint64_t NumMigratedOut;
+		uint64_t NumGhostsSent;
+		//all of Step, and the part of it spent waiting on the other domains
+		double StepSeconds;
+		double WaitSeconds;
+	};
+
+	struct DomainResult
+	{
+		DomainStats Initial;
+		DomainStats Final;
+	};
+
+	//The shared memory between the domains: a barrier, the mailboxes and each domain's results. Every process builds
+	//one from the same layout - the first with Create, the rest with Open.
+	class DomainExchange
+	{
+	public:
+		DomainExchange();
+		DomainExchange(const DomainExchange& other) = delete;
+		DomainExchange& operator=(const DomainExchange& other) = delete;
+
+		bool Create(const std::string& name, const DomainLayout& layout);
+		//false if it isn't there or was created with a different layout
+		bool Open(const std::string& name, const DomainLayout& layout);
+		void Close();
+
+		const DomainLayout& GetLayout() const;
+
+		//What domain from sends its neighbour on side (0 below, 1 above) after the given frame. Mailboxes alternate between frames,
+		//so one domain can fill the next frame's while a slower neighbour is still reading this one's.
+		DomainMailbox& GetMailbox(unsigned int from, unsigned int side, size_t frame);
+		DomainObject* GetMailboxObjects(unsigned int from, unsigned int side, size_t frame);
+
+		//returns once every domain has arrived, false if any of them gave up (or took so long it was given up on)
+		bool Wait();
+		//makes every current and later Wait fail, for a domain that can't go on
+		void Abort();
+		bool IsAborted() const;
+
+		DomainResult& GetResult(unsigned int domain);
+
+	private:
+
+		struct ExchangeHeader;
+
+		size_t GetResultOffset(unsigned int domain) const;
+		size_t GetMailboxOffset(unsigned int from, unsigned int side, size_t frame) const;
+
+		Core::SharedMemory Memory;
+		DomainLayout Layout;
+		ExchangeHeader* Header;
+		size_t MailboxSize;
+	};
+
+	//Runs one domain: owns the objects in its slab of the manager and swaps ghosts and migrants with its neighbours.
+	class DomainNode
+	{
+	public:
+		DomainNode(PhysicsManager& manager, DomainExchange& exchange, unsigned int domainIndex);
+		DomainNode(const DomainNode& other) = delete;
+		DomainNode& operator=(const DomainNode& other) = delete;
+
+		//Like the manager's, but only added if position is in this domain's slab - build every domain from the same full
+		//list and each keeps its own part. Ids have to be unique over the whole scene, and below 0xfffffffe.
+		bool AddCollisionObject(uint32_t id, const Core::Vector4& position, const Core::Vector4& velocity, float radius, float mass = 1.0f, float restitution = 1.0f);
+		bool AddCapsule(uint32_t id, const Core::Vector4& position, const Core::Vector4& velocity, const Core::Vector4& axis, float halfHeight, float radius, float mass = 1.0f, float restitution = 1.0f);
+		bool AddBox(uint32_t id, const Core::Vector4& position, const Core::Vector4& velocity, const Core::Vector4& halfExtents, const Core::Matrix4& orientation, float mass = 1.0f, float restitution = 1.0f);
+
+		//runs the manager's frame then the exchange, false once the exchange fails (a full mailbox, or another domain gave up)
+		bool Step(float deltaTime);
+
+		unsigned int GetDomainIndex() const;
+		const DomainStats& GetStats() const;
+
+	private:
+
+		bool AddIfInside(const DomainObject& object);
+		ObjectHandle AddToManager(const DomainObject& object, bool bGhost);
+		void TrackObject(ObjectHandle handle, uint32_t id);
+		void ForgetObject(ObjectHandle handle);
+
+		PhysicsManager& Manager;
+		DomainExchange& Exchange;
+		unsigned int DomainIndex;
+		size_t FrameIndex;
+		DomainStats Stats;
+
+		//object id by handle slot, or one of the markers for ghosts and objects the node doesn't own
+		std::vector<uint32_t> SlotIds;
+
+		//scratch for reading the frame back
+		simd_vector<PhysicsObject> Objects;
+		std::vector<ObjectHandle> Handles;
+		ShapeData Shapes;
+	};
+
+	struct DomainHarnessSettings
+	{
+		DomainHarnessSettings();
+
+		DomainLayout Layout;
+		size_t NumFrames;
+		float DeltaTime;
+		//worker threads per domain process
+		int NumThreads;
+
+		//Called in every domain process on a fresh manager - add the static world to the manager and the objects through the node.
+		//It has to build the same scene every time.
+		std::function<void(PhysicsManager&, DomainNode&)> Build;
+	};
+
+	struct DomainHarnessReport
+	{
+		//every process exited cleanly and the objects at the end are exactly the ones at the start
+		bool bPassed;
+		std::vector<DomainResult> Domains;
+		std::vector<int> ExitCodes;
+		//from launching the processes until the last one exited
+		double Seconds;
+	};
+
+	//Single-node test harness: runs the scene split over Layout.NumDomains copies of the current executable, one domain each.
+	//The program has to check IsDomainProcess first thing in main and hand over to RunDomainProcess, with the same settings
+	//(as DomainHarness does):
+	//
+	//	if (IsDomainProcess(argc, argv))
+	//		return RunDomainProcess(argc, argv, settings);
+	//	PrintDomainHarnessReport(RunDomainHarness(settings), std::cout);
+	bool IsDomainProcess(int argc, char** argv);
+	int RunDomainProcess(int argc, char** argv, const DomainHarnessSettings& Settings);
+	DomainHarnessReport RunDomainHarness(const DomainHarnessSettings& Settings);
+
+	void PrintDomainHarnessReport(const DomainHarnessReport& Report, std::ostream& Output);
+}
@@ -0,0 +1,105 @@
+#include "ForceGenerators.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Core;
+namespace Physics
+{
+	ForceGenerator::~ForceGenerator()
+	{}
+
+	void ForceGenerator::RemapObjects(const std::vector<size_t>&)
+	{}
+
+	UniformGravity::UniformGravity(const Vector4& acceleration) :
+		Acceleration(acceleration)
+	{}
+
+	Vector4 UniformGravity::GetAcceleration(const simd_vector<PhysicsObject>&, const PhysicsObject&, const Vector4&, const Vector4&) const
+	{
+		return Acceleration;
+	}
+
+	PointAttractor::PointAttractor(const Vector4& center, float strength, float falloff, float minDistance) :
+		Center(center),
+		Strength(strength),
+		Falloff(falloff),
+		MinDistance(minDistance)
+	{}
+
+	Vector4 PointAttractor::GetAcceleration(const simd_vector<PhysicsObject>&, const PhysicsObject&, const Vector4& Position, const Vector4&) const
+	{
+		const Vector4 offset = Center - Position;
+		const float distance = std::max(offset.length3(), MinDistance);
+		const float acceleration = Strength / std::pow(distance, Falloff);
+		return offset * (acceleration / distance);
+	}
+
+	Drag::Drag(float linearCoefficient, float quadraticCoefficient) :
+		LinearCoefficient(linearCoefficient),
+		QuadraticCoefficient(quadraticCoefficient)
+	{}
+
+	Vector4 Drag::GetAcceleration(const simd_vector<PhysicsObject>&, const PhysicsObject& Object, const Vector4&, const Vector4& Velocity) const
+	{
+		const float speed = Velocity.length3();
+		return Velocity * (-(LinearCoefficient + QuadraticCoefficient * speed) * Object.InverseMass);
+	}
+
+	void Springs::AddSpring(size_t indexA, size_t indexB, float restLength, float stiffness, float damping)
+	{
+		SpringEnds[indexA].push_back(SpringEnd{ indexB, restLength, stiffness, damping });
+		SpringEnds[indexB].push_back(SpringEnd{ indexA, restLength, stiffness, damping });
+	}
+
+	Vector4 Springs::GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Vector4& Position, const Vector4& Velocity) const
+	{
+		Vector4 force(0.0f);
+		auto ends = SpringEnds.find(Object.Index);
+		if (ends == SpringEnds.end())
+		{
+			return force;
+		}
+
+		for (auto& end : ends->second)
+		{
+			//the other end is held where it was at the start of the step, it's being integrated on its own at the same time
+			const PhysicsObject& other = Objects[end.OtherIndex];
+			const Vector4 offset = other.Position - Position;
+			const float length = offset.length3();
+			if (length <= 0.0f)
+			{
+				continue;
+			}
+
+			const Vector4 direction = offset / length;
+			const float stretchSpeed = (other.Velocity - Velocity).dot3(direction);
+			force += direction * (end.Stiffness * (length - end.RestLength) + end.Damping * stretchSpeed);
+		}
+		return force * Object.InverseMass;
+	}
+
+	void Springs::RemapObjects(const std::vector<size_t>& NewIndices)
+	{
+		std::unordered_map<size_t, std::vector<SpringEnd>> remapped;
+		for (auto& ends : SpringEnds)
+		{
+			const size_t index = NewIndices[ends.first];
+			if (index == InvalidObjectIndex)
+			{
+				continue;
+			}
+
+			auto& newEnds = remapped[index];
+			for (auto& end : ends.second)
+			{
+				if (NewIndices[end.OtherIndex] != InvalidObjectIndex)
+				{
+					newEnds.push_back(SpringEnd{ NewIndices[end.OtherIndex], end.RestLength, end.Stiffness, end.Damping });
+				}
+			}
+		}
+		SpringEnds = std::move(remapped);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "Types.hpp"
+
+namespace Physics
+{
+	//A field of accelerations over position and velocity. Evaluated by the integrator at every stage of the step, from the
+	//integration stage's worker threads, so implementations must not write to anything.
+	class ForceGenerator
+	{
+	public:
+		virtual ~ForceGenerator();
+
+		//Acceleration of Object if it were at Position moving at Velocity. Objects is the state at the start of the step -
+		//generators that depend on other objects read them from there, not from the ones being integrated.
+		virtual Core::Vector4 GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Core::Vector4& Position, const Core::Vector4& Velocity) const = 0;
+
+		//objects have moved to NewIndices[old index] (InvalidObjectIndex if removed), for generators that hold on to indices
+		virtual void RemapObjects(const std::vector<size_t>& NewIndices);
+
+		//aligned new and delete for the Vector4 members - construct with new rather than make_shared
+		void* operator new(size_t i)
+		{
+			return _mm_malloc(i, 16);
+		}
+
+		void operator delete(void* p)
+		{
+			_mm_free(p);
+		}
+	};
+
+	//constant acceleration for every object, regardless of mass
+	class UniformGravity : public ForceGenerator
+	{
+	public:
+		UniformGravity(const Core::Vector4& acceleration);
+
+		virtual Core::Vector4 GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Core::Vector4& Position, const Core::Vector4& Velocity) const;
+
+		Core::Vector4 Acceleration;
+	};
+
+	//pulls toward a point with acceleration Strength / distance^Falloff (0 for a constant pull, 2 for gravity)
+	class PointAttractor : public ForceGenerator
+	{
+	public:
+		PointAttractor(const Core::Vector4& center, float strength, float falloff = 2.0f, float minDistance = 1.0f);
+
+		virtual Core::Vector4 GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Core::Vector4& Position, const Core::Vector4& Velocity) const;
+
+		Core::Vector4 Center;
+		float Strength;
+		float Falloff;
+		//distances are clamped to this to keep the force finite near the center
+		float MinDistance;
+	};
+
+	//linear and quadratic drag against the velocity
+	class Drag : public ForceGenerator
+	{
+	public:
+		Drag(float linearCoefficient, float quadraticCoefficient = 0.0f);
+
+		virtual Core::Vector4 GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Core::Vector4& Position, const Core::Vector4& Velocity) const;
+
+		float LinearCoefficient;
+		float QuadraticCoefficient;
+	};
+
+	//damped springs between pairs of objects
+	class Springs : public ForceGenerator
+	{
+	public:
+		void AddSpring(size_t indexA, size_t indexB, float restLength, float stiffness, float damping = 0.0f);
+
+		virtual Core::Vector4 GetAcceleration(const simd_vector<PhysicsObject>& Objects, const PhysicsObject& Object, const Core::Vector4& Position, const Core::Vector4& Velocity) const;
+
+		//springs attached to a removed object are removed with it
+		virtual void RemapObjects(const std::vector<size_t>& NewIndices);
+
+	private:
+
+		struct SpringEnd
+		{
+			size_t OtherIndex;
+			float RestLength;
+			float Stiffness;
+			float Damping;
+		};
+
+		//each spring is stored at both ends, so every object finds its own side directly
+		std::unordered_map<size_t, std::vector<SpringEnd>> SpringEnds;
+	};
+}
@@ -0,0 +1,312 @@
+#include "HierarchicalGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iterator>
+
+using namespace Core;
+namespace Physics
+{
+	//cells are keyed by level and 19 bits of each coordinate - cells that far apart wrap onto the same key, which only
+	//brings back extra objects for the exact tests to throw out
+	static const uint64_t CoordinateMask = (1ull << 19) - 1;
+	static const uint64_t EmptyCellKey = ~0ull;
+
+	//roughly how many of a level's objects can be gone through in the time it takes to look up one cell
+	static const double SlabEntriesPerCell = 8.0;
+	//queries up to this many cells, 3 by 3 by 3, always looked up directly
+	static const double MaxDirectCells = 27.0;
+
+	//so zero radius objects don't shrink the finest level to nothing
+	static const float MinCellSize = 1e-4f;
+
+	//SplitMix64 finalizer
+	static uint64_t MixBits(uint64_t Value)
+	{
+		Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+		return Value ^ (Value >> 31);
+	}
+
+	static int64_t CellCoordinate(float Value, float InverseCellSize)
+	{
+		//clamped first, converting anything out of range is undefined
+		return static_cast<int64_t>(std::floor(std::max(std::min(Value * InverseCellSize, 1e18f), -1e18f)));
+	}
+
+	static uint64_t PackCellKey(unsigned int Level, int64_t X, int64_t Y, int64_t Z)
+	{
+		return (static_cast<uint64_t>(Level) << 57) | ((static_cast<uint64_t>(X) & CoordinateMask) << 38) | ((static_cast<uint64_t>(Y) & CoordinateMask) << 19) | (static_cast<uint64_t>(Z) & CoordinateMask);
+	}
+
+	HierarchicalGrid::HierarchicalGrid() :
+		BaseCellSize(1.0f),
+		NumLevels(0),
+		OccupiedLevels(0),
+		SleepingLevels(0),
+		CellMask(0)
+	{
+		for (auto& level : Levels)
+		{
+			level = GridLevel{ 1.0f, 1.0f, 0.0f, 0, 0, 0, 0 };
+		}
+	}
+
+	void HierarchicalGrid::Rebuild(simd_vector<PhysicsObject>& Objects)
+	{
+		ObjectPointers.clear();
+		float minRadius = std::numeric_limits<float>::max();
+		for (auto& object : Objects)
+		{
+			if (!IsWorldShape(object.Shape))
+			{
+				ObjectPointers.push_back(&object);
+				minRadius = std::min(minRadius, object.CollisionRadius);
+			}
+		}
+
+		const size_t numObjects = ObjectPointers.size();
+		NumLevels = 0;
+		OccupiedLevels = 0;
+		SleepingLevels = 0;
+		SleepingEntries.clear();
+		if (numObjects == 0)
+		{
+			return;
+		}
+
+		BaseCellSize = std::max(4.0f * minRadius, MinCellSize);
+		for (unsigned int level = 0; level < MaxLevels; ++level)
+		{
+			const float cellSize = std::ldexp(BaseCellSize, static_cast<int>(level));
+			Levels[level] = GridLevel{ cellSize, 1.0f / cellSize, 0.0f, 0, 0, 0, 0 };
+		}
+
+		//counting sort by level
+		ObjectLevels.resize(numObjects);
+		for (size_t object = 0; object < numObjects; ++object)
+		{
+			const float radius = ObjectPointers[object]->CollisionRadius;
+			const unsigned int level = GetLevel(radius);
+			ObjectLevels[object] = static_cast<uint8_t>(level);
+			Levels[level].MaxRadius = std::max(Levels[level].MaxRadius, radius);
+			++Levels[level].NumObjects;
+			NumLevels = std::max(NumLevels, level + 1);
+			OccupiedLevels |= 1u << level;
+		}
+
+		size_t levelCursors[MaxLevels];
+		size_t firstObject = 0;
+		for (unsigned int level = 0; level < NumLevels; ++level)
+		{
+			Levels[level].FirstObject = firstObject;
+			levelCursors[level] = firstObject;
+			firstObject += Levels[level].NumObjects;
+		}
+
+		LevelEntries.resize(numObjects);
+		for (size_t object = 0; object < numObjects; ++object)
+		{
+			const Vector4& position = ObjectPointers[object]->Position;
+			LevelEntries[levelCursors[ObjectLevels[object]]++] = LevelEntry{ position.X, position.Y, position.Z, ObjectPointers[object] };
+		}
+		for (unsigned int level = 0; level < NumLevels; ++level)
+		{
+			const auto begin = LevelEntries.begin() + Levels[level].FirstObject;
+			std::sort(begin, begin + Levels[level].NumObjects, [](const LevelEntry& A, const LevelEntry& B) { return A.X < B.X; });
+
+			//picked out in order, so they're sorted as well
+			Levels[level].FirstSleeper = SleepingEntries.size();
+			std::copy_if(begin, begin + Levels[level].NumObjects, std::back_inserter(SleepingEntries), [](const LevelEntry& Entry) { return Entry.Object->bAsleep; });
+			Levels[level].NumSleepers = SleepingEntries.size() - Levels[level].FirstSleeper;
+			if (Levels[level].NumSleepers > 0)
+			{
+				SleepingLevels |= 1u << level;
+			}
+		}
+
+		//Then by cell: one pass to find or add every object's cell and count it, one over the table to lay the cells out,
+		//and one to drop the objects in. Linear in the objects however they're spread.
+		size_t numSlots = 16;
+		while (numSlots < 2 * numObjects)
+		{
+			numSlots *= 2;
+		}
+		Cells.resize(numSlots);
+		std::fill(Cells.begin(), Cells.end(), GridCell{ EmptyCellKey, 0, 0 });
+		CellMask = numSlots - 1;
+		CellBits.assign(numSlots / 16, 0);
+		CellBitMask = numSlots * 4 - 1;
+
+		ObjectCells.resize(numObjects);
+		for (size_t object = 0; object < numObjects; ++object)
+		{
+			const uint64_t key = MakeCellKey(ObjectLevels[object], ObjectPointers[object]->Position);
+			const uint64_t hash = MixBits(key);
+			uint64_t slot = hash & CellMask;
+			while (Cells[slot].Key != EmptyCellKey && Cells[slot].Key != key)
+			{
+				slot = (slot + 1) & CellMask;
+			}
+
+			Cells[slot].Key = key;
+			++Cells[slot].Count;
+			const uint64_t bit = (hash >> 32) & CellBitMask;
+			CellBits[bit >> 6] |= 1ull << (bit & 63);
+			ObjectCells[object] = static_cast<uint32_t>(slot);
+		}
+
+		uint32_t cellObject = 0;
+		for (auto& cell : Cells)
+		{
+			if (cell.Key != EmptyCellKey)
+			{
+				cell.FirstObject = cellObject;
+				cellObject += cell.Count;
+				//counted back up as the objects go in
+				cell.Count = 0;
+			}
+		}
+
+		CellObjects.resize(numObjects);
+		for (size_t object = 0; object < numObjects; ++object)
+		{
+			GridCell& cell = Cells[ObjectCells[object]];
+			CellObjects[cell.FirstObject + cell.Count++] = ObjectPointers[object];
+		}
+	}
+
+	unsigned int HierarchicalGrid::GetLevel(float Radius) const
+	{
+		//the finest level with cells at least four times the radius, cell sizes being BaseCellSize * 2^level
+		const float ratio = 4.0f * Radius / BaseCellSize;
+		if (!(ratio > 1.0f))
+		{
+			return 0;
+		}
+		if (ratio >= std::ldexp(1.0f, MaxLevels - 1))
+		{
+			return MaxLevels - 1;
+		}
+
+		int exponent;
+		const float mantissa = std::frexp(ratio, &exponent);
+		return static_cast<unsigned int>(mantissa == 0.5f ? exponent - 1 : exponent);
+	}
+
+	uint64_t HierarchicalGrid::MakeCellKey(unsigned int Level, const Vector4& Position) const
+	{
+		const float inverseCellSize = Levels[Level].InverseCellSize;
+		return PackCellKey(Level, CellCoordinate(Position.X, inverseCellSize), CellCoordinate(Position.Y, inverseCellSize), CellCoordinate(Position.Z, inverseCellSize));
+	}
+
+	const HierarchicalGrid::GridCell* HierarchicalGrid::FindCell(uint64_t Key) const
+	{
+		const uint64_t hash = MixBits(Key);
+		const uint64_t bit = (hash >> 32) & CellBitMask;
+		if ((CellBits[bit >> 6] & (1ull << (bit & 63))) == 0)
+		{
+			return nullptr;
+		}
+
+		uint64_t slot = hash & CellMask;
+		while (Cells[slot].Key != EmptyCellKey)
+		{
+			if (Cells[slot].Key == Key)
+			{
+				return &Cells[slot];
+			}
+			slot = (slot + 1) & CellMask;
+		}
+		return nullptr;
+	}
+
+	void HierarchicalGrid::GatherLevel(unsigned int Level, const Vector4& Min, const Vector4& Max, bool bSleepersOnly, std::vector<PhysicsObject*>& OutObjects) const
+	{
+		const GridLevel& level = Levels[Level];
+
+		int64_t low[3];
+		int64_t high[3];
+		double numCells = 1.0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			low[axis] = CellCoordinate(Min[axis], level.InverseCellSize);
+			high[axis] = CellCoordinate(Max[axis], level.InverseCellSize);
+			numCells *= static_cast<double>(high[axis] - low[axis] + 1);
+		}
+
+		//A slab's entry is a few floats in a row against a likely cache miss for a cell. Small queries are only a handful of
+		//cells, so they don't search for the slab unless the whole level is small enough to go through anyway.
+		auto slabBegin = bSleepersOnly ? SleepingEntries.begin() + level.FirstSleeper : LevelEntries.begin() + level.FirstObject;
+		auto slabEnd = slabBegin + (bSleepersOnly ? level.NumSleepers : level.NumObjects);
+		if (numCells > MaxDirectCells)
+		{
+			slabBegin = std::lower_bound(slabBegin, slabEnd, Min.X, [](const LevelEntry& Entry, float X) { return Entry.X < X; });
+			slabEnd = std::upper_bound(slabBegin, slabEnd, Max.X, [](float X, const LevelEntry& Entry) { return X < Entry.X; });
+		}
+		if (static_cast<double>(slabEnd - slabBegin) <= numCells * SlabEntriesPerCell)
+		{
+			for (auto entry = slabBegin; entry != slabEnd; ++entry)
+			{
+				if (entry->X >= Min.X && entry->X <= Max.X && entry->Y >= Min.Y && entry->Y <= Max.Y && entry->Z >= Min.Z && entry->Z <= Max.Z)
+				{
+					OutObjects.push_back(entry->Object);
+				}
+			}
+			return;
+		}
+
+		for (int64_t x = low[0]; x <= high[0]; ++x)
+		{
+			for (int64_t y = low[1]; y <= high[1]; ++y)
+			{
+				for (int64_t z = low[2]; z <= high[2]; ++z)
+				{
+					const GridCell* cell = FindCell(PackCellKey(Level, x, y, z));
+					if (cell == nullptr)
+					{
+						continue;
+					}
+
+					const auto cellBegin = CellObjects.begin() + cell->FirstObject;
+					if (bSleepersOnly)
+					{
+						std::copy_if(cellBegin, cellBegin + cell->Count, std::back_inserter(OutObjects), [](const PhysicsObject* Object) { return Object->bAsleep; });
+					}
+					else
+					{
+						OutObjects.insert(OutObjects.end(), cellBegin, cellBegin + cell->Count);
+					}
+				}
+			}
+		}
+	}
+
+	void HierarchicalGrid::GetPotentialColliders(const Vector4& Position, float Radius, std::vector<PhysicsObject*>& OutObjects) const
+	{
+		//objects are in the cell of their center, so look as far out as the level's largest could reach from there
+		const unsigned int ownLevel = GetLevel(Radius);
+		for (unsigned int level = 0; level < NumLevels; ++level)
+		{
+			const bool bSleepersOnly = level < ownLevel;
+			if ((bSleepersOnly ? SleepingLevels : OccupiedLevels) & (1u << level))
+			{
+				const Vector4 extent(Radius + Levels[level].MaxRadius);
+				GatherLevel(level, Position - extent, Position + extent, bSleepersOnly, OutObjects);
+			}
+		}
+	}
+
+	void HierarchicalGrid::GetObjectsInBounds(const BoundingBox& Bounds, std::vector<PhysicsObject*>& OutObjects) const
+	{
+		for (unsigned int level = 0; level < NumLevels; ++level)
+		{
+			if (OccupiedLevels & (1u << level))
+			{
+				const Vector4 extent(Levels[level].MaxRadius);
+				GatherLevel(level, Bounds.Min - extent, Bounds.Max + extent, false, OutObjects);
+			}
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Types.hpp"
+#include "../Core/BoundingBox.hpp"
+
+namespace Physics
+{
+	enum class BroadphaseType
+	{
+		Octree,
+		HierarchicalGrid
+	};
+
+	//Loose hashed grids at cell sizes doubling from twice the smallest object's diameter up. Each object goes into the one
+	//cell its center is in, on the finest level whose cells are at least twice as wide as it is, so nothing is duplicated and
+	//an object only has to look at the 2x2x2 cells around it on its own level and the coarser ones however much the sizes
+	//vary. Levels nothing is on are skipped, so a scene of equal sizes is a single uniform grid.
+	class HierarchicalGrid
+	{
+	public:
+		HierarchicalGrid();
+
+		//planes and meshes stay out of it, like the octree
+		void Rebuild(simd_vector<PhysicsObject>& Objects);
+
+		//level an object of Radius was put on this rebuild
+		unsigned int GetLevel(float Radius) const;
+
+		//For finding pairs from the awake objects: everything that could touch a sphere of Radius at Position on its level
+		//and the coarser ones, at most 8 cells per level however big the sphere is, and only the sleepers on the finer
+		//levels. A pair of awake objects on different levels is found by its smaller object, and sleepers never need to
+		//query, as with the octree.
+		void GetPotentialColliders(const Core::Vector4& Position, float Radius, std::vector<PhysicsObject*>& OutObjects) const;
+
+		//every object whose bounds could overlap Bounds, on all levels (may contain duplicates for very wide bounds)
+		void GetObjectsInBounds(const Core::BoundingBox& Bounds, std::vector<PhysicsObject*>& OutObjects) const;
+
+	private:
+
+		//enough for cell sizes from the smallest object up to over a billion times that
+		static const unsigned int MaxLevels = 32;
+
+		struct GridLevel
+		{
+			float CellSize;
+			float InverseCellSize;
+			//largest radius on the level - only the top one can hold objects wider than its cells
+			float MaxRadius;
+			//the level's range of LevelEntries, and of SleepingEntries
+			size_t FirstObject;
+			size_t NumObjects;
+			size_t FirstSleeper;
+			size_t NumSleepers;
+		};
+
+		//an object's position kept next to it, so going through a level's objects doesn't touch the objects themselves
+		struct LevelEntry
+		{
+			float X;
+			float Y;
+			float Z;
+			PhysicsObject* Object;
+		};
+
+		//slot of the cell table, with its range of CellObjects
+		struct GridCell
+		{
+			uint64_t Key;
+			uint32_t FirstObject;
+			uint32_t Count;
+		};
+
+		uint64_t MakeCellKey(unsigned int Level, const Core::Vector4& Position) const;
+		const GridCell* FindCell(uint64_t Key) const;
+
+		//Objects on one level centered in [Min, Max] or in the cells it overlaps, only the sleeping ones if bSleepersOnly.
+		//Looked up cell by cell, or straight from the level's entries in the slab along x when that's fewer to go through,
+		//as it is for queries much wider than the level's cells or levels with only a few objects.
+		void GatherLevel(unsigned int Level, const Core::Vector4& Min, const Core::Vector4& Max, bool bSleepersOnly, std::vector<PhysicsObject*>& OutObjects) const;
+
+		float BaseCellSize;
+		GridLevel Levels[MaxLevels];
+		//levels above this are empty
+		unsigned int NumLevels;
+		//bit per level with anything on it, and with any sleepers on it, so queries skip the rest without touching their GridLevel
+		uint32_t OccupiedLevels;
+		uint32_t SleepingLevels;
+
+		//open addressing, at least twice as many slots as objects - rebuilt in place, so it only allocates when the scene grows
+		std::vector<GridCell> Cells;
+		uint64_t CellMask;
+		//a bit per hash of the occupied cells, four times as many bits as slots - small enough to stay in cache, so most
+		//lookups of empty cells stop here rather than missing on the table
+		std::vector<uint64_t> CellBits;
+		uint64_t CellBitMask;
+		//every object, grouped by cell
+		std::vector<PhysicsObject*> CellObjects;
+		//every object, grouped by level and sorted along x within each
+		std::vector<LevelEntry> LevelEntries;
+		//the same for just the sleeping objects
+		std::vector<LevelEntry> SleepingEntries;
+
+		//scratch, per object: its cell slot, and its level
+		std::vector<uint32_t> ObjectCells;
+		std::vector<uint8_t> ObjectLevels;
+		std::vector<PhysicsObject*> ObjectPointers;
+	};
+}
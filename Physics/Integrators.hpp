@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Types.hpp"
+
+namespace Physics
+{
+	enum class IntegratorType
+	{
+		SymplecticEuler,
+		VelocityVerlet,
+		RK4
+	};
+
+	//Batch kernels - each one steps the objects at Indices[0, Count) in place.
+	//Acceleration(object, position, velocity) is evaluated as many times per object as the method needs,
+	//so it's a template parameter to let the compiler inline it into the loop.
+
+	//first order, but symplectic so energy doesn't drift off in orbits or springs
+	template<class AccelerationFunction>
+	void IntegrateSymplecticEuler(simd_vector<PhysicsObject>& Objects, const size_t* Indices, size_t Count, float DeltaTime, const AccelerationFunction& Acceleration)
+	{
+		for (size_t i = 0; i < Count; ++i)
+		{
+			PhysicsObject& object = Objects[Indices[i]];
+			object.Velocity += Acceleration(object, object.Position, object.Velocity) * DeltaTime;
+			object.Position += object.Velocity * DeltaTime;
+		}
+	}
+
+	//second order, two acceleration evaluations per step
+	template<class AccelerationFunction>
+	void IntegrateVelocityVerlet(simd_vector<PhysicsObject>& Objects, const size_t* Indices, size_t Count, float DeltaTime, const AccelerationFunction& Acceleration)
+	{
+		const float halfDeltaTime = DeltaTime * 0.5f;
+		for (size_t i = 0; i < Count; ++i)
+		{
+			PhysicsObject& object = Objects[Indices[i]];
+			const Core::Vector4 halfStepVelocity = object.Velocity + Acceleration(object, object.Position, object.Velocity) * halfDeltaTime;
+			object.Position += halfStepVelocity * DeltaTime;
+
+			//velocity dependent accelerations see the half-step velocity at the new position
+			object.Velocity = halfStepVelocity + Acceleration(object, object.Position, halfStepVelocity) * halfDeltaTime;
+		}
+	}
+
+	//fourth order, four acceleration evaluations per step
+	template<class AccelerationFunction>
+	void IntegrateRK4(simd_vector<PhysicsObject>& Objects, const size_t* Indices, size_t Count, float DeltaTime, const AccelerationFunction& Acceleration)
+	{
+		using Core::Vector4;
+
+		const float halfDeltaTime = DeltaTime * 0.5f;
+		const float sixthDeltaTime = DeltaTime / 6.0f;
+		for (size_t i = 0; i < Count; ++i)
+		{
+			PhysicsObject& object = Objects[Indices[i]];
+			const Vector4 position = object.Position;
+			const Vector4 velocity = object.Velocity;
+
+			const Vector4 velocity1 = velocity;
+			const Vector4 acceleration1 = Acceleration(object, position, velocity1);
+
+			const Vector4 velocity2 = velocity + acceleration1 * halfDeltaTime;
+			const Vector4 acceleration2 = Acceleration(object, position + velocity1 * halfDeltaTime, velocity2);
+
+			const Vector4 velocity3 = velocity + acceleration2 * halfDeltaTime;
+			const Vector4 acceleration3 = Acceleration(object, position + velocity2 * halfDeltaTime, velocity3);
+
+			const Vector4 velocity4 = velocity + acceleration3 * DeltaTime;
+			const Vector4 acceleration4 = Acceleration(object, position + velocity3 * DeltaTime, velocity4);
+
+			object.Position = position + (velocity1 + (velocity2 + velocity3) * 2.0f + velocity4) * sixthDeltaTime;
+			object.Velocity = velocity + (acceleration1 + (acceleration2 + acceleration3) * 2.0f + acceleration4) * sixthDeltaTime;
+		}
+	}
+
+	template<class AccelerationFunction>
+	void Integrate(IntegratorType Type, simd_vector<PhysicsObject>& Objects, const size_t* Indices, size_t Count, float DeltaTime, const AccelerationFunction& Acceleration)
+	{
+		//switch once per batch rather than per object
+		switch (Type)
+		{
+		case IntegratorType::SymplecticEuler:
+			IntegrateSymplecticEuler(Objects, Indices, Count, DeltaTime, Acceleration);
+			break;
+		case IntegratorType::VelocityVerlet:
+			IntegrateVelocityVerlet(Objects, Indices, Count, DeltaTime, Acceleration);
+			break;
+		case IntegratorType::RK4:
+			IntegrateRK4(Objects, Indices, Count, DeltaTime, Acceleration);
+			break;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#include "ObjectHandles.hpp"
+
+namespace Physics
+{
+	ObjectHandle ObjectHandleTable::Allocate()
+	{
+		if (FreeSlots.empty())
+		{
+			Slots.push_back(Slot{ InvalidObjectIndex, 0 });
+			return ObjectHandle{ static_cast<uint32_t>(Slots.size() - 1), 0 };
+		}
+
+		const uint32_t slot = FreeSlots.back();
+		FreeSlots.pop_back();
+		return ObjectHandle{ slot, Slots[slot].Generation };
+	}
+
+	void ObjectHandleTable::Bind(ObjectHandle Handle, size_t DenseIndex)
+	{
+		Slots[Handle.Slot].DenseIndex = DenseIndex;
+		DenseSlots.resize(DenseIndex + 1);
+		DenseSlots[DenseIndex] = Handle.Slot;
+	}
+
+	bool ObjectHandleTable::Release(ObjectHandle Handle)
+	{
+		if (!IsValid(Handle))
+		{
+			return false;
+		}
+
+		//bumping the generation is what invalidates every copy of the handle still out there
+		Slot& slot = Slots[Handle.Slot];
+		slot.DenseIndex = InvalidObjectIndex;
+		++slot.Generation;
+		FreeSlots.push_back(Handle.Slot);
+		return true;
+	}
+
+	bool ObjectHandleTable::IsValid(ObjectHandle Handle) const
+	{
+		return Handle.Slot < Slots.size() && Slots[Handle.Slot].Generation == Handle.Generation;
+	}
+
+	size_t ObjectHandleTable::Find(ObjectHandle Handle) const
+	{
+		return IsValid(Handle) ? Slots[Handle.Slot].DenseIndex : InvalidObjectIndex;
+	}
+
+	void ObjectHandleTable::MoveDense(size_t From, size_t To)
+	{
+		DenseSlots[To] = DenseSlots[From];
+		Slots[DenseSlots[To]].DenseIndex = To;
+	}
+
+	void ObjectHandleTable::PopDense()
+	{
+		DenseSlots.pop_back();
+	}
+
+	void ObjectHandleTable::Remap(const std::vector<size_t>& NewIndices)
+	{
+		std::vector<uint32_t> remapped(DenseSlots.size());
+		for (size_t index = 0; index < DenseSlots.size(); ++index)
+		{
+			remapped[NewIndices[index]] = DenseSlots[index];
+			Slots[DenseSlots[index]].DenseIndex = NewIndices[index];
+		}
+		std::swap(DenseSlots, remapped);
+	}
+
+	ObjectHandle ObjectHandleTable::GetHandle(size_t DenseIndex) const
+	{
+		const uint32_t slot = DenseSlots[DenseIndex];
+		return ObjectHandle{ slot, Slots[slot].Generation };
+	}
+
+	void ObjectHandleTable::SaveSnapshot(SnapshotWriter& Writer) const
+	{
+		Writer.Write(SnapshotSection::HandleSlots, 0, Slots);
+		Writer.Write(SnapshotSection::FreeHandleSlots, 0, FreeSlots);
+		Writer.Write(SnapshotSection::DenseHandleSlots, 0, DenseSlots);
+	}
+
+	bool ObjectHandleTable::LoadSnapshot(const SnapshotReader& Reader)
+	{
+		return Reader.Read(SnapshotSection::HandleSlots, 0, Slots) &&
+			Reader.Read(SnapshotSection::FreeHandleSlots, 0, FreeSlots) &&
+			Reader.Read(SnapshotSection::DenseHandleSlots, 0, DenseSlots);
+	}
+}
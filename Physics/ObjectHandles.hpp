@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Types.hpp"
+#include "Snapshot.hpp"
+
+namespace Physics
+{
+	//Maps generational handles to dense object indices. The dense index of an object changes when others are removed,
+	//the handle doesn't - and a handle to a removed object stays invalid even after its slot is reused.
+	//Not thread safe, the manager locks around it.
+	class ObjectHandleTable
+	{
+	public:
+		//new handle, not bound to a dense index until the object is actually added
+		ObjectHandle Allocate();
+
+		//DenseIndex must be the next index (objects are only ever appended)
+		void Bind(ObjectHandle Handle, size_t DenseIndex);
+
+		//false if the handle was already stale
+		bool Release(ObjectHandle Handle);
+
+		//allocated and not released, whether or not it's bound yet
+		bool IsValid(ObjectHandle Handle) const;
+
+		//InvalidObjectIndex if the handle is stale or not bound yet
+		size_t Find(ObjectHandle Handle) const;
+
+		//the object at From has been moved to To (swap-and-pop)
+		void MoveDense(size_t From, size_t To);
+		void PopDense();
+
+		//objects have moved to NewIndices[old index] - a permutation, nothing removed
+		void Remap(const std::vector<size_t>& NewIndices);
+
+		//handle of the object at DenseIndex
+		ObjectHandle GetHandle(size_t DenseIndex) const;
+
+		//load into an empty table - false if the sections are missing
+		void SaveSnapshot(SnapshotWriter& Writer) const;
+		bool LoadSnapshot(const SnapshotReader& Reader);
+
+	private:
+
+		struct Slot
+		{
+			size_t DenseIndex;
+			uint32_t Generation;
+		};
+
+		std::vector<Slot> Slots;
+		std::vector<uint32_t> FreeSlots;
+		//slot for each dense index
+		std::vector<uint32_t> DenseSlots;
+	};
+}
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <cmath>
 
 using namespace Core;
 namespace Physics
@@ -9,39 +10,86 @@ namespace Physics
 	static const int MaxObjectsInLeaf = 100;
 
 	OctreeNode::OctreeNode(const BoundingBox& bounds) :
-		Bounds(bounds)
+		Parent(nullptr),
+		Bounds(bounds),
+		CenterOfMass(0.0f),
+		Mass(0.0f)
 	{
 		std::fill(std::begin(Children), std::end(Children), nullptr);
 
 		bLeaf = false;
+		FirstObject = 0;
+		NumObjects = 0;
+		NumOwnedObjects = 0;
+	}
+
+	void OctreeNode::Reset(const BoundingBox& bounds, OctreeNode* parent)
+	{
+		Parent = parent;
+		std::fill(std::begin(Children), std::end(Children), nullptr);
+		bLeaf = false;
+		FirstObject = 0;
+		NumObjects = 0;
+		NumOwnedObjects = 0;
+		Bounds = bounds;
+		CenterOfMass = Vector4(0.0f);
+		Mass = 0.0f;
 	}
 
 	Octree::Octree(const BoundingBox& bounds) :
-		Root(std::make_unique<OctreeNode>(bounds))
+		NumUsedNodes(0),
+		Root(nullptr)
+	{
+		Root = AcquireNode(bounds, nullptr);
+	}
+
+	OctreeNode* Octree::AcquireNode(const BoundingBox& Bounds, OctreeNode* Parent)
+	{
+		if (NumUsedNodes == NodePool.size())
+		{
+			NodePool.push_back(std::unique_ptr<OctreeNode>(new OctreeNode(Bounds)));
+		}
+
+		OctreeNode* node = NodePool[NumUsedNodes++].get();
+		node->Reset(Bounds, Parent);
+		return node;
+	}
+
+	const BoundingBox& Octree::GetBounds() const
 	{
+		return Root->Bounds;
 	}
 
 	void Octree::Rebuild(simd_vector<PhysicsObject>& Objects)
 	{
-		//build array of pointers (safe for now since the manager's array is preemptively sized)
-		std::vector<PhysicsObject*> objectPointers;
-		objectPointers.reserve(Objects.size());
-		std::transform(Objects.begin(), Objects.end(), std::back_inserter(objectPointers), [](auto& object) {return &object; });
+		//build array of pointers (safe, objects are only added and removed at the start of the frame, before this)
+		//planes and meshes are static world geometry with their own queries - planes would blow the bounds up, and meshes have their own BVH
+		ObjectPointers.clear();
+		for (auto& object : Objects)
+		{
+			if (!IsWorldShape(object.Shape))
+			{
+				ObjectPointers.push_back(&object);
+			}
+		}
 
 		BoundingBox newBounds;
-		for (auto& object : Objects)
+		for (auto object : ObjectPointers)
 		{
-			newBounds.Min.X = std::min(newBounds.Min.X, object.Position.X - object.CollisionRadius);
-			newBounds.Min.Y = std::min(newBounds.Min.Y, object.Position.Y - object.CollisionRadius);
-			newBounds.Min.Z = std::min(newBounds.Min.Z, object.Position.Z - object.CollisionRadius);
+			newBounds.Min.X = std::min(newBounds.Min.X, object->Position.X - object->CollisionRadius);
+			newBounds.Min.Y = std::min(newBounds.Min.Y, object->Position.Y - object->CollisionRadius);
+			newBounds.Min.Z = std::min(newBounds.Min.Z, object->Position.Z - object->CollisionRadius);
 
-			newBounds.Max.X = std::max(newBounds.Max.X, object.Position.X + object.CollisionRadius);
-			newBounds.Max.Y = std::max(newBounds.Max.Y, object.Position.Y + object.CollisionRadius);
-			newBounds.Max.Z = std::max(newBounds.Max.Z, object.Position.Z + object.CollisionRadius);
+			newBounds.Max.X = std::max(newBounds.Max.X, object->Position.X + object->CollisionRadius);
+			newBounds.Max.Y = std::max(newBounds.Max.Y, object->Position.Y + object->CollisionRadius);
+			newBounds.Max.Z = std::max(newBounds.Max.Z, object->Position.Z + object->CollisionRadius);
 		}
 
-		Root->Bounds = newBounds;
-		BuildSubtree(Root, objectPointers);
+		//every node goes back to the pool, the root is always the first one out again
+		NumUsedNodes = 0;
+		LeafObjects.clear();
+		Root = AcquireNode(newBounds, nullptr);
+		BuildSubtree(Root, ObjectPointers, 0);
 	}
 
 	Vector4 CardinalOffset(const Vector4& center, const float radius, const int cardinal)
@@ -105,16 +153,37 @@ namespace Physics
 		return childIndex;
 	}
 
-	void Octree::BuildSubtree(std::unique_ptr<OctreeNode>& Node, const std::vector<PhysicsObject*>& Objects)
+	void Octree::BuildSubtree(OctreeNode* Node, const std::vector<PhysicsObject*>& Objects, size_t Depth)
 	{
 		using namespace std;
 
 		if (Objects.size() <= MaxObjectsInLeaf || (Node->Bounds.Max - Node->Bounds.Min).length3Squared() < 1.0f)
 		{
-			if (!Objects.empty())
+			Node->FirstObject = LeafObjects.size();
+			Node->NumObjects = Objects.size();
+			LeafObjects.insert(LeafObjects.end(), Objects.begin(), Objects.end());
+			auto nodeObjects = LeafObjects.begin() + Node->FirstObject;
+
+			//owned objects first, so mass is only counted once even though overlapping objects are in several leaves
+			const BoundingBox& bounds = Node->Bounds;
+			auto ownedEnd = std::partition(nodeObjects, LeafObjects.end(), [&](PhysicsObject* object) { return bounds.Contains(object->Position); });
+			Node->NumOwnedObjects = std::distance(nodeObjects, ownedEnd);
+
+			Vector4 weightedPosition(0.0f);
+			float mass = 0.0f;
+			for (size_t objectIndex = 0; objectIndex < Node->NumOwnedObjects; ++objectIndex)
 			{
-				Node->Objects.insert(Node->Objects.end(), Objects.begin(), Objects.end());
+				const PhysicsObject* object = nodeObjects[objectIndex];
+				//immovable objects have no finite mass to attract with
+				if (object->InverseMass > 0.0f)
+				{
+					const float objectMass = 1.0f / object->InverseMass;
+					weightedPosition += object->Position * objectMass;
+					mass += objectMass;
+				}
 			}
+			Node->Mass = mass;
+			Node->CenterOfMass = mass > 0.0f ? weightedPosition / mass : Node->Bounds.Min;
 				
 			Node->bLeaf = true;
 		}
@@ -123,7 +192,15 @@ namespace Physics
 			Vector4 center = (Node->Bounds.Min + Node->Bounds.Max) / 2.0f;
 			Node->Center = center;
 
-			std::vector<PhysicsObject*> childObjects[8];
+			if (ChildObjects.size() <= Depth)
+			{
+				ChildObjects.emplace_back();
+			}
+			auto& childObjects = ChildObjects[Depth];
+			for (auto& objects : childObjects)
+			{
+				objects.clear();
+			}
 
 			for(PhysicsObject* object : Objects)
 			{
@@ -149,33 +226,45 @@ namespace Physics
 				}
 			}
 
+			Vector4 weightedPosition(0.0f);
+			float mass = 0.0f;
+
 			int childIndex = 0;
 			for(auto& Child : Node->Children)
 			{
 				if (!childObjects[childIndex].empty())
 				{
-					Child = std::make_unique<OctreeNode>(BuildChildBounds(Node->Bounds, childIndex));
-					Child->Parent = Node.get();
-					BuildSubtree(Child, childObjects[childIndex]);
+					Child = AcquireNode(BuildChildBounds(Node->Bounds, childIndex), Node);
+					BuildSubtree(Child, childObjects[childIndex], Depth + 1);
+
+					weightedPosition += Child->CenterOfMass * Child->Mass;
+					mass += Child->Mass;
 				}
 				++childIndex;
 			}
+
+			Node->Mass = mass;
+			Node->CenterOfMass = mass > 0.0f ? weightedPosition / mass : center;
 		}
 	}
 
-	void GetNodeColliders(std::unique_ptr<OctreeNode>& node, Vector4& position, float radius, std::vector<PhysicsObject*>& OutObjects)
+	void GetNodeColliders(const OctreeNode* node, PhysicsObject* const* leafObjects, Vector4& position, float radius, std::vector<PhysicsObject*>& OutObjects)
 	{
 		if (node == nullptr)
 			return;
 
 		if (node->bLeaf)
 		{
-			OutObjects.insert(OutObjects.end(), node->Objects.begin(), node->Objects.end());
+			OutObjects.insert(OutObjects.end(), leafObjects + node->FirstObject, leafObjects + node->FirstObject + node->NumObjects);
 		}
 		else
 		{
 			int childIndex = SelectChild(node->Center, position);			
-			GetNodeColliders(node->Children[childIndex], position, radius, OutObjects);
+			GetNodeColliders(node->Children[childIndex], leafObjects, position, radius, OutObjects);
+
+			bool alreadyVisited[8];
+			std::fill(std::begin(alreadyVisited), std::end(alreadyVisited), false);
+			alreadyVisited[childIndex] = true;
 
 			//handle tests near node edges
 			for (int cardinal = 0; cardinal < 8; ++cardinal)
@@ -184,9 +273,10 @@ namespace Physics
 
 				int testIndex = SelectChild(node->Center, testPosition);
 
-				if (testIndex != childIndex)
+				if (!alreadyVisited[testIndex])
 				{
-					GetNodeColliders(node->Children[testIndex], position, radius, OutObjects);
+					GetNodeColliders(node->Children[testIndex], leafObjects, position, radius, OutObjects);
+					alreadyVisited[testIndex] = true;
 				}
 			}
 		}
@@ -195,7 +285,80 @@ namespace Physics
 	void Octree::GetPotentialColliders(Vector4& Position, float Radius, std::vector<PhysicsObject*>& OutObjects)
 	{
 		OutObjects.reserve(MaxObjectsInLeaf);
-		GetNodeColliders(Root, Position, Radius, OutObjects);
+		GetNodeColliders(Root, LeafObjects.data(), Position, Radius, OutObjects);
 	}
 
+	void GetNodeObjectsInBounds(const OctreeNode* node, PhysicsObject* const* leafObjects, const BoundingBox& bounds, std::vector<PhysicsObject*>& OutObjects)
+	{
+		if (node == nullptr || !node->Bounds.Intersects(bounds))
+			return;
+
+		if (node->bLeaf)
+		{
+			OutObjects.insert(OutObjects.end(), leafObjects + node->FirstObject, leafObjects + node->FirstObject + node->NumObjects);
+		}
+		else
+		{
+			for (auto& child : node->Children)
+			{
+				GetNodeObjectsInBounds(child, leafObjects, bounds, OutObjects);
+			}
+		}
+	}
+
+	void Octree::GetObjectsInBounds(const BoundingBox& Bounds, std::vector<PhysicsObject*>& OutObjects) const
+	{
+		GetNodeObjectsInBounds(Root, LeafObjects.data(), Bounds, OutObjects);
+	}
+
+	Vector4 PointMassAcceleration(const Vector4& position, const Vector4& massPosition, float mass, float gravitationalConstant, float softeningSquared)
+	{
+		//Plummer softening keeps close encounters from blowing up
+		const Vector4 offset = massPosition - position;
+		const float distanceSquared = offset.length3Squared() + softeningSquared;
+		const float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+		return offset * (gravitationalConstant * mass * inverseDistance * inverseDistance * inverseDistance);
+	}
+
+	void AccumulateNodeGravity(const OctreeNode* node, PhysicsObject* const* leafObjects, const Vector4& position, size_t selfIndex, float gravitationalConstant, float openingAngleSquared, float softeningSquared, Vector4& acceleration)
+	{
+		if (node == nullptr || node->Mass <= 0.0f)
+			return;
+
+		if (node->bLeaf)
+		{
+			for (size_t objectIndex = 0; objectIndex < node->NumOwnedObjects; ++objectIndex)
+			{
+				const PhysicsObject* object = leafObjects[node->FirstObject + objectIndex];
+				if (object->Index != selfIndex && object->InverseMass > 0.0f)
+				{
+					acceleration += PointMassAcceleration(position, object->Position, 1.0f / object->InverseMass, gravitationalConstant, softeningSquared);
+				}
+			}
+			return;
+		}
+
+		//width / distance < angle, compared squared to skip the square root
+		//never approximate a node we're inside of, or we'd be attracted to ourselves
+		const Vector4 extents = node->Bounds.Max - node->Bounds.Min;
+		const float width = std::max(extents.X, std::max(extents.Y, extents.Z));
+		const float distanceSquared = (node->CenterOfMass - position).length3Squared();
+		if (width * width < openingAngleSquared * distanceSquared && !node->Bounds.Contains(position))
+		{
+			acceleration += PointMassAcceleration(position, node->CenterOfMass, node->Mass, gravitationalConstant, softeningSquared);
+			return;
+		}
+
+		for (auto& child : node->Children)
+		{
+			AccumulateNodeGravity(child, leafObjects, position, selfIndex, gravitationalConstant, openingAngleSquared, softeningSquared, acceleration);
+		}
+	}
+
+	Vector4 Octree::GetGravitationalAcceleration(const Vector4& Position, size_t SelfIndex, float GravitationalConstant, float OpeningAngle, float Softening) const
+	{
+		Vector4 acceleration(0.0f);
+		AccumulateNodeGravity(Root, LeafObjects.data(), Position, SelfIndex, GravitationalConstant, OpeningAngle * OpeningAngle, Softening * Softening, acceleration);
+		return acceleration;
+	}
 }
\ No newline at end of file
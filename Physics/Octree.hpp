@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <deque>
+#include <array>
 #include <memory>
 
 #include "Types.hpp"
@@ -12,8 +14,10 @@ namespace Physics
 	{
 		OctreeNode(const Core::BoundingBox& bounds);
 
-		//TODO make this better
-		//aligned new and delete for make_unique
+		//back to a fresh node for reuse
+		void Reset(const Core::BoundingBox& bounds, OctreeNode* parent);
+
+		//aligned new and delete for the node pool
 		void* operator new(size_t i)
 		{
 			return _mm_malloc(i,16);
@@ -25,11 +29,20 @@ namespace Physics
 		}
 
 		OctreeNode* Parent;
-		std::unique_ptr<OctreeNode> Children[8];
+		//owned by the octree's node pool, null where the octant is empty
+		OctreeNode* Children[8];
 		Core::Vector4 Center;
 		bool bLeaf;
-		std::vector<PhysicsObject*> Objects;
+		//leaf objects, a range of the octree's LeafObjects
+		size_t FirstObject;
+		size_t NumObjects;
+		//leaf objects whose centers are inside this node come first - the rest are only here because their radius overlaps
+		size_t NumOwnedObjects;
 		Core::BoundingBox Bounds;
+
+		//aggregates over the objects centered in this subtree, for Barnes-Hut
+		Core::Vector4 CenterOfMass;
+		float Mass;
 	};
 
 	class Octree
@@ -40,12 +53,35 @@ namespace Physics
 		void Rebuild(simd_vector<PhysicsObject>& Objects);	
 		void AddObject(PhysicsObject* NewObject);
 
+		//the root's, fixed at construction
+		const Core::BoundingBox& GetBounds() const;
+
 		void GetPotentialColliders(Core::Vector4& Position, float Radius, std::vector<PhysicsObject*>& OutObjects);
 
+		//every leaf overlapping Bounds, for queries too large for the corner tests in GetPotentialColliders (may contain duplicates)
+		void GetObjectsInBounds(const Core::BoundingBox& Bounds, std::vector<PhysicsObject*>& OutObjects) const;
+
+		//Barnes-Hut approximation of the gravitational acceleration at Position from every object in the tree except the one at SelfIndex.
+		//Nodes that look smaller than OpeningAngle (width / distance) are treated as a single mass at their center of mass.
+		Core::Vector4 GetGravitationalAcceleration(const Core::Vector4& Position, size_t SelfIndex, float GravitationalConstant, float OpeningAngle, float Softening) const;
+
 	private:
 
-		void BuildSubtree(std::unique_ptr<OctreeNode>& Node, const std::vector<PhysicsObject*>& Objects);
+		void BuildSubtree(OctreeNode* Node, const std::vector<PhysicsObject*>& Objects, size_t Depth);
+
+		//next unused node from the pool, allocating only when the tree is bigger than it has ever been
+		OctreeNode* AcquireNode(const Core::BoundingBox& Bounds, OctreeNode* Parent);
+
+		//Nodes are handed out in order each rebuild and never freed, so in steady state a rebuild doesn't allocate at all -
+		//the leaves' objects and the per-depth scratch for splitting objects between children keep their capacity too.
+		std::vector<std::unique_ptr<OctreeNode>> NodePool;
+		size_t NumUsedNodes;
+		//every leaf's objects, one after the other
+		std::vector<PhysicsObject*> LeafObjects;
+		//deque, so growing it for a deeper level doesn't move the lists the levels above are still reading from
+		std::deque<std::array<std::vector<PhysicsObject*>, 8>> ChildObjects;
+		std::vector<PhysicsObject*> ObjectPointers;
 
-		std::unique_ptr<OctreeNode> Root;
+		OctreeNode* Root;
 	};
 }
\ No newline at end of file
@@ -3,83 +3,1298 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace Physics
 {
 	using namespace Core;
 
+	//objects per integration job - big enough to amortize the job dispatch, small enough to balance across threads
+	static const size_t IntegrationBatchSize = 256;
+
+	//objects per bulk spawn job - the generator is usually cheap, so bigger than the integration batches
+	static const size_t SpawnBatchSize = 1024;
+
+	//bits per axis of the Morton codes objects are sorted by - 63 bits in all
+	static const uint32_t MortonAxisBits = 21;
+
+	//pairs per contact preparation job, batches never mix shape pairs so the smaller ones can come out shorter
+	static const size_t NarrowphaseBatchSize = 128;
+
+	//contacts per solver job - batches are whole islands, so only the small ones get grouped up to this
+	static const size_t SolverBatchSize = 128;
+
+	//FNV-1a over 32 bit words rather than bytes - only the fields that carry simulation state, padding would make it unstable
+	static uint64_t HashObjectState(const simd_vector<PhysicsObject>& Objects)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		auto mix = [&hash](uint32_t word)
+		{
+			hash = (hash ^ word) * 0x100000001b3ull;
+		};
+
+		for (auto& object : Objects)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				uint32_t position, velocity;
+				std::memcpy(&position, &object.Position[axis], sizeof(position));
+				std::memcpy(&velocity, &object.Velocity[axis], sizeof(velocity));
+				mix(position);
+				mix(velocity);
+			}
+			mix(object.bAsleep ? 1u : 0u);
+		}
+		return hash;
+	}
+
 	PhysicsManager::PhysicsManager(int NumThreads, size_t NumObjects)
-		: StateFrontBuffer(&PhysicsStateBuffers[0]),
+		: FrameStateHash(0),
+		FrameNumber(0),
+		bDeterministic(false),
+		Integrator(IntegratorType::SymplecticEuler),
+		Broadphase(BroadphaseType::Octree),
+		StateFrontBuffer(&PhysicsStateBuffers[0]),
 		StateBackBuffer(&PhysicsStateBuffers[1]),
 		StateFrontBufferIndex(0),
+		CurrentAwakeBuffer(&AwakeObjects),
 		CurrentPairsBuffer(&CollisionPairs),
-		CollisionDetectionJob(NumThreads, &StateFrontBuffer, &CurrentPairsBuffer, this),
-		CollisionResolutionJob(NumThreads, &CurrentPairsBuffer, &StateBackBuffer, this),
-		ApplyVelocitiesJob(NumThreads, &StateFrontBuffer, &StateBackBuffer, this),
-		CollisionOctree(BoundingBox(Vector4(-1000, -1000, -1000), Vector4(1000, 1000, 1000)))
+		CurrentNarrowphaseBatches(&NarrowphaseBatches),
+		CurrentSpawnGenerator(nullptr),
+		SpawnOffset(0),
+		ReorderInterval(0),
+		bNumaAware(false),
+		bLoadBalanced(false),
+		PlacedStorage{ nullptr, nullptr },
+		PlacedNumObjects(0),
+		PlacementStorage(nullptr),
+		CurrentFastObjects(&FastObjects),
+		CurrentTimesOfImpact(&TimesOfImpact),
+		CurrentContactsBuffer(&Contacts),
+		CurrentSolverBatches(&SolverBatches),
+		CollisionDetectionJob(NumThreads, &CurrentAwakeBuffer, &CurrentPairsBuffer, this),
+		ContactPreparationJob(NumThreads, &CurrentNarrowphaseBatches, &CurrentContactsBuffer, this),
+		ContactSolveJob(NumThreads, &CurrentSolverBatches, &CurrentContactsBuffer, this),
+		ContinuousCollisionJob(NumThreads, &CurrentFastObjects, &CurrentTimesOfImpact, this),
+		JobKind(BatchJobKind::Integration),
+		CurrentJobKind(&JobKind),
+		CurrentJobBatches(nullptr),
+		BatchJob(NumThreads, &CurrentJobBatches, &CurrentJobKind, this),
+		CollisionOctree(BoundingBox(Vector4(-1000, -1000, -1000), Vector4(1000, 1000, 1000))),
+		bObjectsReordered(false),
+		bFrameResult(true),
+		FrameStages(1)
 	{
 		for (auto& buffer : PhysicsStateBuffers)
 		{
 			buffer.reserve(NumObjects);
 		}
+		AwakeObjects.reserve(NumObjects);
+
+		BuildFrameStages();
 	}
 
 	PhysicsManager::~PhysicsManager()
-	{}
+	{
+		//the frame thread is still using everything below
+		WaitForFrame();
+	}
 
 	bool PhysicsManager::RunFrame(float deltaTime)
+	{
+		WaitForFrame();
+		return StepFrame(deltaTime);
+	}
+
+	std::shared_future<bool> PhysicsManager::RunFrameAsync(float deltaTime)
+	{
+		WaitForFrame();
+		RunningFrame = std::async(std::launch::async, [this, deltaTime]() { return StepFrame(deltaTime); }).share();
+		return RunningFrame;
+	}
+
+	bool PhysicsManager::IsFrameRunning() const
+	{
+		return RunningFrame.valid() && RunningFrame.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+	}
+
+	void PhysicsManager::WaitForFrame()
+	{
+		if (RunningFrame.valid())
+		{
+			RunningFrame.wait();
+		}
+	}
+
+	void PhysicsManager::SetFrameCallback(std::function<void(bool)> callback)
+	{
+		FrameCallback = callback;
+	}
+
+	bool PhysicsManager::StepFrame(float deltaTime)
 	{
 		CurrentDeltaTime = deltaTime;
+		++FrameNumber;
+
+		FrameStages.Run();
+
+		if (FrameCallback)
+		{
+			FrameCallback(bFrameResult);
+		}
 
-		//copy current state to back buffer
-		PhysicsStateBuffers[!StateFrontBufferIndex] = *StateFrontBuffer;
+		return bFrameResult;
+	}
 
-		CollisionOctree.Rebuild(*StateFrontBuffer);
+	//what the frame stages share, for working out which of them can overlap
+	enum FrameResource : unsigned int
+	{
+		ObjectSetResource, //which objects there are, their shapes and handles
+		FrontBufferResource,
+		BackBufferResource,
+		AwakeResource, //awake list, sleeping islands, the integration batches and the accelerations they were evaluated for
+		BroadphaseResource, //octree and grid
+		PairsResource,
+		ContactsResource,
+		ContactCacheResource,
+		EventsResource,
+		HashResource,
+		RecordingResource
+	};
 
-		bool result = DetectCollisions();
-		ResolveCollisions();
+	void PhysicsManager::BuildFrameStages()
+	{
+		//Added in the order they'd run one after the other. The graph overlaps the ones that don't share anything: the back
+		//buffer copy with the broadphase rebuild, the contact cache update with integration, swept tests and sleeping, and the
+		//state hash with the recording.
 
-		std::sort(CollisionPairs.begin(), CollisionPairs.end(), [](auto& a, auto& b) { return a.first < b.first && a.second < b.second; });
-		CollisionPairs.resize(std::distance(CollisionPairs.begin(), std::unique(CollisionPairs.begin(), CollisionPairs.end())));
-		NumFrameCollisions = CollisionPairs.size();
+		//the only point in the frame where objects come and go, so indices and pointers are stable for the rest of it
+		FrameStages.AddStage("Object changes", {}, { ObjectSetResource, FrontBufferResource, BackBufferResource, AwakeResource, ContactCacheResource }, [this]()
+		{
+			ApplyObjectChanges();
+			if (ReorderInterval != 0 && FrameNumber % ReorderInterval == 0)
+			{
+				ReorderObjects();
+			}
+			if (bNumaAware)
+			{
+				PlaceStateBuffers();
+			}
+		});
 
-		ApplyAccelerationsAndImpulses();
-		ApplyVelocities();
+		FrameStages.AddStage("Back buffer copy", { FrontBufferResource }, { BackBufferResource }, [this]()
+		{
+			PhysicsStateBuffers[!StateFrontBufferIndex] = *StateFrontBuffer;
+		});
 
-		//lock in case someone else is trying to copy out the current state right now
+		FrameStages.AddStage("Broadphase rebuild", { ObjectSetResource, FrontBufferResource }, { BroadphaseResource }, [this]()
+		{
+			if (Broadphase == BroadphaseType::Octree || NeedsOctree())
+			{
+				CollisionOctree.Rebuild(*StateFrontBuffer);
+			}
+
+			if (Broadphase == BroadphaseType::HierarchicalGrid)
+			{
+				CollisionGrid.Rebuild(*StateFrontBuffer);
+			}
+		});
+
+		FrameStages.AddStage("Collision detection", { ObjectSetResource, FrontBufferResource, AwakeResource, BroadphaseResource }, { PairsResource }, [this]()
+		{
+			bFrameResult = DetectCollisions();
+		});
+
+		//anything asleep that got hit needs to take part in the rest of the frame
+		FrameStages.AddStage("Wake touched", { PairsResource }, { BackBufferResource, AwakeResource }, [this]()
+		{
+			Sleep.WakeTouched(CollisionPairs, *StateBackBuffer, AwakeObjects);
+		});
+
+		//external forces go before the solve so it can account for them, and so do the generators, against the front buffer and the octree
+		FrameStages.AddStage("Forces", { ObjectSetResource, FrontBufferResource, BroadphaseResource }, { BackBufferResource, AwakeResource }, [this]()
+		{
+			ApplyAccelerationsAndImpulses();
+		});
+
+		FrameStages.AddStage("Contact solve", { ObjectSetResource, FrontBufferResource, AwakeResource, PairsResource, ContactCacheResource }, { BackBufferResource, ContactsResource }, [this]()
+		{
+			ResolveCollisions();
+
+			//detection only emits each pair once (from the lower index), and separated ones were dropped from the contacts
+			NumFrameCollisions = Contacts.size();
+		});
+
+		//nothing reads the cache past the solve, and the update only looks at the contacts
+		FrameStages.AddStage("Contact cache", { ContactsResource }, { ContactCacheResource }, [this]()
+		{
+			ContactCache.Update(Contacts);
+		});
+
+		//the force generators are evaluated in here, against the front buffer and the octree
+		FrameStages.AddStage("Integration", { ObjectSetResource, FrontBufferResource, AwakeResource, BroadphaseResource }, { BackBufferResource }, [this]()
+		{
+			ApplyVelocities();
+		});
+
+		FrameStages.AddStage("Swept tests", { ObjectSetResource, FrontBufferResource, AwakeResource, BroadphaseResource }, { BackBufferResource }, [this]()
+		{
+			DetectContinuousCollisions();
+		});
+
+		FrameStages.AddStage("Sleeping", { ContactsResource }, { BackBufferResource, AwakeResource }, [this]()
+		{
+			UpdateSleeping();
+		});
+
+		FrameStages.AddStage("Swap", { ContactCacheResource }, { FrontBufferResource, BackBufferResource, EventsResource }, [this]()
+		{
+			//lock in case someone else is trying to copy out the current state right now
+			CurrentBufferMutex.lock();
+			StateFrontBufferIndex = !StateFrontBufferIndex;
+			StateFrontBuffer = &PhysicsStateBuffers[StateFrontBufferIndex];
+			StateBackBuffer = &PhysicsStateBuffers[!StateFrontBufferIndex];
+			CurrentContactEvents = ContactCache.GetEvents();
+			CurrentBufferMutex.unlock();
+		});
+
+		//nothing writes to the new front buffer until the next frame starts, so these can read it without the lock
+		FrameStages.AddStage("State hash", { FrontBufferResource }, { HashResource }, [this]()
+		{
+			if (bDeterministic)
+			{
+				FrameStateHash = HashObjectState(*StateFrontBuffer);
+			}
+		});
+
+		FrameStages.AddStage("Recording", { ObjectSetResource, FrontBufferResource }, { RecordingResource }, [this]()
+		{
+			if (Recorder)
+			{
+				Recorder->RecordFrame(*StateFrontBuffer, bObjectsReordered);
+				bObjectsReordered = false;
+			}
+		});
+	}
+
+	ObjectHandle PhysicsManager::AddCollisionObject(const Core::Vector4& position, const Core::Vector4& velocity, float radius, float mass, float restitution)
+	{
+		ObjectChangeMutex.lock();
+		const ObjectHandle handle = QueueObject(position, velocity, radius, mass, restitution, ShapeType::Sphere);
+		ObjectChangeMutex.unlock();
+		return handle;
+	}
+
+	ObjectHandle PhysicsManager::AddCapsule(const Core::Vector4& position, const Core::Vector4& velocity, const Core::Vector4& axis, float halfHeight, float radius, float mass, float restitution)
+	{
+		ObjectChangeMutex.lock();
+		PendingShapes.Capsules.push_back(CapsuleShape{ axis.getNormalized3(), halfHeight, radius });
+		const ObjectHandle handle = QueueObject(position, velocity, halfHeight + radius, mass, restitution, ShapeType::Capsule);
+		ObjectChangeMutex.unlock();
+		return handle;
+	}
+
+	ObjectHandle PhysicsManager::AddBox(const Core::Vector4& position, const Core::Vector4& velocity, const Core::Vector4& halfExtents, const Core::Matrix4& orientation, float mass, float restitution)
+	{
+		ObjectChangeMutex.lock();
+		PendingShapes.Boxes.push_back(BoxShape{ { orientation[0].getNormalized3(), orientation[1].getNormalized3(), orientation[2].getNormalized3() }, halfExtents });
+		const ObjectHandle handle = QueueObject(position, velocity, halfExtents.length3(), mass, restitution, ShapeType::Box);
+		ObjectChangeMutex.unlock();
+		return handle;
+	}
+
+	ObjectHandle PhysicsManager::AddPlane(const Core::Vector4& normal, float distance, float restitution)
+	{
+		const Vector4 unitNormal = normal.getNormalized3();
+
+		ObjectChangeMutex.lock();
+		PendingShapes.Planes.push_back(PlaneShape{ unitNormal, distance });
+		const ObjectHandle handle = QueueObject(unitNormal * distance, Vector4(0.0f), 0.0f, 0.0f, restitution, ShapeType::Plane);
+		ObjectChangeMutex.unlock();
+		return handle;
+	}
+
+	ObjectHandle PhysicsManager::AddStaticMesh(const simd_vector<Vector4>& vertices, const std::vector<unsigned int>& indices, float restitution)
+	{
+		//build the BVH before taking the lock, it's the slow part
+		StaticMesh mesh(vertices, indices);
+
+		ObjectChangeMutex.lock();
+		PendingShapes.Meshes.push_back(std::move(mesh));
+		const ObjectHandle handle = QueueObject(Vector4(0.0f), Vector4(0.0f), 0.0f, 0.0f, restitution, ShapeType::Mesh);
+		ObjectChangeMutex.unlock();
+		return handle;
+	}
+
+	std::vector<ObjectHandle> PhysicsManager::AddCollisionObjects(const Core::Vector4* positions, const Core::Vector4* velocities, const float* radii, size_t count, float mass, float restitution)
+	{
+		return AddCollisionObjects(count, [=](size_t index, SpawnParameters& parameters)
+		{
+			parameters.Position = positions[index];
+			parameters.Velocity = velocities != nullptr ? velocities[index] : Vector4(0.0f);
+			parameters.Radius = radii != nullptr ? radii[index] : 1.0f;
+			parameters.Mass = mass;
+			parameters.Restitution = restitution;
+		});
+	}
+
+	std::vector<ObjectHandle> PhysicsManager::AddCollisionObjects(size_t count, const SpawnGenerator& generator)
+	{
+		std::vector<ObjectHandle> handles;
+		handles.reserve(count);
+
+		ObjectChangeMutex.lock();
+
+		//size everything once up front, the workers then only write their own slots
+		SpawnOffset = PendingObjects.size();
+		PendingObjects.resize(SpawnOffset + count);
+		PendingObjectHandles.reserve(SpawnOffset + count);
+		for (size_t index = 0; index < count; ++index)
+		{
+			handles.push_back(Handles.Allocate());
+		}
+		PendingObjectHandles.insert(PendingObjectHandles.end(), handles.begin(), handles.end());
+
+		SpawnBatches.clear();
+		for (size_t begin = 0; begin < count; begin += SpawnBatchSize)
+		{
+			SpawnBatches.push_back(BatchRange{ begin, std::min(begin + SpawnBatchSize, count) });
+		}
+
+		CurrentSpawnGenerator = &generator;
+		RunBatches(BatchJobKind::Spawn, SpawnBatches);
+		CurrentSpawnGenerator = nullptr;
+
+		ObjectChangeMutex.unlock();
+		return handles;
+	}
+
+	PhysicsObject PhysicsManager::MakeObject(const Core::Vector4& position, const Core::Vector4& velocity, float boundingRadius, float mass, float restitution, ShapeType shape, size_t shapeIndex)
+	{
+		const float inverseMass = mass > 0.0f ? 1.0f / mass : 0.0f;
+
+		//immovable objects start (and stay) asleep so nothing ever iterates them
+		const bool bAsleep = inverseMass == 0.0f;
+		return PhysicsObject{ position, velocity, Core::Vector4(0.0f, 0.1f, 0.2f, 1.0f), Core::Vector4(0.0f), boundingRadius, inverseMass, restitution, 0.0f, 0, 0, bAsleep, shape, shapeIndex };
+	}
+
+	ObjectHandle PhysicsManager::QueueObject(const Core::Vector4& position, const Core::Vector4& velocity, float boundingRadius, float mass, float restitution, ShapeType shape)
+	{
+		//shape index into PendingShapes for now, the real one is filled in when it's actually added
+		size_t pendingShapeIndex = 0;
+		switch (shape)
+		{
+		case ShapeType::Capsule:
+			pendingShapeIndex = PendingShapes.Capsules.size() - 1;
+			break;
+		case ShapeType::Box:
+			pendingShapeIndex = PendingShapes.Boxes.size() - 1;
+			break;
+		case ShapeType::Plane:
+			pendingShapeIndex = PendingShapes.Planes.size() - 1;
+			break;
+		case ShapeType::Mesh:
+			pendingShapeIndex = PendingShapes.Meshes.size() - 1;
+			break;
+		default:
+			break;
+		}
+
+		PendingObjects.push_back(MakeObject(position, velocity, boundingRadius, mass, restitution, shape, pendingShapeIndex));
+
+		const ObjectHandle handle = Handles.Allocate();
+		PendingObjectHandles.push_back(handle);
+		return handle;
+	}
+
+	void PhysicsManager::RemoveObject(ObjectHandle handle, bool wakeResting)
+	{
+		ObjectChangeMutex.lock();
+		PendingRemovals.push_back(PendingRemoval{ handle, wakeResting });
+		ObjectChangeMutex.unlock();
+	}
+
+	bool PhysicsManager::IsValid(ObjectHandle handle)
+	{
+		ObjectChangeMutex.lock();
+		const bool bValid = Handles.IsValid(handle);
+		ObjectChangeMutex.unlock();
+		return bValid;
+	}
+
+	size_t PhysicsManager::GetObjectIndex(ObjectHandle handle)
+	{
+		ObjectChangeMutex.lock();
+		const size_t index = Handles.Find(handle);
+		ObjectChangeMutex.unlock();
+		return index;
+	}
+
+	bool PhysicsManager::CopyObject(ObjectHandle handle, PhysicsObject& outObject)
+	{
+		//same lock order as ApplyObjectChanges
+		ObjectChangeMutex.lock();
+		CurrentBufferMutex.lock();
+		const size_t index = Handles.Find(handle);
+		if (index != InvalidObjectIndex)
+		{
+			outObject = (*StateFrontBuffer)[index];
+		}
+		CurrentBufferMutex.unlock();
+		ObjectChangeMutex.unlock();
+		return index != InvalidObjectIndex;
+	}
+
+	void PhysicsManager::ApplyObjectChanges()
+	{
+		ObjectChangeMutex.lock();
+		if (PendingObjects.empty() && PendingRemovals.empty())
+		{
+			ObjectChangeMutex.unlock();
+			return;
+		}
+
+		//nothing else touches the front buffer between frames, but someone might be copying it out
+		CurrentBufferMutex.lock();
+		//adds first, so removing an object in the same frame it was added works
+		AddPendingObjects();
+		RemovePendingObjects();
+		CurrentBufferMutex.unlock();
+		ObjectChangeMutex.unlock();
+	}
+
+	void PhysicsManager::AddPendingObjects()
+	{
+		//one copy of the whole block - may reallocate, which is fine here since nothing holds on to object pointers between frames
+		auto& objects = *StateFrontBuffer;
+		const size_t firstIndex = objects.size();
+		objects.insert(objects.end(), PendingObjects.begin(), PendingObjects.end());
+		AwakeObjects.reserve(objects.size());
+
+		for (size_t index = firstIndex; index < objects.size(); ++index)
+		{
+			PhysicsObject& object = objects[index];
+			object.Index = index;
+			object.SleepIsland = index;
+			if (object.Shape != ShapeType::Sphere)
+			{
+				object.ShapeIndex = Shapes.Append(object.Shape, PendingShapes, object.ShapeIndex, index);
+			}
+
+			Handles.Bind(PendingObjectHandles[index - firstIndex], index);
+			if (!object.bAsleep)
+			{
+				AwakeObjects.push_back(index);
+			}
+		}
+
+		PendingObjects.clear();
+		PendingObjectHandles.clear();
+		PendingShapes.Clear();
+	}
+
+	void PhysicsManager::RemovePendingObjects()
+	{
+		if (PendingRemovals.empty())
+		{
+			return;
+		}
+
+		auto& objects = *StateFrontBuffer;
+		const size_t originalCount = objects.size();
+		bObjectsReordered = true;
+
+		//wake anything resting on what's being removed while the islands still have the old indices
+		//immovable objects aren't in islands, so there's no telling who's resting on them - wake everything, unless asked not to
+		bool bWakeAll = false;
+		for (const auto& removal : PendingRemovals)
+		{
+			const size_t index = Handles.Find(removal.Handle);
+			if (index != InvalidObjectIndex)
+			{
+				bWakeAll |= removal.bWakeResting && objects[index].InverseMass == 0.0f;
+				Sleep.Wake(index, objects, AwakeObjects);
+			}
+		}
+		if (bWakeAll)
+		{
+			Sleep.WakeAll(objects, AwakeObjects);
+		}
+
+		ObjectOrigins.resize(originalCount);
+		for (size_t index = 0; index < originalCount; ++index)
+		{
+			ObjectOrigins[index] = index;
+		}
+
+		for (const auto& removal : PendingRemovals)
+		{
+			const ObjectHandle handle = removal.Handle;
+			const size_t index = Handles.Find(handle);
+			//removed twice, or never existed
+			if (!Handles.Release(handle) || index == InvalidObjectIndex)
+			{
+				continue;
+			}
+
+			if (objects[index].Shape != ShapeType::Sphere)
+			{
+				const size_t movedOwner = Shapes.Remove(objects[index].Shape, objects[index].ShapeIndex);
+				if (movedOwner != InvalidObjectIndex)
+				{
+					objects[movedOwner].ShapeIndex = objects[index].ShapeIndex;
+				}
+			}
+
+			//swap-and-pop keeps the buffer dense
+			const size_t last = objects.size() - 1;
+			if (index != last)
+			{
+				objects[index] = objects[last];
+				objects[index].Index = index;
+				ObjectOrigins[index] = ObjectOrigins[last];
+				Handles.MoveDense(last, index);
+				if (objects[index].Shape != ShapeType::Sphere)
+				{
+					Shapes.Owners[static_cast<size_t>(objects[index].Shape)][objects[index].ShapeIndex] = index;
+				}
+			}
+			objects.pop_back();
+			Handles.PopDense();
+		}
+		PendingRemovals.clear();
+
+		ObjectRemap.assign(originalCount, InvalidObjectIndex);
+		for (size_t index = 0; index < objects.size(); ++index)
+		{
+			ObjectRemap[ObjectOrigins[index]] = index;
+		}
+		RemapObjectIndices();
+	}
+
+	//spread the low 21 bits out to every third bit
+	static uint64_t SpreadBits(uint64_t Value)
+	{
+		Value &= 0x1fffff;
+		Value = (Value | Value << 32) & 0x1f00000000ffffull;
+		Value = (Value | Value << 16) & 0x1f0000ff0000ffull;
+		Value = (Value | Value << 8) & 0x100f00f00f00f00full;
+		Value = (Value | Value << 4) & 0x10c30c30c30c30c3ull;
+		Value = (Value | Value << 2) & 0x1249249249249249ull;
+		return Value;
+	}
+
+	void PhysicsManager::ReorderObjects()
+	{
+		ObjectChangeMutex.lock();
 		CurrentBufferMutex.lock();
-		StateFrontBufferIndex = !StateFrontBufferIndex;
-		StateFrontBuffer = &PhysicsStateBuffers[StateFrontBufferIndex];
-		StateBackBuffer = &PhysicsStateBuffers[!StateFrontBufferIndex];
+
+		auto& objects = *StateFrontBuffer;
+		const size_t numObjects = objects.size();
+
+		//quantize across the objects' own bounds rather than the octree's, which are usually far bigger than the part in use
+		Vector4 min(std::numeric_limits<float>::max());
+		Vector4 max(-std::numeric_limits<float>::max());
+		for (auto& object : objects)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], object.Position[axis]);
+				max[axis] = std::max(max[axis], object.Position[axis]);
+			}
+		}
+
+		const float axisRange = static_cast<float>((1u << MortonAxisBits) - 1);
+		Vector4 scale;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			scale[axis] = axisRange / std::max(max[axis] - min[axis], 1e-6f);
+		}
+
+		MortonOrder.resize(numObjects);
+		for (size_t index = 0; index < numObjects; ++index)
+		{
+			const Vector4 offset = objects[index].Position - min;
+			uint64_t code = 0;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				//rounding can take the top end just past the range, and non-finite positions anywhere - NaN ends up at 0
+				const float quantized = std::min(axisRange, std::max(0.0f, offset[axis] * scale[axis]));
+				code |= SpreadBits(static_cast<uint64_t>(quantized)) << axis;
+			}
+			MortonOrder[index] = std::make_pair(code, index);
+		}
+		//ties go by the current index, so the order only depends on the state
+		std::sort(MortonOrder.begin(), MortonOrder.end());
+
+		//the back buffer is overwritten from the front at the start of every frame, so it's free to permute into
+		auto& reordered = *StateBackBuffer;
+		reordered.resize(numObjects);
+		ObjectRemap.resize(numObjects);
+		for (size_t index = 0; index < numObjects; ++index)
+		{
+			const size_t oldIndex = MortonOrder[index].second;
+			reordered[index] = objects[oldIndex];
+			reordered[index].Index = index;
+			ObjectRemap[oldIndex] = index;
+		}
+		std::swap(objects, reordered);
+
+		Handles.Remap(ObjectRemap);
+		Shapes.RemapOwners(ObjectRemap);
+		RemapObjectIndices();
+		//walk the awake objects in memory order too
+		std::sort(AwakeObjects.begin(), AwakeObjects.end());
+		for (auto& event : CurrentContactEvents)
+		{
+			event.IndexA = ObjectRemap[event.IndexA];
+			event.IndexB = ObjectRemap[event.IndexB];
+		}
+		bObjectsReordered = true;
+
 		CurrentBufferMutex.unlock();
+		ObjectChangeMutex.unlock();
+	}
+
+	void PhysicsManager::PlaceStateBuffers()
+	{
+		const size_t numObjects = StateFrontBuffer->size();
+		const PhysicsObject* storageA = PhysicsStateBuffers[0].data();
+		const PhysicsObject* storageB = PhysicsStateBuffers[1].data();
+		const bool bSameStorage = (storageA == PlacedStorage[0] && storageB == PlacedStorage[1]) || (storageA == PlacedStorage[1] && storageB == PlacedStorage[0]);
+		//the slices follow the object count, so place again once it drifts far enough to shift them noticeably
+		const size_t drift = PlacedNumObjects / 4;
+		if (bSameStorage && numObjects + drift >= PlacedNumObjects && numObjects <= PlacedNumObjects + drift)
+		{
+			return;
+		}
+
+		//room to grow before the next placement, and the same for both so copying into the back buffer never reallocates it
+		const size_t capacity = std::max(numObjects + numObjects / 4, std::max(PhysicsStateBuffers[0].capacity(), PhysicsStateBuffers[1].capacity()));
+
+		//the same slices the partitioned jobs hand out, with the room to grow going to the last thread since that's where adds go
+		const unsigned int numThreads = BatchJob.GetNumThreads();
+		PlacementBatches.clear();
+		for (unsigned int thread = 0; thread < numThreads; ++thread)
+		{
+			const size_t end = thread + 1 < numThreads ? numObjects * (thread + 1) / numThreads : capacity;
+			PlacementBatches.push_back(BatchRange{ numObjects * thread / numThreads, end });
+		}
+
+		for (auto& buffer : PhysicsStateBuffers)
+		{
+			//fault in raw storage from the workers, then hand it to the new buffer as its allocation - nothing is constructed
+			//in it until it belongs to the buffer, and by then its pages are where the workers touched them
+			auto allocator = buffer.get_allocator();
+			PlacementStorage = allocator.allocate(capacity);
+			RunBatches(BatchJobKind::Placement, PlacementBatches);
+
+			simd_vector<PhysicsObject> placed;
+			OfferAllocation(PlacementStorage, capacity * sizeof(PhysicsObject));
+			placed.reserve(capacity);
+			//a vector that asked for a different size gets fresh pages, the objects just aren't placed
+			WithdrawAllocation();
+			PlacementStorage = nullptr;
+			placed.assign(buffer.begin(), buffer.end());
 
-		return result;
+			CurrentBufferMutex.lock();
+			buffer.swap(placed);
+			CurrentBufferMutex.unlock();
+		}
+
+		PlacedStorage[0] = PhysicsStateBuffers[0].data();
+		PlacedStorage[1] = PhysicsStateBuffers[1].data();
+		PlacedNumObjects = numObjects;
 	}
 
-	void PhysicsManager::AddCollisionObject(const Core::Vector4& position, const Core::Vector4& velocity, float radius)
+	void PhysicsManager::RemapObjectIndices()
 	{
-		PhysicsObject newObject{ position, velocity, Core::Vector4(0.0f, 0.1f, 0.2f, 1.0f), radius, StateFrontBuffer->size() };
-		StateFrontBuffer->push_back(newObject);
+		auto& objects = *StateFrontBuffer;
+		for (auto& index : AwakeObjects)
+		{
+			index = ObjectRemap[index];
+		}
+		AwakeObjects.erase(std::remove(AwakeObjects.begin(), AwakeObjects.end(), InvalidObjectIndex), AwakeObjects.end());
+		Sleep.Remap(ObjectRemap, objects);
+		ContactCache.Remap(ObjectRemap);
+		for (auto& generator : ForceGenerators)
+		{
+			generator->RemapObjects(ObjectRemap);
+		}
+	}
+
+	void PhysicsManager::AddForceGenerator(std::shared_ptr<ForceGenerator> generator)
+	{
+		ForceGenerators.push_back(generator);
+	}
+
+	void PhysicsManager::RemoveForceGenerator(const std::shared_ptr<ForceGenerator>& generator)
+	{
+		ForceGenerators.erase(std::remove(ForceGenerators.begin(), ForceGenerators.end(), generator), ForceGenerators.end());
+	}
+
+	std::shared_ptr<BarnesHutGravity> PhysicsManager::AddBarnesHutGravity(float gravitationalConstant, float openingAngle, float softening)
+	{
+		std::shared_ptr<BarnesHutGravity> gravity(new BarnesHutGravity(CollisionOctree, gravitationalConstant, openingAngle, softening));
+		AddForceGenerator(gravity);
+		return gravity;
+	}
+
+	void PhysicsManager::ApplyForce(ObjectHandle handle, const Core::Vector4& force)
+	{
+		ExternalInputMutex.lock();
+		PendingExternalInputs.push_back(ExternalInput{ force, handle, false });
+		ExternalInputMutex.unlock();
+	}
+
+	void PhysicsManager::ApplyImpulse(ObjectHandle handle, const Core::Vector4& impulse)
+	{
+		ExternalInputMutex.lock();
+		PendingExternalInputs.push_back(ExternalInput{ impulse, handle, true });
+		ExternalInputMutex.unlock();
+	}
+
+	SolverSettings& PhysicsManager::GetSolverSettings()
+	{
+		return Solver.Settings;
+	}
+
+	ContactManager& PhysicsManager::GetContactManager()
+	{
+		return ContactCache;
+	}
+
+	ContinuousCollisionSettings& PhysicsManager::GetContinuousCollisionSettings()
+	{
+		return ContinuousSettings;
+	}
+
+	void PhysicsManager::SetIntegrator(IntegratorType integrator)
+	{
+		Integrator = integrator;
+	}
+
+	IntegratorType PhysicsManager::GetIntegrator() const
+	{
+		return Integrator;
+	}
+
+	void PhysicsManager::SetDeterministic(bool deterministic)
+	{
+		bDeterministic = deterministic;
+	}
+
+	bool PhysicsManager::IsDeterministic() const
+	{
+		return bDeterministic;
+	}
+
+	void PhysicsManager::SetReorderInterval(unsigned int frames)
+	{
+		ReorderInterval = frames;
+	}
+
+	unsigned int PhysicsManager::GetReorderInterval() const
+	{
+		return ReorderInterval;
+	}
+
+	void PhysicsManager::SetNumaAware(bool numaAware)
+	{
+		bNumaAware = numaAware;
+
+		const std::vector<unsigned int> cores = numaAware ? GetThreadCores(BatchJob.GetNumThreads()) : std::vector<unsigned int>();
+		CollisionDetectionJob.SetThreadCores(cores);
+		ContactPreparationJob.SetThreadCores(cores);
+		ContactSolveJob.SetThreadCores(cores);
+		ContinuousCollisionJob.SetThreadCores(cores);
+		BatchJob.SetThreadCores(cores);
+
+		//the jobs that walk the objects in index order - contact preparation isn't tied to where objects sit, and spawns don't mind either way
+		CollisionDetectionJob.SetPartitioned(numaAware);
+		ContinuousCollisionJob.SetPartitioned(numaAware);
+		BatchJob.SetPartitioned(numaAware);
+
+		//place them for the new pinning at the start of the next frame
+		PlacedStorage[0] = nullptr;
+		PlacedStorage[1] = nullptr;
+	}
+
+	bool PhysicsManager::IsNumaAware() const
+	{
+		return bNumaAware;
+	}
+
+	void PhysicsManager::SetLoadBalanced(bool loadBalanced)
+	{
+		bLoadBalanced = loadBalanced;
+
+		//the jobs whose items cost very different amounts depending on where they are and what's around them
+		CollisionDetectionJob.SetCostBalanced(loadBalanced);
+		ContactPreparationJob.SetCostBalanced(loadBalanced);
+		ContinuousCollisionJob.SetCostBalanced(loadBalanced);
+	}
+
+	bool PhysicsManager::IsLoadBalanced() const
+	{
+		return bLoadBalanced;
+	}
+
+	void PhysicsManager::SetBroadphase(BroadphaseType broadphase)
+	{
+		Broadphase = broadphase;
+	}
+
+	BroadphaseType PhysicsManager::GetBroadphase() const
+	{
+		return Broadphase;
+	}
+
+	bool PhysicsManager::NeedsOctree() const
+	{
+		return std::any_of(ForceGenerators.begin(), ForceGenerators.end(), [](const std::shared_ptr<ForceGenerator>& generator)
+		{
+			return dynamic_cast<const BarnesHutGravity*>(generator.get()) != nullptr;
+		});
+	}
+
+	SleepSettings& PhysicsManager::GetSleepSettings()
+	{
+		return Sleep.Settings;
 	}
 
 	bool PhysicsManager::DetectCollisions()
 	{
 		CollisionPairs.clear();
 		CollisionDetectionJob.Work();
+
+		//the workers append in whatever order they finish - pairs hold the lower index first, and the buffer is one array,
+		//so pointer order is index order
+		if (bDeterministic)
+		{
+			std::sort(CollisionPairs.begin(), CollisionPairs.end());
+		}
+
+		BuildNarrowphaseBatches();
 		return true;
 	}
 
+	void PhysicsManager::BuildNarrowphaseBatches()
+	{
+		auto pairKey = [](const CollisionPair& pair) { return ShapePairKey(pair.first->Shape, pair.second->Shape); };
+
+		//counting sort by shape pair - one pass to count, one to scatter, and the pairs keep their relative order
+		size_t offsets[ShapeTypeCount * ShapeTypeCount + 1] = {};
+		for (auto& pair : CollisionPairs)
+		{
+			++offsets[pairKey(pair) + 1];
+		}
+		for (size_t key = 1; key <= ShapeTypeCount * ShapeTypeCount; ++key)
+		{
+			offsets[key] += offsets[key - 1];
+		}
+
+		NarrowphaseBatches.clear();
+		for (size_t key = 0; key < ShapeTypeCount * ShapeTypeCount; ++key)
+		{
+			for (size_t begin = offsets[key]; begin < offsets[key + 1]; begin += NarrowphaseBatchSize)
+			{
+				NarrowphaseBatches.push_back(BatchRange{ begin, std::min(begin + NarrowphaseBatchSize, offsets[key + 1]) });
+			}
+		}
+
+		//all spheres (or all of any one pair) is already sorted
+		const size_t firstKey = NarrowphaseBatches.empty() ? 0 : pairKey(CollisionPairs.front());
+		if (NarrowphaseBatches.size() <= 1 || offsets[firstKey + 1] - offsets[firstKey] == CollisionPairs.size())
+		{
+			return;
+		}
+
+		SortedCollisionPairs.resize(CollisionPairs.size());
+		for (auto& pair : CollisionPairs)
+		{
+			SortedCollisionPairs[offsets[pairKey(pair)]++] = pair;
+		}
+		std::swap(CollisionPairs, SortedCollisionPairs);
+	}
+
 	void PhysicsManager::ResolveCollisions()
 	{
-		CollisionResolutionJob.Work();
+		//build the contacts in parallel
+		Contacts.resize(CollisionPairs.size());
+		ContactPreparationJob.Work();
+
+		//bounding spheres that overlapped without the shapes touching, same cutoff as the preparation workers
+		const float separatedDepth = -Solver.Settings.PenetrationSlop;
+		Contacts.erase(std::remove_if(Contacts.begin(), Contacts.end(), [separatedDepth](const Contact& contact) { return contact.Penetration < separatedDepth; }), Contacts.end());
+
+		//Sequential impulse relies on each contact seeing the previous ones' results, but only within an island, so islands
+		//are solved in parallel. They share no movable objects and keep their contacts' order, so the results are the same
+		//bit for bit - deterministic mode included.
+		if (ContactSolveJob.GetNumThreads() <= 1)
+		{
+			Solver.Solve(Contacts, *StateBackBuffer);
+		}
+		else
+		{
+			Solver.BuildIslandBatches(Contacts, *StateBackBuffer, SolverBatchSize, SolverBatches);
+			ContactSolveJob.Work();
+		}
 	}
 
 	void PhysicsManager::ApplyAccelerationsAndImpulses()
-	{}
+	{
+		//external inputs can wake objects, so they have to go in before the batches are built
+		ApplyExternalInputs();
+		BuildIntegrationBatches();
+
+		//what each contact would otherwise rerun every generator for, Barnes-Hut included, twice
+		ForceAccelerations.assign(StateBackBuffer->size(), Vector4(0.0f));
+		RunBatches(BatchJobKind::Accelerations, IntegrationBatches);
+	}
+
+	Vector4 PhysicsManager::GetAcceleration(const PhysicsObject& object, const Vector4& position, const Vector4& velocity) const
+	{
+		if (object.InverseMass == 0.0f)
+		{
+			return Vector4(0.0f);
+		}
+
+		//external forces are held for the whole step, the generators are fields that change with position and velocity
+		Vector4 acceleration = object.Force * object.InverseMass;
+		for (auto& generator : ForceGenerators)
+		{
+			acceleration += generator->GetAcceleration(*StateFrontBuffer, object, position, velocity);
+		}
+		return acceleration;
+	}
+
+	void PhysicsManager::ApplyExternalInputs()
+	{
+		//swap the queue out so game threads aren't held up while we apply it
+		ExternalInputMutex.lock();
+		std::swap(ExternalInputs, PendingExternalInputs);
+		ExternalInputMutex.unlock();
+
+		auto& backBuffer = *StateBackBuffer;
+		ObjectChangeMutex.lock();
+		for (auto& input : ExternalInputs)
+		{
+			const size_t index = Handles.Find(input.Handle);
+			if (index == InvalidObjectIndex)
+			{
+				//added after this frame started - try again next frame (inputs for removed objects are just dropped)
+				if (Handles.IsValid(input.Handle))
+				{
+					DeferredExternalInputs.push_back(input);
+				}
+				continue;
+			}
+
+			if (backBuffer[index].InverseMass == 0.0f)
+			{
+				continue;
+			}
+
+			Sleep.Wake(index, backBuffer, AwakeObjects);
+
+			PhysicsObject& object = backBuffer[index];
+			if (input.bImpulse)
+			{
+				object.Velocity += input.Value * object.InverseMass;
+			}
+			else
+			{
+				object.Force += input.Value;
+			}
+		}
+		ObjectChangeMutex.unlock();
+		ExternalInputs.clear();
+
+		if (!DeferredExternalInputs.empty())
+		{
+			ExternalInputMutex.lock();
+			PendingExternalInputs.insert(PendingExternalInputs.end(), DeferredExternalInputs.begin(), DeferredExternalInputs.end());
+			ExternalInputMutex.unlock();
+			DeferredExternalInputs.clear();
+		}
+	}
+
+	void PhysicsManager::BuildIntegrationBatches()
+	{
+		IntegrationBatches.clear();
+		for (size_t begin = 0; begin < AwakeObjects.size(); begin += IntegrationBatchSize)
+		{
+			IntegrationBatches.push_back(BatchRange{ begin, std::min(begin + IntegrationBatchSize, AwakeObjects.size()) });
+		}
+	}
 
 	void PhysicsManager::ApplyVelocities()
 	{
-		ApplyVelocitiesJob.Work();
+		//same batches as the force stage, the awake set doesn't change in between
+		RunBatches(BatchJobKind::Integration, IntegrationBatches);
+	}
+
+	void PhysicsManager::RunBatches(BatchJobKind kind, std::vector<BatchRange>& batches)
+	{
+		BatchJobMutex.lock();
+		JobKind = kind;
+		CurrentJobBatches = &batches;
+		BatchJob.Work();
+		CurrentJobBatches = nullptr;
+		BatchJobMutex.unlock();
+	}
+
+	void PhysicsManager::DetectContinuousCollisions()
+	{
+		if (!ContinuousSettings.bEnabled)
+		{
+			return;
+		}
+
+		auto& frontBuffer = *StateFrontBuffer;
+		auto& backBuffer = *StateBackBuffer;
+
+		FastObjects.clear();
+		FastBounds.clear();
+		FastOrder.clear();
+		for (size_t index : AwakeObjects)
+		{
+			const PhysicsObject& start = frontBuffer[index];
+			const Vector4& end = backBuffer[index].Position;
+			const float fastDistance = start.CollisionRadius * ContinuousSettings.FastMotionFraction;
+			if ((end - start.Position).length3Squared() > fastDistance * fastDistance)
+			{
+				BoundingBox bounds;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					bounds.Min[axis] = std::min(start.Position[axis], end[axis]) - start.CollisionRadius;
+					bounds.Max[axis] = std::max(start.Position[axis], end[axis]) + start.CollisionRadius;
+				}
+
+				FastOrder.push_back(FastObjects.size());
+				FastObjects.push_back(index);
+				FastBounds.push_back(bounds);
+			}
+		}
+
+		if (FastObjects.empty())
+		{
+			return;
+		}
+
+		TimesOfImpact.resize(FastObjects.size());
+		ContinuousCollisionJob.Work();
+
+		//The broadphase only has where everything started the frame, so two fast objects crossing each other's paths can
+		//both be missed by the job. Every pair of them whose sweeps overlap is tested here, sweeping along x - the pair
+		//touches at the same time for both, and the order of the minimums doesn't change the result.
+		std::sort(FastOrder.begin(), FastOrder.end(), [this](size_t first, size_t second)
+		{
+			return FastBounds[first].Min.X < FastBounds[second].Min.X || (FastBounds[first].Min.X == FastBounds[second].Min.X && first < second);
+		});
+		for (auto first = FastOrder.begin(); first != FastOrder.end(); ++first)
+		{
+			for (auto second = first + 1; second != FastOrder.end() && FastBounds[*second].Min.X <= FastBounds[*first].Max.X; ++second)
+			{
+				if (!FastBounds[*first].Intersects(FastBounds[*second]))
+				{
+					continue;
+				}
+
+				const PhysicsObject& firstStart = frontBuffer[FastObjects[*first]];
+				const PhysicsObject& secondStart = frontBuffer[FastObjects[*second]];
+				const float distance = std::max(firstStart.CollisionRadius + secondStart.CollisionRadius - ContinuousSettings.ContactOverlap, 0.0f);
+				const float timeOfImpact = SweptSphereTimeOfImpact(firstStart.Position, backBuffer[firstStart.Index].Position - firstStart.Position,
+					secondStart.Position, backBuffer[secondStart.Index].Position - secondStart.Position, distance);
+				TimesOfImpact[*first] = std::min(TimesOfImpact[*first], timeOfImpact);
+				TimesOfImpact[*second] = std::min(TimesOfImpact[*second], timeOfImpact);
+			}
+		}
+
+		//pull each fast object back to where it first touches something - the discrete pass picks the contact up next frame
+		//(applied after the job so no worker reads a position that's being moved)
+		for (size_t fastIndex = 0; fastIndex < FastObjects.size(); ++fastIndex)
+		{
+			if (TimesOfImpact[fastIndex] < 1.0f)
+			{
+				const size_t index = FastObjects[fastIndex];
+				const Vector4 start = frontBuffer[index].Position;
+				backBuffer[index].Position = start + (backBuffer[index].Position - start) * TimesOfImpact[fastIndex];
+			}
+		}
+	}
+
+	void PhysicsManager::UpdateSleeping()
+	{
+		Sleep.Update(Contacts, *StateBackBuffer, AwakeObjects);
+	}
+
+	//the references between the pieces of a snapshot that would send the frame off the end of an array if they were wrong
+	static bool IsSnapshotConsistent(const simd_vector<PhysicsObject>& Objects, const std::vector<size_t>& AwakeObjects, const ShapeData& Shapes)
+	{
+		for (size_t index = 0; index < Objects.size(); ++index)
+		{
+			const PhysicsObject& object = Objects[index];
+			const size_t shape = static_cast<size_t>(object.Shape);
+			if (object.Index != index || shape >= ShapeTypeCount)
+			{
+				return false;
+			}
+
+			if (object.Shape != ShapeType::Sphere && (object.ShapeIndex >= Shapes.Owners[shape].size() || Shapes.Owners[shape][object.ShapeIndex] != index))
+			{
+				return false;
+			}
+		}
+
+		return std::all_of(AwakeObjects.begin(), AwakeObjects.end(), [&Objects](size_t index) { return index < Objects.size(); });
+	}
+
+	bool PhysicsManager::SaveSnapshot(const std::string& path)
+	{
+		SnapshotWriter writer;
+		if (!writer.Open(path))
+		{
+			return false;
+		}
+
+		ObjectChangeMutex.lock();
+		CurrentBufferMutex.lock();
+		AddPendingObjects();
+		RemovePendingObjects();
+
+		writer.Write(SnapshotSection::Objects, 0, *StateFrontBuffer);
+		writer.Write(SnapshotSection::AwakeObjects, 0, AwakeObjects);
+		Shapes.SaveSnapshot(writer);
+		Handles.SaveSnapshot(writer);
+		ContactCache.SaveSnapshot(writer);
+		Sleep.SaveSnapshot(writer);
+		writer.Write(SnapshotSection::FrameNumber, 0, &FrameNumber, 1);
+
+		CurrentBufferMutex.unlock();
+		ObjectChangeMutex.unlock();
+
+		return writer.Finish();
+	}
+
+	bool PhysicsManager::LoadSnapshot(const std::string& path)
+	{
+		//everything is loaded on the side and only swapped in once the whole snapshot checks out
+		SnapshotReader reader;
+		simd_vector<PhysicsObject> objects;
+		std::vector<size_t> awakeObjects;
+		ShapeData shapes;
+		ObjectHandleTable handles;
+		ContactManager contacts;
+		SleepManager sleep;
+		const uint64_t* frameNumber;
+		size_t numFrameNumbers;
+		if (!reader.Open(path) ||
+			!reader.Read(SnapshotSection::Objects, 0, objects) ||
+			!reader.Read(SnapshotSection::AwakeObjects, 0, awakeObjects) ||
+			!shapes.LoadSnapshot(reader) ||
+			!handles.LoadSnapshot(reader) ||
+			!contacts.LoadSnapshot(reader) ||
+			!sleep.LoadSnapshot(reader, objects.size()) ||
+			!reader.Find(SnapshotSection::FrameNumber, 0, frameNumber, numFrameNumbers) || numFrameNumbers != 1 ||
+			!IsSnapshotConsistent(objects, awakeObjects, shapes))
+		{
+			return false;
+		}
+
+		//settings aren't in the snapshot, keep the current ones
+		contacts.RevalidationThreshold = ContactCache.RevalidationThreshold;
+		sleep.Settings = Sleep.Settings;
+
+		ObjectChangeMutex.lock();
+		CurrentBufferMutex.lock();
+		*StateFrontBuffer = std::move(objects);
+		AwakeObjects = std::move(awakeObjects);
+		Shapes = std::move(shapes);
+		Handles = std::move(handles);
+		ContactCache = std::move(contacts);
+		Sleep = std::move(sleep);
+		FrameNumber = *frameNumber;
+		CurrentContactEvents.clear();
+		bObjectsReordered = true;
+
+		//their handles came from the table that was just replaced
+		PendingObjects.clear();
+		PendingObjectHandles.clear();
+		PendingShapes.Clear();
+		PendingRemovals.clear();
+		CurrentBufferMutex.unlock();
+		ObjectChangeMutex.unlock();
+
+		ExternalInputMutex.lock();
+		PendingExternalInputs.clear();
+		ExternalInputMutex.unlock();
+		DeferredExternalInputs.clear();
+
+		return true;
+	}
+
+	bool PhysicsManager::StartRecording(const std::string& path, size_t keyframeInterval)
+	{
+		StopRecording();
+
+		auto recorder = std::make_unique<TrajectoryRecorder>(keyframeInterval);
+		if (!recorder->Open(path))
+		{
+			return false;
+		}
+		Recorder = std::move(recorder);
+		return true;
+	}
+
+	bool PhysicsManager::StopRecording(uint64_t* outNumClampedValues)
+	{
+		if (outNumClampedValues)
+		{
+			*outNumClampedValues = 0;
+		}
+		if (!Recorder)
+		{
+			return true;
+		}
+
+		const bool bSucceeded = Recorder->Close();
+		if (outNumClampedValues)
+		{
+			*outNumClampedValues = Recorder->GetNumClampedValues();
+		}
+		Recorder.reset();
+		return bSucceeded;
+	}
+
+	void PhysicsManager::CopyObjectHandles(std::vector<ObjectHandle>& outputHandles)
+	{
+		//the handle table's dense order only changes with both locks held, along with the front buffer
+		ObjectChangeMutex.lock();
+		outputHandles.resize(StateFrontBuffer->size());
+		for (size_t index = 0; index < outputHandles.size(); ++index)
+		{
+			outputHandles[index] = Handles.GetHandle(index);
+		}
+		ObjectChangeMutex.unlock();
+	}
+
+	void PhysicsManager::CopyQueryState(simd_vector<PhysicsObject>& outputObjects, std::vector<ObjectHandle>& outputHandles, ShapeData& outputShapes)
+	{
+		//shapes and handles change with both locks held, the front buffer with the second
+		ObjectChangeMutex.lock();
+		CurrentBufferMutex.lock();
+		outputObjects = *StateFrontBuffer;
+		outputHandles.resize(outputObjects.size());
+		for (size_t index = 0; index < outputHandles.size(); ++index)
+		{
+			outputHandles[index] = Handles.GetHandle(index);
+		}
+		outputShapes = Shapes;
+		CurrentBufferMutex.unlock();
+		ObjectChangeMutex.unlock();
 	}
 
 	void PhysicsManager::CopyCurrentPhysicsObjects(simd_vector<PhysicsObject>& outputBuffer)
@@ -88,4 +1303,11 @@ namespace Physics
 		outputBuffer = *StateFrontBuffer;
 		CurrentBufferMutex.unlock();
 	}
+
+	void PhysicsManager::CopyContactEvents(std::vector<ContactEvent>& outputEvents)
+	{
+		CurrentBufferMutex.lock();
+		outputEvents = CurrentContactEvents;
+		CurrentBufferMutex.unlock();
+	}
 }
\ No newline at end of file
@@ -5,14 +5,31 @@
 #include <mutex>
 #include <atomic>
 #include <random>
+#include <memory>
+#include <string>
+#include <future>
+#include <functional>
 
 #include "../Core/Matrix4.hpp"
 #include "../Core/AlignedAllocator.hpp"
 #include "../Core/Task.hpp"
+#include "../Core/StageGraph.hpp"
 
 #include "Types.hpp"
 #include "TaskFunctions.hpp"
 #include "Octree.hpp"
+#include "HierarchicalGrid.hpp"
+#include "ContactSolver.hpp"
+#include "ContactManager.hpp"
+#include "SleepManager.hpp"
+#include "Integrators.hpp"
+#include "ForceGenerators.hpp"
+#include "BarnesHutGravity.hpp"
+#include "ContinuousCollision.hpp"
+#include "Shapes.hpp"
+#include "ObjectHandles.hpp"
+#include "Snapshot.hpp"
+#include "Trajectory.hpp"
 
 namespace Physics
 {
@@ -27,25 +44,207 @@ namespace Physics
 
 		bool RunFrame(float deltaTime);
 
-		void AddCollisionObject(const Core::Vector4& position, const Core::Vector4& velocity, float radius);
+		//Runs the frame on its own thread and returns straight away, so the caller can render the last finished frame
+		//(CopyCurrentPhysicsObjects and the other copies read the front buffer) or handle input in the meantime.
+		//The future becomes ready once the buffers have swapped, with what RunFrame would have returned - poll it with
+		//wait_for(0) or IsFrameRunning. A call while a frame is still running waits for it first, and so does RunFrame.
+		//Anything documented as between frames has to wait for the running one to finish first, see WaitForFrame.
+		std::shared_future<bool> RunFrameAsync(float deltaTime);
+
+		//false once the last frame started with RunFrameAsync has finished
+		bool IsFrameRunning() const;
+		//returns once the last frame started with RunFrameAsync has finished, straight away if there isn't one
+		void WaitForFrame();
+
+		//Called with RunFrame's result at the end of every frame, sync or async, on the thread that ran it - so an async frame's
+		//callback runs before its future is ready. The new front buffer can be read without waiting. Only set between frames.
+		void SetFrameCallback(std::function<void(bool)> callback);
+
+		//Objects are added and removed at the start of the next frame, so these are safe to call from any thread at any time.
+		//The handle stays valid until the object is removed - indices into the state buffers don't, see GetObjectIndex.
+
+		//zero mass makes the object immovable
+		ObjectHandle AddCollisionObject(const Core::Vector4& position, const Core::Vector4& velocity, float radius, float mass = 1.0f, float restitution = 1.0f);
+
+		//capsule along axis through position, halfHeight to each cap center
+		ObjectHandle AddCapsule(const Core::Vector4& position, const Core::Vector4& velocity, const Core::Vector4& axis, float halfHeight, float radius, float mass = 1.0f, float restitution = 1.0f);
+
+		//box with its local axes taken from the first three rows of orientation - there's no angular motion, so it keeps it
+		ObjectHandle AddBox(const Core::Vector4& position, const Core::Vector4& velocity, const Core::Vector4& halfExtents, const Core::Matrix4& orientation, float mass = 1.0f, float restitution = 1.0f);
+
+		//infinite static plane, everything is kept on the side normal points to
+		ObjectHandle AddPlane(const Core::Vector4& normal, float distance, float restitution = 1.0f);
+
+		//static world-space triangle mesh (indices are triples into vertices), its BVH is built here once and never rebuilt
+		//only spheres collide with meshes for now
+		ObjectHandle AddStaticMesh(const simd_vector<Core::Vector4>& vertices, const std::vector<unsigned int>& indices, float restitution = 1.0f);
+
+		//Bulk versions for spawning many spheres at once - the pending objects are sized once and built in parallel.
+		//positions, velocities and radii point at count elements each, velocities and radii can be null for at rest and unit size.
+		std::vector<ObjectHandle> AddCollisionObjects(const Core::Vector4* positions, const Core::Vector4* velocities, const float* radii, size_t count, float mass = 1.0f, float restitution = 1.0f);
+		//generator is called once per object, from the worker threads, with its number in [0, count)
+		std::vector<ObjectHandle> AddCollisionObjects(size_t count, const SpawnGenerator& generator);
+
+		//The last object is moved into the removed one's place, so removal changes at most one other object's index.
+		//Nothing tracks what rests on an immovable object, so removing one wakes every sleeping island - unless wakeResting
+		//is false, for stand-ins that are replaced where they were, like a domain's ghosts.
+		void RemoveObject(ObjectHandle handle, bool wakeResting = true);
+
+		//true from the add until the remove, even before the object shows up in the state buffers
+		bool IsValid(ObjectHandle handle);
+
+		//index into CopyCurrentPhysicsObjects' output (and for Springs), until the next frame applies removals or reorders
+		//InvalidObjectIndex if the object was removed or hasn't been added yet
+		size_t GetObjectIndex(ObjectHandle handle);
+
+		//copy of a single object's current state, false if it isn't there
+		bool CopyObject(ObjectHandle handle, PhysicsObject& outObject);
+
+		//handle of every object, in the same order as CopyCurrentPhysicsObjects' output (and contact event indices)
+		void CopyObjectHandles(std::vector<ObjectHandle>& outputHandles);
+
+		//objects, their handles and shape parameters all from the same frame, for building a QueryScene
+		void CopyQueryState(simd_vector<PhysicsObject>& outputObjects, std::vector<ObjectHandle>& outputHandles, ShapeData& outputShapes);
+
+		//generators are run over every awake object each frame, in the order they were added - only add or remove between frames
+		void AddForceGenerator(std::shared_ptr<ForceGenerator> generator);
+		void RemoveForceGenerator(const std::shared_ptr<ForceGenerator>& generator);
+
+		//mutual gravity between all objects through the collision octree, added as a force generator (remove it like any other)
+		std::shared_ptr<BarnesHutGravity> AddBarnesHutGravity(float gravitationalConstant, float openingAngle = 0.5f, float softening = 0.1f);
+
+		//safe to call from any thread, picked up at the start of the next frame (and wakes the object if it's asleep)
+		void ApplyForce(ObjectHandle handle, const Core::Vector4& force);
+		void ApplyImpulse(ObjectHandle handle, const Core::Vector4& impulse);
+
+		//iteration count, positional correction and warm starting for the contact solver
+		SolverSettings& GetSolverSettings();
+
+		//cached normal reuse threshold for contacts that persist between frames
+		ContactManager& GetContactManager();
+
+		//swept tests for objects moving a large fraction of their radius per frame
+		ContinuousCollisionSettings& GetContinuousCollisionSettings();
+
+		//takes effect from the next frame
+		void SetIntegrator(IntegratorType integrator);
+		IntegratorType GetIntegrator() const;
+
+		//Deterministic mode gives bit-identical results for the same inputs however many threads there are, for replays
+		//and for checking that changes to the parallel code don't change the results. It puts the collision pairs in
+		//index order before the solve, and hashes the state after every frame into FrameStateHash.
+		//External forces, adds and removals have to arrive between the same frames too, of course.
+		void SetDeterministic(bool deterministic);
+		bool IsDeterministic() const;
+
+		//Every this many frames the objects are sorted along a Morton curve, so objects close in space sit close in memory
+		//for detection and the solver. Their indices change when it happens, handles don't. 0, the default, turns it off.
+		void SetReorderInterval(unsigned int frames);
+		unsigned int GetReorderInterval() const;
+
+		//For multi-socket machines: pins the worker threads to cores in blocks per NUMA node, gives each thread a fixed
+		//contiguous slice of every job to start on, and places the state buffers so each slice's pages sit on its thread's node.
+		//With the Morton reordering each slice is also a region of space. Call between frames.
+		void SetNumaAware(bool numaAware);
+		bool IsNumaAware() const;
+
+		//Splits collision detection, contact preparation and the swept tests between the workers by what each stretch of
+		//objects cost them last frame, rather than handing out one item at a time. Cuts the contention on dense scenes where
+		//costs are uneven, and leans on the Morton reordering to keep each stretch in the same place. Call between frames.
+		void SetLoadBalanced(bool loadBalanced);
+		bool IsLoadBalanced() const;
+
+		//What finds the objects close enough to collide - the octree by default. The hierarchical grid's cost doesn't depend
+		//on how much the objects' sizes vary, for scenes from pebbles to asteroids. Barnes-Hut gravity still goes through the
+		//octree, so with the grid the octree is rebuilt as well while there's any. Takes effect from the next frame.
+		void SetBroadphase(BroadphaseType broadphase);
+		BroadphaseType GetBroadphase() const;
+
+		//sleep thresholds, or turn sleeping off entirely
+		SleepSettings& GetSleepSettings();
 
 		void CopyCurrentPhysicsObjects(simd_vector<PhysicsObject>& outputBuffer);
 
+		//Checkpoint of the simulation state - objects, shapes, handles, sleeping islands, the contact cache and the frame count - for restarting
+		//later with the same build. Only call between frames. Pending adds and removals are applied first, so every handle given
+		//out so far stays good across a save and load. Settings and force generators aren't part of it: set those up again.
+		bool SaveSnapshot(const std::string& path);
+
+		//replaces the whole simulation and drops anything pending, including queued forces - on failure nothing is touched
+		bool LoadSnapshot(const std::string& path);
+
+		//Record every object's position at the end of each frame, quantized across bounds fitted to the objects at each keyframe,
+		//see TrajectoryRecorder. Only call these between frames. Starting a new recording stops the current one.
+		bool StartRecording(const std::string& path, size_t keyframeInterval = 60);
+		//false if anything failed to write, outNumClampedValues gets how many coordinates couldn't be stored as they were (non-finite)
+		bool StopRecording(uint64_t* outNumClampedValues = nullptr);
+
+		//begin/persist/end events from the most recently finished frame
+		void CopyContactEvents(std::vector<ContactEvent>& outputEvents);
+
 		std::atomic<unsigned int> NumFrameCollisions;
 
+		//hash of every object's position, velocity and sleep state after the last frame, only kept up to date in deterministic mode
+		std::atomic<uint64_t> FrameStateHash;
+
 	private:
 
+		//the frame itself, RunFrame and RunFrameAsync only decide where it runs
+		bool StepFrame(float deltaTime);
+		//sets up FrameStages, once
+		void BuildFrameStages();
+
 		bool DetectCollisions();
 		void ResolveCollisions();
 		void ApplyAccelerationsAndImpulses();
 
+		//external forces plus every generator, for object at position moving at velocity - read-only, safe from any worker
+		Core::Vector4 GetAcceleration(const PhysicsObject& object, const Core::Vector4& position, const Core::Vector4& velocity) const;
+
 		void ApplyVelocities();
+		void DetectContinuousCollisions();
+		void UpdateSleeping();
+
+		void ApplyExternalInputs();
+		void BuildIntegrationBatches();
+
+		//runs kind over every batch on BatchJob's threads, returns once they're all done - one call at a time
+		void RunBatches(BatchJobKind kind, std::vector<BatchRange>& batches);
+		void BuildNarrowphaseBatches();
+
+		//queue an object whose shape (if any) was just pushed onto PendingShapes - call with ObjectChangeMutex held
+		ObjectHandle QueueObject(const Core::Vector4& position, const Core::Vector4& velocity, float boundingRadius, float mass, float restitution, ShapeType shape);
+
+		//index and sleep island are filled in when the object is actually added
+		static PhysicsObject MakeObject(const Core::Vector4& position, const Core::Vector4& velocity, float boundingRadius, float mass, float restitution, ShapeType shape, size_t shapeIndex);
+
+		void ApplyObjectChanges();
+		void AddPendingObjects();
+		void RemovePendingObjects();
+		void ReorderObjects();
+
+		//reallocates the state buffers and faults their pages in from the workers, if they moved or grew since last time
+		void PlaceStateBuffers();
+
+		//pass ObjectRemap on to everything else that holds on to object indices between frames
+		void RemapObjectIndices();
+
+		//whether anything needs the octree this frame, with the grid as the broadphase
+		bool NeedsOctree() const;
 
 		void SwapPhysicsStateBuffers();
 		void FinishFrame();
 
 		//set at the beginning of the frame
 		float CurrentDeltaTime;
+		//frames run so far, counting the current one
+		uint64_t FrameNumber;
+
+		bool bDeterministic;
+
+		IntegratorType Integrator;
+		BroadphaseType Broadphase;
+		ContinuousCollisionSettings ContinuousSettings;
 
 		//front and back buffers for threading
 		simd_vector<PhysicsObject> PhysicsStateBuffers[2];
@@ -58,17 +257,136 @@ namespace Physics
 		//lock when writing to back buffer
 		std::mutex BackBufferMutex;
 
-		std::vector<CollisionPair> CollisionPairs;
+		//indices of the objects that aren't asleep - detection and integration only iterate these
+		std::vector<size_t> AwakeObjects;
+		decltype(AwakeObjects)* CurrentAwakeBuffer;
+
+		CollisionPairList CollisionPairs;
 		decltype(CollisionPairs)* CurrentPairsBuffer;
+		//scratch for sorting the pairs by shape
+		CollisionPairList SortedCollisionPairs;
+
+		//runs of CollisionPairs with the same pair of shapes, handed to the contact preparation workers
+		std::vector<BatchRange> NarrowphaseBatches;
+		decltype(NarrowphaseBatches)* CurrentNarrowphaseBatches;
+
+		//parameters for the non-sphere objects
+		ShapeData Shapes;
+
+		//lock when touching the handle table or the pending adds and removes
+		std::mutex ObjectChangeMutex;
+		ObjectHandleTable Handles;
+		//waiting for the start of the next frame, with their shapes in PendingShapes
+		simd_vector<PhysicsObject> PendingObjects;
+		std::vector<ObjectHandle> PendingObjectHandles;
+		ShapeData PendingShapes;
+		struct PendingRemoval
+		{
+			ObjectHandle Handle;
+			bool bWakeResting;
+		};
+		std::vector<PendingRemoval> PendingRemovals;
+
+		//bulk spawn in progress: the generator, slices of it for the workers, and where its objects start in PendingObjects
+		const SpawnGenerator* CurrentSpawnGenerator;
+		std::vector<BatchRange> SpawnBatches;
+		size_t SpawnOffset;
+
+		//scratch for removals: where each object started before compaction, and where each one ended up
+		std::vector<size_t> ObjectOrigins;
+		std::vector<size_t> ObjectRemap;
+
+		unsigned int ReorderInterval;
+		//scratch for reordering, Morton code and current index of each object
+		std::vector<std::pair<uint64_t, size_t>> MortonOrder;
+
+		bool bNumaAware;
+		bool bLoadBalanced;
+		//storage of the two state buffers when they were last placed (in either order, they swap), and the object count then
+		const PhysicsObject* PlacedStorage[2];
+		size_t PlacedNumObjects;
+		//one slice per thread, and the raw storage for a state buffer being faulted in before the buffer takes it over
+		std::vector<BatchRange> PlacementBatches;
+		PhysicsObject* PlacementStorage;
+
+		struct ExternalInput
+		{
+			Core::Vector4 Value;
+			ObjectHandle Handle;
+			bool bImpulse;
+		};
+
+		//forces and impulses queued from outside the frame
+		simd_vector<ExternalInput> ExternalInputs;
+		simd_vector<ExternalInput> PendingExternalInputs;
+		//inputs for objects that weren't added yet when their frame started
+		simd_vector<ExternalInput> DeferredExternalInputs;
+		std::mutex ExternalInputMutex;
+
+		std::vector<std::shared_ptr<ForceGenerator>> ForceGenerators;
+
+		//slices of AwakeObjects handed to the integration workers
+		std::vector<BatchRange> IntegrationBatches;
+		//Each object's acceleration at the start of the step, evaluated once per frame for the contact solver - zero for
+		//objects that are asleep or immovable. Contacts only ever involve those and awake objects.
+		simd_vector<Core::Vector4> ForceAccelerations;
+
+		//awake objects that moved far enough this frame to need swept tests, and the fraction of the move each is allowed
+		std::vector<size_t> FastObjects;
+		decltype(FastObjects)* CurrentFastObjects;
+		std::vector<float> TimesOfImpact;
+		decltype(TimesOfImpact)* CurrentTimesOfImpact;
+		//each fast object's bounds over its whole move, grown by its radius, and the fast objects sorted by where those start along x
+		simd_vector<Core::BoundingBox> FastBounds;
+		std::vector<size_t> FastOrder;
+
+		//one per collision pair, same order, until the separated ones are dropped before the solve
+		simd_vector<Contact> Contacts;
+		decltype(Contacts)* CurrentContactsBuffer;
+		//whole islands of Contacts, handed to the solver workers
+		std::vector<BatchRange> SolverBatches;
+		decltype(SolverBatches)* CurrentSolverBatches;
 
 		friend struct DetectCollisionsWorkerFunction;
-		friend struct ResolveCollisionsWorkerFunction;
-		friend struct ApplyVelocitiesWorkerFunction;
+		friend struct PrepareContactsWorkerFunction;
+		friend struct SolveContactsWorkerFunction;
+		friend struct ContinuousCollisionWorkerFunction;
+		friend struct BatchWorkerFunction;
+
+		Task<std::vector<size_t>, CollisionPairList, DetectCollisionsWorkerFunction, PhysicsManager> CollisionDetectionJob;
+		Task<std::vector<BatchRange>, simd_vector<Contact>, PrepareContactsWorkerFunction, PhysicsManager> ContactPreparationJob;
+		Task<std::vector<BatchRange>, simd_vector<Contact>, SolveContactsWorkerFunction, PhysicsManager> ContactSolveJob;
+		Task<std::vector<size_t>, std::vector<float>, ContinuousCollisionWorkerFunction, PhysicsManager> ContinuousCollisionJob;
 
-		Task<simd_vector<PhysicsObject>, std::vector<CollisionPair>, DetectCollisionsWorkerFunction, PhysicsManager> CollisionDetectionJob;
-		Task<std::vector<CollisionPair>, simd_vector<PhysicsObject>, ResolveCollisionsWorkerFunction, PhysicsManager> CollisionResolutionJob;
-		Task<simd_vector<PhysicsObject>, simd_vector<PhysicsObject>, ApplyVelocitiesWorkerFunction, PhysicsManager> ApplyVelocitiesJob;
+		//The stages that use it all write the back buffer, so they never overlap, and bulk spawns from outside the frame
+		//wait for BatchJobMutex. What the call in progress runs, and on which batches:
+		BatchJobKind JobKind;
+		decltype(JobKind)* CurrentJobKind;
+		std::vector<BatchRange>* CurrentJobBatches;
+		std::mutex BatchJobMutex;
+		Task<std::vector<BatchRange>, BatchJobKind, BatchWorkerFunction, PhysicsManager> BatchJob;
 
 		Octree CollisionOctree;
+		HierarchicalGrid CollisionGrid;
+		ContactSolver Solver;
+		ContactManager ContactCache;
+		SleepManager Sleep;
+
+		//events for the front buffer's frame, swapped in with it
+		std::vector<ContactEvent> CurrentContactEvents;
+
+		//fed the front buffer right after each swap, null when not recording
+		std::unique_ptr<TrajectoryRecorder> Recorder;
+		//objects moved to other indices since the last recorded frame
+		bool bObjectsReordered;
+
+		//the last frame started by RunFrameAsync, invalid if there hasn't been one
+		std::shared_future<bool> RunningFrame;
+		std::function<void(bool)> FrameCallback;
+
+		//what DetectCollisions said this frame
+		bool bFrameResult;
+		//every stage of a frame, declared with what it reads and writes so the independent ones overlap
+		Core::StageGraph FrameStages;
 	};
 }
\ No newline at end of file
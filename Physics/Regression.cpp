@@ -0,0 +1,225 @@
+#include "Regression.hpp"
+
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+using namespace Core;
+namespace Physics
+{
+	RegressionScene::RegressionScene() :
+		Seed(1),
+		NumObjects(2000),
+		NumFrames(300),
+		DeltaTime(1.0f / 60.0f)
+	{}
+
+	RegressionConfiguration::RegressionConfiguration() :
+		NumThreads(4),
+		bDeterministic(false)
+	{}
+
+	RegressionTolerances::RegressionTolerances() :
+		PositionError(1e-3f),
+		PairMismatches(0)
+	{}
+
+	//what the comparison needs out of one frame of a run
+	struct RegressionFrame
+	{
+		simd_vector<Vector4> Positions;
+		//pair keys of everything touching, sorted
+		std::vector<uint64_t> Pairs;
+	};
+
+	static void BuildDefaultScene(PhysicsManager& Manager, const RegressionScene& Scene)
+	{
+		Manager.AddForceGenerator(std::shared_ptr<ForceGenerator>(new UniformGravity(Vector4(0.0f, -9.8f, 0.0f))));
+		Manager.AddPlane(Vector4(0.0f, 1.0f, 0.0f), 0.0f, 0.3f);
+
+		std::mt19937 engine(Scene.Seed);
+		std::uniform_real_distribution<float> horizontal(-20.0f, 20.0f);
+		std::uniform_real_distribution<float> height(1.0f, 40.0f);
+		std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+
+		//mostly spheres, with a capsule and a box in every ten objects to cover the other narrowphase tests
+		for (size_t object = 0; object < Scene.NumObjects; ++object)
+		{
+			const Vector4 position(horizontal(engine), height(engine), horizontal(engine));
+			const Vector4 velocity(speed(engine), 0.0f, speed(engine));
+			switch (object % 10)
+			{
+			case 3:
+				Manager.AddCapsule(position, velocity, Vector4(1.0f, 0.0f, 0.0f), 0.5f, 0.4f, 1.0f, 0.3f);
+				break;
+			case 7:
+				Manager.AddBox(position, velocity, Vector4(0.5f, 0.5f, 0.5f), Matrix4(), 1.0f, 0.3f);
+				break;
+			default:
+				Manager.AddCollisionObject(position, velocity, 0.5f, 1.0f, 0.3f);
+				break;
+			}
+		}
+	}
+
+	//objects are compared by handle slot rather than index, as reordering moves them around differently in each run
+	static void CaptureFrame(PhysicsManager& Manager, simd_vector<PhysicsObject>& Objects, std::vector<ContactEvent>& Events, std::vector<ObjectHandle>& Handles,
+		RegressionFrame& OutFrame)
+	{
+		Manager.CopyCurrentPhysicsObjects(Objects);
+		Manager.CopyObjectHandles(Handles);
+		if (Handles.size() != Objects.size())
+		{
+			//an object came or went in between the copies, leave it to the size check to fail the frame
+			OutFrame.Positions.clear();
+			OutFrame.Pairs.clear();
+			return;
+		}
+
+		OutFrame.Positions.resize(Objects.size());
+		std::vector<std::pair<uint32_t, size_t>> order(Objects.size());
+		for (size_t object = 0; object < Objects.size(); ++object)
+		{
+			order[object] = std::make_pair(Handles[object].Slot, object);
+		}
+		std::sort(order.begin(), order.end());
+		for (size_t object = 0; object < order.size(); ++object)
+		{
+			OutFrame.Positions[object] = Objects[order[object].second].Position;
+		}
+
+		//begin and persist events are exactly the pairs touching this frame
+		Manager.CopyContactEvents(Events);
+		OutFrame.Pairs.clear();
+		for (auto& event : Events)
+		{
+			if (event.Type != ContactEventType::End && event.IndexA < Handles.size() && event.IndexB < Handles.size())
+			{
+				OutFrame.Pairs.push_back(MakePairKey(Handles[event.IndexA].Slot, Handles[event.IndexB].Slot));
+			}
+		}
+		std::sort(OutFrame.Pairs.begin(), OutFrame.Pairs.end());
+	}
+
+	//returns the time spent in RunFrame - OnFrame is free to swap the frame's contents out
+	static double RunScene(const RegressionScene& Scene, int NumThreads, bool bDeterministic, const std::function<void(PhysicsManager&)>& Configure,
+		const std::function<void(size_t, RegressionFrame&)>& OnFrame)
+	{
+		PhysicsManager manager(NumThreads, Scene.NumObjects);
+		manager.SetDeterministic(bDeterministic);
+		if (Scene.Build)
+		{
+			Scene.Build(manager, Scene);
+		}
+		else
+		{
+			BuildDefaultScene(manager, Scene);
+		}
+		if (Configure)
+		{
+			Configure(manager);
+		}
+
+		double seconds = 0.0;
+		simd_vector<PhysicsObject> objects;
+		std::vector<ContactEvent> events;
+		std::vector<ObjectHandle> handles;
+		RegressionFrame frame;
+		for (size_t frameIndex = 0; frameIndex < Scene.NumFrames; ++frameIndex)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			manager.RunFrame(Scene.DeltaTime);
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			CaptureFrame(manager, objects, events, handles, frame);
+			OnFrame(frameIndex, frame);
+		}
+		return seconds;
+	}
+
+	//size of the symmetric difference of two sorted sets
+	static size_t CountMismatches(const std::vector<uint64_t>& A, const std::vector<uint64_t>& B)
+	{
+		size_t mismatches = 0;
+		size_t a = 0;
+		size_t b = 0;
+		while (a < A.size() && b < B.size())
+		{
+			if (A[a] == B[b])
+			{
+				++a;
+				++b;
+			}
+			else
+			{
+				++mismatches;
+				A[a] < B[b] ? ++a : ++b;
+			}
+		}
+		return mismatches + (A.size() - a) + (B.size() - b);
+	}
+
+	RegressionReport RunRegression(const RegressionScene& Scene, const RegressionConfiguration& Configuration, const RegressionTolerances& Tolerances)
+	{
+		RegressionReport report;
+		report.bPassed = true;
+		report.NumFrames = Scene.NumFrames;
+		report.FirstFailedFrame = InvalidObjectIndex;
+		report.MaxPositionError = 0.0f;
+		report.MaxPairMismatches = 0;
+
+		std::vector<RegressionFrame> referenceFrames(Scene.NumFrames);
+		report.ReferenceSeconds = RunScene(Scene, 1, true, nullptr, [&referenceFrames](size_t FrameIndex, RegressionFrame& Frame)
+		{
+			std::swap(referenceFrames[FrameIndex].Positions, Frame.Positions);
+			std::swap(referenceFrames[FrameIndex].Pairs, Frame.Pairs);
+		});
+
+		report.CheckedSeconds = RunScene(Scene, Configuration.NumThreads, Configuration.bDeterministic, Configuration.Configure, [&](size_t FrameIndex, RegressionFrame& Frame)
+		{
+			const RegressionFrame& expected = referenceFrames[FrameIndex];
+
+			float positionError = 0.0f;
+			if (Frame.Positions.size() != expected.Positions.size())
+			{
+				positionError = std::numeric_limits<float>::infinity();
+			}
+			else
+			{
+				for (size_t object = 0; object < Frame.Positions.size(); ++object)
+				{
+					positionError = std::max(positionError, (Frame.Positions[object] - expected.Positions[object]).length3());
+				}
+			}
+			const size_t pairMismatches = CountMismatches(Frame.Pairs, expected.Pairs);
+
+			report.MaxPositionError = std::max(report.MaxPositionError, positionError);
+			report.MaxPairMismatches = std::max(report.MaxPairMismatches, pairMismatches);
+			if (report.bPassed && (positionError > Tolerances.PositionError || pairMismatches > Tolerances.PairMismatches))
+			{
+				report.bPassed = false;
+				report.FirstFailedFrame = FrameIndex;
+			}
+		});
+
+		report.Speedup = report.CheckedSeconds > 0.0 ? report.ReferenceSeconds / report.CheckedSeconds : 0.0;
+		return report;
+	}
+
+	void PrintRegressionReport(const RegressionReport& Report, std::ostream& Output)
+	{
+		Output << "Regression over " << Report.NumFrames << " frames: ";
+		if (Report.bPassed)
+		{
+			Output << "passed" << std::endl;
+		}
+		else
+		{
+			Output << "FAILED from frame " << Report.FirstFailedFrame << std::endl;
+		}
+
+		Output << "  max position error " << Report.MaxPositionError << ", max pair mismatches " << Report.MaxPairMismatches << std::endl;
+		Output << "  reference " << Report.ReferenceSeconds << "s, checked " << Report.CheckedSeconds << "s, speedup " << Report.Speedup << "x" << std::endl;
+	}
+}
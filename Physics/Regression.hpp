@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <ostream>
+
+#include "PhysicsManager.hpp"
+
+namespace Physics
+{
+	//Correctness gate for optimized paths: the same seeded scene is run once as a reference (one worker thread,
+	//deterministic mode) and once in the configuration being checked, comparing positions and touching pairs every frame.
+	//The vector math (SSE or FPU) is picked at build time in Vector4.hpp, so checking one against the other takes a build of each.
+
+	struct RegressionScene
+	{
+		RegressionScene();
+
+		unsigned int Seed;
+		size_t NumObjects;
+		size_t NumFrames;
+		float DeltaTime;
+
+		//replaces the built-in scene (spheres, capsules and boxes dropped onto a plane under gravity)
+		//called on a fresh manager for each run, so it has to build the same thing from the same seed every time
+		std::function<void(PhysicsManager&, const RegressionScene&)> Build;
+	};
+
+	//the reference always runs on a single worker thread in deterministic mode, with whatever the scene sets up
+	struct RegressionConfiguration
+	{
+		RegressionConfiguration();
+
+		int NumThreads;
+		bool bDeterministic;
+
+		//anything else to change for the checked run only, after the scene is built
+		std::function<void(PhysicsManager&)> Configure;
+	};
+
+	//anything over these in any frame fails the run
+	struct RegressionTolerances
+	{
+		RegressionTolerances();
+
+		float PositionError;
+		//touching pairs found by one run and not the other
+		size_t PairMismatches;
+	};
+
+	struct RegressionReport
+	{
+		bool bPassed;
+		size_t NumFrames;
+		//InvalidObjectIndex if every frame was within tolerance
+		size_t FirstFailedFrame;
+		//worst over all frames - a frame with a different object count counts as an infinite error
+		float MaxPositionError;
+		size_t MaxPairMismatches;
+		//time spent in RunFrame, not counting the comparisons
+		double ReferenceSeconds;
+		double CheckedSeconds;
+		double Speedup;
+	};
+
+	//the runs go one after the other, so the reference's idle workers aren't competing with the checked run for the timings
+	RegressionReport RunRegression(const RegressionScene& Scene, const RegressionConfiguration& Configuration, const RegressionTolerances& Tolerances);
+
+	void PrintRegressionReport(const RegressionReport& Report, std::ostream& Output);
+}
@@ -0,0 +1,476 @@
+#include "Shapes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Core;
+namespace Physics
+{
+	//refinement passes for the capsule-box closest points, converges in two or three for most poses
+	static const int CapsuleBoxIterations = 4;
+
+	//edge-edge axes have to win by this much over a face axis, so flat resting contacts don't flip to a grazing edge normal
+	static const float EdgeAxisBias = 0.95f;
+
+	static Vector4 Cross(const Vector4& a, const Vector4& b)
+	{
+		return Vector4(a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X);
+	}
+
+	static void BeginContact(const PhysicsObject& A, const PhysicsObject& B, Contact& OutContact)
+	{
+		OutContact.IndexA = A.Index;
+		OutContact.IndexB = B.Index;
+		OutContact.RelativePosition = A.Position - B.Position;
+	}
+
+	Vector4 ClosestPointOnSegment(const Vector4& Point, const Vector4& Start, const Vector4& End)
+	{
+		const Vector4 segment = End - Start;
+		const float lengthSquared = segment.length3Squared();
+		const float t = lengthSquared > 0.0f ? std::min(std::max((Point - Start).dot3(segment) / lengthSquared, 0.0f), 1.0f) : 0.0f;
+		return Start + segment * t;
+	}
+
+	//closest points between segments P and Q, clamped to both
+	static void ClosestPointsBetweenSegments(const Vector4& StartP, const Vector4& EndP, const Vector4& StartQ, const Vector4& EndQ, Vector4& OutP, Vector4& OutQ)
+	{
+		const Vector4 d1 = EndP - StartP;
+		const Vector4 d2 = EndQ - StartQ;
+		const Vector4 r = StartP - StartQ;
+		const float a = d1.length3Squared();
+		const float e = d2.length3Squared();
+		const float f = d2.dot3(r);
+
+		float s = 0.0f;
+		float t = 0.0f;
+		if (a <= 0.0f && e <= 0.0f)
+		{
+			//both degenerate
+		}
+		else if (a <= 0.0f)
+		{
+			t = std::min(std::max(f / e, 0.0f), 1.0f);
+		}
+		else
+		{
+			const float c = d1.dot3(r);
+			if (e <= 0.0f)
+			{
+				s = std::min(std::max(-c / a, 0.0f), 1.0f);
+			}
+			else
+			{
+				const float b = d1.dot3(d2);
+				const float denominator = a * e - b * b;
+
+				//parallel segments give a zero denominator, any s works so start from P's start
+				s = denominator > 0.0f ? std::min(std::max((b * f - c * e) / denominator, 0.0f), 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+
+				//t out of range - clamp it and recompute s for the clamped t
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = std::min(std::max(-c / a, 0.0f), 1.0f);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = std::min(std::max((b - c) / a, 0.0f), 1.0f);
+				}
+			}
+		}
+
+		OutP = StartP + d1 * s;
+		OutQ = StartQ + d2 * t;
+	}
+
+	Vector4 ClosestPointOnBox(const Vector4& Point, const Vector4& Center, const BoxShape& Box)
+	{
+		const Vector4 offset = Point - Center;
+		Vector4 result = Center;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float distance = std::min(std::max(offset.dot3(Box.Axes[axis]), -Box.HalfExtents[axis]), Box.HalfExtents[axis]);
+			result += Box.Axes[axis] * distance;
+		}
+		return result;
+	}
+
+	//projected half-width of the box onto a unit axis
+	static float ProjectBox(const BoxShape& Box, const Vector4& Axis)
+	{
+		return Box.HalfExtents.X * std::abs(Box.Axes[0].dot3(Axis)) +
+			Box.HalfExtents.Y * std::abs(Box.Axes[1].dot3(Axis)) +
+			Box.HalfExtents.Z * std::abs(Box.Axes[2].dot3(Axis));
+	}
+
+	//sphere (or a point on a capsule's segment) at PointA against sphere at PointB
+	static void PointPoint(const Vector4& PointA, float RadiusA, const Vector4& PointB, float RadiusB, Contact& OutContact)
+	{
+		const Vector4 offset = PointA - PointB;
+		const float distance = offset.length3();
+
+		//coincident centers have no meaningful normal, just pick one
+		OutContact.Normal = distance > 0.0f ? offset / distance : Vector4(0.0f, 1.0f, 0.0f);
+		OutContact.Penetration = RadiusA + RadiusB - distance;
+	}
+
+	//sphere at Point against the box, normal from the box to the sphere
+	static void PointBox(const Vector4& Point, float Radius, const Vector4& BoxCenter, const BoxShape& Box, Vector4& OutNormal, float& OutPenetration)
+	{
+		const Vector4 closest = ClosestPointOnBox(Point, BoxCenter, Box);
+		const Vector4 offset = Point - closest;
+		const float distanceSquared = offset.length3Squared();
+		if (distanceSquared > 0.0f)
+		{
+			const float distance = std::sqrt(distanceSquared);
+			OutNormal = offset / distance;
+			OutPenetration = Radius - distance;
+			return;
+		}
+
+		//center inside the box - push out through the nearest face
+		const Vector4 local = Point - BoxCenter;
+		int nearestAxis = 0;
+		float nearestDepth = Box.HalfExtents[0] - std::abs(local.dot3(Box.Axes[0]));
+		for (int axis = 1; axis < 3; ++axis)
+		{
+			const float depth = Box.HalfExtents[axis] - std::abs(local.dot3(Box.Axes[axis]));
+			if (depth < nearestDepth)
+			{
+				nearestDepth = depth;
+				nearestAxis = axis;
+			}
+		}
+
+		OutNormal = local.dot3(Box.Axes[nearestAxis]) < 0.0f ? Vector4(0.0f) - Box.Axes[nearestAxis] : Box.Axes[nearestAxis];
+		OutPenetration = Radius + nearestDepth;
+	}
+
+	static void SphereSphere(const PhysicsObject& A, const PhysicsObject& B, const ShapeData&, Contact& OutContact)
+	{
+		BeginContact(A, B, OutContact);
+		PointPoint(A.Position, A.CollisionRadius, B.Position, B.CollisionRadius, OutContact);
+	}
+
+	static void SphereCapsule(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const CapsuleShape& capsule = Shapes.Capsules[B.ShapeIndex];
+		const Vector4 closest = ClosestPointOnSegment(A.Position, B.Position - capsule.Axis * capsule.HalfHeight, B.Position + capsule.Axis * capsule.HalfHeight);
+
+		BeginContact(A, B, OutContact);
+		PointPoint(A.Position, A.CollisionRadius, closest, capsule.Radius, OutContact);
+	}
+
+	static void SphereBox(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		BeginContact(A, B, OutContact);
+		PointBox(A.Position, A.CollisionRadius, B.Position, Shapes.Boxes[B.ShapeIndex], OutContact.Normal, OutContact.Penetration);
+	}
+
+	static void SpherePlane(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const PlaneShape& plane = Shapes.Planes[B.ShapeIndex];
+
+		BeginContact(A, B, OutContact);
+		OutContact.Normal = plane.Normal;
+		OutContact.Penetration = A.CollisionRadius - (plane.Normal.dot3(A.Position) - plane.Distance);
+	}
+
+	static void CapsuleCapsule(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const CapsuleShape& first = Shapes.Capsules[A.ShapeIndex];
+		const CapsuleShape& second = Shapes.Capsules[B.ShapeIndex];
+
+		Vector4 closestA, closestB;
+		ClosestPointsBetweenSegments(A.Position - first.Axis * first.HalfHeight, A.Position + first.Axis * first.HalfHeight,
+			B.Position - second.Axis * second.HalfHeight, B.Position + second.Axis * second.HalfHeight, closestA, closestB);
+
+		BeginContact(A, B, OutContact);
+		PointPoint(closestA, first.Radius, closestB, second.Radius, OutContact);
+	}
+
+	static void CapsuleBox(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const CapsuleShape& capsule = Shapes.Capsules[A.ShapeIndex];
+		const BoxShape& box = Shapes.Boxes[B.ShapeIndex];
+		const Vector4 start = A.Position - capsule.Axis * capsule.HalfHeight;
+		const Vector4 end = A.Position + capsule.Axis * capsule.HalfHeight;
+
+		//alternate closest point on the box and closest point back on the segment
+		Vector4 point = A.Position;
+		for (int iteration = 0; iteration < CapsuleBoxIterations; ++iteration)
+		{
+			point = ClosestPointOnSegment(ClosestPointOnBox(point, B.Position, box), start, end);
+		}
+
+		BeginContact(A, B, OutContact);
+		PointBox(point, capsule.Radius, B.Position, box, OutContact.Normal, OutContact.Penetration);
+
+		//once the segment is inside the box every point is its own closest point, so also try the ends and keep the deepest
+		const Vector4 ends[2] = { start, end };
+		for (auto& endPoint : ends)
+		{
+			Vector4 normal;
+			float penetration;
+			PointBox(endPoint, capsule.Radius, B.Position, box, normal, penetration);
+			if (penetration > OutContact.Penetration)
+			{
+				OutContact.Normal = normal;
+				OutContact.Penetration = penetration;
+			}
+		}
+	}
+
+	static void CapsulePlane(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const CapsuleShape& capsule = Shapes.Capsules[A.ShapeIndex];
+		const PlaneShape& plane = Shapes.Planes[B.ShapeIndex];
+		const float extent = capsule.Radius + capsule.HalfHeight * std::abs(capsule.Axis.dot3(plane.Normal));
+
+		BeginContact(A, B, OutContact);
+		OutContact.Normal = plane.Normal;
+		OutContact.Penetration = extent - (plane.Normal.dot3(A.Position) - plane.Distance);
+	}
+
+	//separating axis test over the 3 + 3 face normals and 9 edge cross products, keeping the axis of least overlap
+	static void BoxBox(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const BoxShape& first = Shapes.Boxes[A.ShapeIndex];
+		const BoxShape& second = Shapes.Boxes[B.ShapeIndex];
+		const Vector4 offset = A.Position - B.Position;
+
+		BeginContact(A, B, OutContact);
+		OutContact.Penetration = std::numeric_limits<float>::max();
+
+		auto testAxis = [&](Vector4 axis, float bias)
+		{
+			const float lengthSquared = axis.length3Squared();
+			//parallel edges give a degenerate cross product, the face axes already cover that case
+			if (lengthSquared < 1e-6f)
+			{
+				return true;
+			}
+			axis /= std::sqrt(lengthSquared);
+
+			const float separation = offset.dot3(axis);
+			const float overlap = ProjectBox(first, axis) + ProjectBox(second, axis) - std::abs(separation);
+			if (overlap < 0.0f)
+			{
+				OutContact.Normal = separation < 0.0f ? Vector4(0.0f) - axis : axis;
+				OutContact.Penetration = overlap;
+				return false;
+			}
+
+			if (overlap < OutContact.Penetration * bias)
+			{
+				OutContact.Normal = separation < 0.0f ? Vector4(0.0f) - axis : axis;
+				OutContact.Penetration = overlap;
+			}
+			return true;
+		};
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (!testAxis(first.Axes[axis], 1.0f) || !testAxis(second.Axes[axis], 1.0f))
+			{
+				return;
+			}
+		}
+
+		for (int axisA = 0; axisA < 3; ++axisA)
+		{
+			for (int axisB = 0; axisB < 3; ++axisB)
+			{
+				if (!testAxis(Cross(first.Axes[axisA], second.Axes[axisB]), EdgeAxisBias))
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	static void BoxPlane(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		const PlaneShape& plane = Shapes.Planes[B.ShapeIndex];
+
+		BeginContact(A, B, OutContact);
+		OutContact.Normal = plane.Normal;
+		OutContact.Penetration = ProjectBox(Shapes.Boxes[A.ShapeIndex], plane.Normal) - (plane.Normal.dot3(A.Position) - plane.Distance);
+	}
+
+	static void SphereMesh(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		BeginContact(A, B, OutContact);
+		if (!Shapes.Meshes[B.ShapeIndex].GetDeepestContact(A.Position, A.CollisionRadius, OutContact.Normal, OutContact.Penetration))
+		{
+			//detection only checked the leaf bounds, no triangle is actually in reach
+			OutContact.Normal = Vector4(0.0f, 1.0f, 0.0f);
+			OutContact.Penetration = -std::numeric_limits<float>::max();
+		}
+	}
+
+	template<typename Bucket>
+	static size_t AppendEntry(Bucket& Destination, Bucket& Source, size_t SourceIndex)
+	{
+		Destination.push_back(std::move(Source[SourceIndex]));
+		return Destination.size() - 1;
+	}
+
+	template<typename Bucket>
+	static void SwapAndPop(Bucket& Entries, size_t Index)
+	{
+		if (Index != Entries.size() - 1)
+		{
+			Entries[Index] = std::move(Entries.back());
+		}
+		Entries.pop_back();
+	}
+
+	size_t ShapeData::Append(ShapeType Type, ShapeData& Source, size_t SourceIndex, size_t Owner)
+	{
+		size_t index = 0;
+		switch (Type)
+		{
+		case ShapeType::Capsule:
+			index = AppendEntry(Capsules, Source.Capsules, SourceIndex);
+			break;
+		case ShapeType::Box:
+			index = AppendEntry(Boxes, Source.Boxes, SourceIndex);
+			break;
+		case ShapeType::Plane:
+			index = AppendEntry(Planes, Source.Planes, SourceIndex);
+			break;
+		case ShapeType::Mesh:
+			index = AppendEntry(Meshes, Source.Meshes, SourceIndex);
+			break;
+		default:
+			return 0;
+		}
+
+		Owners[static_cast<size_t>(Type)].push_back(Owner);
+		return index;
+	}
+
+	size_t ShapeData::Remove(ShapeType Type, size_t ShapeIndex)
+	{
+		switch (Type)
+		{
+		case ShapeType::Capsule:
+			SwapAndPop(Capsules, ShapeIndex);
+			break;
+		case ShapeType::Box:
+			SwapAndPop(Boxes, ShapeIndex);
+			break;
+		case ShapeType::Plane:
+			SwapAndPop(Planes, ShapeIndex);
+			break;
+		case ShapeType::Mesh:
+			SwapAndPop(Meshes, ShapeIndex);
+			break;
+		default:
+			return InvalidObjectIndex;
+		}
+
+		auto& owners = Owners[static_cast<size_t>(Type)];
+		const bool bMoved = ShapeIndex != owners.size() - 1;
+		SwapAndPop(owners, ShapeIndex);
+		return bMoved ? owners[ShapeIndex] : InvalidObjectIndex;
+	}
+
+	void ShapeData::Clear()
+	{
+		Capsules.clear();
+		Boxes.clear();
+		Planes.clear();
+		Meshes.clear();
+		for (auto& owners : Owners)
+		{
+			owners.clear();
+		}
+	}
+
+	void ShapeData::RemapOwners(const std::vector<size_t>& NewIndices)
+	{
+		for (auto& owners : Owners)
+		{
+			for (auto& owner : owners)
+			{
+				owner = NewIndices[owner];
+			}
+		}
+	}
+
+	void ShapeData::SaveSnapshot(SnapshotWriter& Writer) const
+	{
+		Writer.Write(SnapshotSection::Capsules, 0, Capsules);
+		Writer.Write(SnapshotSection::Boxes, 0, Boxes);
+		Writer.Write(SnapshotSection::Planes, 0, Planes);
+		for (size_t mesh = 0; mesh < Meshes.size(); ++mesh)
+		{
+			Meshes[mesh].SaveSnapshot(Writer, static_cast<uint32_t>(mesh));
+		}
+
+		for (size_t type = 0; type < ShapeTypeCount; ++type)
+		{
+			Writer.Write(SnapshotSection::ShapeOwners, static_cast<uint32_t>(type), Owners[type]);
+		}
+	}
+
+	bool ShapeData::LoadSnapshot(const SnapshotReader& Reader)
+	{
+		for (size_t type = 0; type < ShapeTypeCount; ++type)
+		{
+			if (!Reader.Read(SnapshotSection::ShapeOwners, static_cast<uint32_t>(type), Owners[type]))
+			{
+				return false;
+			}
+		}
+
+		if (!Reader.Read(SnapshotSection::Capsules, 0, Capsules) || !Reader.Read(SnapshotSection::Boxes, 0, Boxes) || !Reader.Read(SnapshotSection::Planes, 0, Planes))
+		{
+			return false;
+		}
+
+		//meshes aren't stored in one section, their owners say how many there are
+		Meshes.resize(Owners[static_cast<size_t>(ShapeType::Mesh)].size());
+		for (size_t mesh = 0; mesh < Meshes.size(); ++mesh)
+		{
+			if (!Meshes[mesh].LoadSnapshot(Reader, static_cast<uint32_t>(mesh)))
+			{
+				return false;
+			}
+		}
+
+		return Owners[static_cast<size_t>(ShapeType::Sphere)].empty() &&
+			Owners[static_cast<size_t>(ShapeType::Capsule)].size() == Capsules.size() &&
+			Owners[static_cast<size_t>(ShapeType::Box)].size() == Boxes.size() &&
+			Owners[static_cast<size_t>(ShapeType::Plane)].size() == Planes.size();
+	}
+
+	//the same test with the arguments the other way round, so only one order of each pair needs writing
+	template<ContactGeometryFunction Function>
+	static void Flipped(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact)
+	{
+		Function(B, A, Shapes, OutContact);
+		BeginContact(A, B, OutContact);
+		OutContact.Normal = Vector4(0.0f) - OutContact.Normal;
+	}
+
+	const ContactGeometryFunction ContactGeometryTable[ShapeTypeCount][ShapeTypeCount] =
+	{
+		//sphere
+		{ SphereSphere, SphereCapsule, SphereBox, SpherePlane, SphereMesh },
+		//capsule
+		{ Flipped<SphereCapsule>, CapsuleCapsule, CapsuleBox, CapsulePlane, nullptr },
+		//box
+		{ Flipped<SphereBox>, Flipped<CapsuleBox>, BoxBox, BoxPlane, nullptr },
+		//plane
+		{ Flipped<SpherePlane>, Flipped<CapsulePlane>, Flipped<BoxPlane>, nullptr, nullptr },
+		//mesh
+		{ Flipped<SphereMesh>, nullptr, nullptr, nullptr, nullptr },
+	};
+}
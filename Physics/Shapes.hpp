@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Types.hpp"
+#include "StaticMesh.hpp"
+
+namespace Physics
+{
+	//Per-type shape parameters, indexed by PhysicsObject::ShapeIndex. Spheres only need CollisionRadius, so they have no bucket.
+	//There's no angular motion, so orientations are fixed when the object is added.
+
+	struct CapsuleShape
+	{
+		Core::Vector4 Axis; //unit direction of the segment
+		float HalfHeight; //half the segment length, not counting the caps
+		float Radius;
+	};
+
+	struct BoxShape
+	{
+		Core::Vector4 Axes[3]; //unit, orthogonal
+		Core::Vector4 HalfExtents;
+	};
+
+	//static, infinite - points with Normal . x == Distance are on the plane, the positive side is outside
+	struct PlaneShape
+	{
+		Core::Vector4 Normal;
+		float Distance;
+	};
+
+	struct ShapeData
+	{
+		simd_vector<CapsuleShape> Capsules;
+		simd_vector<BoxShape> Boxes;
+		simd_vector<PlaneShape> Planes;
+		simd_vector<StaticMesh> Meshes;
+
+		//object index using each bucket entry, per shape type (empty for spheres)
+		std::vector<size_t> Owners[ShapeTypeCount];
+
+		//move Source's entry to the end of this bucket, returning its new shape index
+		size_t Append(ShapeType Type, ShapeData& Source, size_t SourceIndex, size_t Owner);
+
+		//swap-and-pop the entry, returning the object whose entry moved into ShapeIndex (InvalidObjectIndex if it was the last)
+		size_t Remove(ShapeType Type, size_t ShapeIndex);
+
+		void Clear();
+
+		//objects have moved to NewIndices[old index] - a permutation, nothing removed
+		void RemapOwners(const std::vector<size_t>& NewIndices);
+
+		//load into empty buckets - false if the sections are missing or don't agree with each other
+		void SaveSnapshot(SnapshotWriter& Writer) const;
+		bool LoadSnapshot(const SnapshotReader& Reader);
+	};
+
+	Core::Vector4 ClosestPointOnSegment(const Core::Vector4& Point, const Core::Vector4& Start, const Core::Vector4& End);
+	//Center is the box object's position
+	Core::Vector4 ClosestPointOnBox(const Core::Vector4& Point, const Core::Vector4& Center, const BoxShape& Box);
+
+	//Fills in the contact's indices, normal (from B to A), penetration (negative if separated) and relative position.
+	typedef void (*ContactGeometryFunction)(const PhysicsObject& A, const PhysicsObject& B, const ShapeData& Shapes, Contact& OutContact);
+
+	//[shape of A][shape of B], null for pairs that never meet - world shapes against each other, and meshes against anything but spheres
+	extern const ContactGeometryFunction ContactGeometryTable[ShapeTypeCount][ShapeTypeCount];
+
+	//sort key for grouping pairs with the same test
+	inline size_t ShapePairKey(ShapeType A, ShapeType B)
+	{
+		return static_cast<size_t>(A) * ShapeTypeCount + static_cast<size_t>(B);
+	}
+}
@@ -0,0 +1,229 @@
+#include "SleepManager.hpp"
+
+#include <algorithm>
+
+using namespace Core;
+namespace Physics
+{
+	SleepSettings::SleepSettings() :
+		bEnabled(true),
+		SleepSpeedThreshold(0.05f),
+		TimeToSleep(0.5f)
+	{}
+
+	//island key and how many of the members that follow in the snapshot are its
+	struct SavedIsland
+	{
+		size_t Key;
+		size_t NumMembers;
+	};
+
+	SleepManager::SleepManager()
+	{}
+
+	void SleepManager::UpdateSleepTimer(PhysicsObject& Object, float DeltaTime) const
+	{
+		if (Object.Velocity.length3Squared() < Settings.SleepSpeedThreshold * Settings.SleepSpeedThreshold)
+		{
+			Object.SleepTimer += DeltaTime;
+		}
+		else
+		{
+			Object.SleepTimer = 0.0f;
+		}
+	}
+
+	void SleepManager::WakeTouched(const CollisionPairList& CollisionPairs, simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects)
+	{
+		//pairs come from awake objects' queries, so any sleeper in a pair was touched by something awake
+		for (auto& pair : CollisionPairs)
+		{
+			Wake(pair.first->Index, Objects, AwakeObjects);
+			Wake(pair.second->Index, Objects, AwakeObjects);
+		}
+	}
+
+	void SleepManager::Wake(size_t Index, simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects)
+	{
+		PhysicsObject& object = Objects[Index];
+
+		//immovable objects sleep permanently, they never need integrating
+		if (!object.bAsleep || object.InverseMass == 0.0f)
+		{
+			return;
+		}
+
+		auto island = SleepingIslands.find(object.SleepIsland);
+		if (island == SleepingIslands.end())
+		{
+			return;
+		}
+
+		for (size_t member : island->second)
+		{
+			Objects[member].bAsleep = false;
+			Objects[member].SleepTimer = 0.0f;
+			AwakeObjects.push_back(member);
+		}
+
+		SleepingIslands.erase(island);
+	}
+
+	void SleepManager::WakeAll(simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects)
+	{
+		for (auto& island : SleepingIslands)
+		{
+			for (size_t member : island.second)
+			{
+				Objects[member].bAsleep = false;
+				Objects[member].SleepTimer = 0.0f;
+				AwakeObjects.push_back(member);
+			}
+		}
+		SleepingIslands.clear();
+	}
+
+	void SleepManager::Remap(const std::vector<size_t>& NewIndices, simd_vector<PhysicsObject>& Objects)
+	{
+		std::unordered_map<size_t, std::vector<size_t>> remappedIslands;
+		for (auto& island : SleepingIslands)
+		{
+			std::vector<size_t> members;
+			members.reserve(island.second.size());
+			for (size_t member : island.second)
+			{
+				if (NewIndices[member] != InvalidObjectIndex)
+				{
+					members.push_back(NewIndices[member]);
+				}
+			}
+
+			if (members.empty())
+			{
+				continue;
+			}
+
+			//keyed by one of its own (sleeping) members, so it can't clash with a root from the awake objects
+			const size_t key = members.front();
+			for (size_t member : members)
+			{
+				Objects[member].SleepIsland = key;
+			}
+			remappedIslands[key] = std::move(members);
+		}
+		SleepingIslands = std::move(remappedIslands);
+	}
+
+	void SleepManager::Update(const simd_vector<Contact>& Contacts, simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects)
+	{
+		if (!Settings.bEnabled)
+		{
+			return;
+		}
+
+		IslandParents.resize(Objects.size());
+		IslandCanSleep.resize(Objects.size());
+		for (size_t index : AwakeObjects)
+		{
+			IslandParents[index] = index;
+			IslandCanSleep[index] = true;
+		}
+
+		//immovable objects don't join islands, otherwise everything resting on the ground would be one island
+		for (auto& contact : Contacts)
+		{
+			if (Objects[contact.IndexA].InverseMass == 0.0f || Objects[contact.IndexB].InverseMass == 0.0f)
+			{
+				continue;
+			}
+
+			size_t islandA = FindIsland(contact.IndexA);
+			size_t islandB = FindIsland(contact.IndexB);
+			if (islandA != islandB)
+			{
+				IslandParents[std::max(islandA, islandB)] = std::min(islandA, islandB);
+			}
+		}
+
+		//one restless member keeps the whole island awake
+		for (size_t index : AwakeObjects)
+		{
+			if (Objects[index].SleepTimer < Settings.TimeToSleep)
+			{
+				IslandCanSleep[FindIsland(index)] = false;
+			}
+		}
+
+		for (size_t index : AwakeObjects)
+		{
+			const size_t island = FindIsland(index);
+			if (IslandCanSleep[island])
+			{
+				PhysicsObject& object = Objects[index];
+				object.bAsleep = true;
+				object.Velocity = Vector4(0.0f);
+				object.SleepIsland = island;
+				SleepingIslands[island].push_back(index);
+			}
+		}
+
+		AwakeObjects.erase(std::remove_if(AwakeObjects.begin(), AwakeObjects.end(), [&](size_t index) { return Objects[index].bAsleep; }), AwakeObjects.end());
+	}
+
+	size_t SleepManager::FindIsland(size_t Index)
+	{
+		//path halving keeps the trees flat without recursion
+		while (IslandParents[Index] != Index)
+		{
+			IslandParents[Index] = IslandParents[IslandParents[Index]];
+			Index = IslandParents[Index];
+		}
+		return Index;
+	}
+
+	void SleepManager::SaveSnapshot(SnapshotWriter& Writer) const
+	{
+		std::vector<SavedIsland> islands;
+		std::vector<size_t> members;
+		islands.reserve(SleepingIslands.size());
+		for (auto& island : SleepingIslands)
+		{
+			islands.push_back(SavedIsland{ island.first, island.second.size() });
+			members.insert(members.end(), island.second.begin(), island.second.end());
+		}
+
+		Writer.Write(SnapshotSection::SleepingIslands, 0, islands);
+		Writer.Write(SnapshotSection::SleepingIslandMembers, 0, members);
+	}
+
+	bool SleepManager::LoadSnapshot(const SnapshotReader& Reader, size_t NumObjects)
+	{
+		const SavedIsland* islands;
+		size_t numIslands;
+		const size_t* members;
+		size_t numMembers;
+		if (!Reader.Find(SnapshotSection::SleepingIslands, 0, islands, numIslands) || !Reader.Find(SnapshotSection::SleepingIslandMembers, 0, members, numMembers))
+		{
+			return false;
+		}
+
+		size_t next = 0;
+		for (size_t i = 0; i < numIslands; ++i)
+		{
+			if (islands[i].NumMembers > numMembers - next)
+			{
+				return false;
+			}
+
+			std::vector<size_t>& island = SleepingIslands[islands[i].Key];
+			island.assign(members + next, members + next + islands[i].NumMembers);
+			next += islands[i].NumMembers;
+
+			if (std::any_of(island.begin(), island.end(), [NumObjects](size_t member) { return member >= NumObjects; }))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
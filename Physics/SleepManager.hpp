@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "Types.hpp"
+#include "Snapshot.hpp"
+
+namespace Physics
+{
+	struct SleepSettings
+	{
+		SleepSettings();
+
+		bool bEnabled;
+		//objects slower than this count as resting
+		float SleepSpeedThreshold;
+		//seconds every object in an island has to be resting before the island goes to sleep
+		float TimeToSleep;
+	};
+
+	//puts resting islands of objects to sleep and wakes them when something awake touches them
+	class SleepManager
+	{
+	public:
+		SleepManager();
+
+		//called per object from the integration workers once the new velocity is known
+		void UpdateSleepTimer(PhysicsObject& Object, float DeltaTime) const;
+
+		//wake every sleeping island touched by an awake object this frame, adding its members to AwakeObjects
+		void WakeTouched(const CollisionPairList& CollisionPairs, simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects);
+
+		//wake a single object (and the rest of its island)
+		void Wake(size_t Index, simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects);
+
+		//wake every sleeping island, for when something they might rest on goes away
+		void WakeAll(simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects);
+
+		//objects have moved to NewIndices[old index] (or been removed if InvalidObjectIndex) - Objects is already in the new order
+		void Remap(const std::vector<size_t>& NewIndices, simd_vector<PhysicsObject>& Objects);
+
+		//the sleeping islands - load into a manager with none, false if the sections are missing or name objects past NumObjects
+		void SaveSnapshot(SnapshotWriter& Writer) const;
+		bool LoadSnapshot(const SnapshotReader& Reader, size_t NumObjects);
+
+		//group awake objects into islands through the contact graph and put to sleep any island that's been resting long enough
+		void Update(const simd_vector<Contact>& Contacts, simd_vector<PhysicsObject>& Objects, std::vector<size_t>& AwakeObjects);
+
+		SleepSettings Settings;
+
+	private:
+
+		size_t FindIsland(size_t Index);
+
+		//union-find over object indices, only valid for the awake objects during Update
+		std::vector<size_t> IslandParents;
+		std::vector<char> IslandCanSleep;
+
+		//members of each sleeping island, keyed by the island's root object index
+		std::unordered_map<size_t, std::vector<size_t>> SleepingIslands;
+	};
+}
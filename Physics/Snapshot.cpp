@@ -0,0 +1,119 @@
+#include "Snapshot.hpp"
+
+#include <cstring>
+
+namespace Physics
+{
+	static const char SnapshotMagic[8] = { 'P', 'H', 'Y', 'S', 'S', 'N', 'A', 'P' };
+
+	SnapshotWriter::SnapshotWriter() :
+		Offset(0)
+	{}
+
+	bool SnapshotWriter::Open(const std::string& Path)
+	{
+		File.open(Path, std::ios::binary | std::ios::trunc);
+		if (!File)
+		{
+			return false;
+		}
+
+		//placeholder until Finish knows where the section table ends up
+		const SnapshotHeader header = {};
+		File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		Offset = sizeof(header);
+		Sections.clear();
+		return static_cast<bool>(File);
+	}
+
+	void SnapshotWriter::WriteSection(SnapshotSection Section, uint32_t Instance, const void* Data, size_t ElementSize, size_t Count)
+	{
+		const uint64_t start = Pad();
+		File.write(static_cast<const char*>(Data), static_cast<std::streamsize>(ElementSize * Count));
+
+		Sections.push_back(SnapshotSectionEntry{ static_cast<uint32_t>(Section), Instance, ElementSize, start, Count });
+		Offset = start + ElementSize * Count;
+	}
+
+	uint64_t SnapshotWriter::Pad()
+	{
+		static const char padding[SnapshotAlignment] = {};
+		const uint64_t aligned = (Offset + SnapshotAlignment - 1) & ~(SnapshotAlignment - 1);
+		File.write(padding, static_cast<std::streamsize>(aligned - Offset));
+		Offset = aligned;
+		return aligned;
+	}
+
+	bool SnapshotWriter::Finish()
+	{
+		SnapshotHeader header;
+		std::memcpy(header.Magic, SnapshotMagic, sizeof(SnapshotMagic));
+		header.Version = SnapshotVersion;
+		header.PointerSize = sizeof(void*);
+		header.SectionTableOffset = Pad();
+		header.NumSections = Sections.size();
+
+		File.write(reinterpret_cast<const char*>(Sections.data()), static_cast<std::streamsize>(Sections.size() * sizeof(SnapshotSectionEntry)));
+
+		File.seekp(0);
+		File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		File.close();
+		return !File.fail();
+	}
+
+	SnapshotReader::SnapshotReader() :
+		Sections(nullptr),
+		NumSections(0)
+	{}
+
+	bool SnapshotReader::Open(const std::string& Path)
+	{
+		Sections = nullptr;
+		NumSections = 0;
+		if (!File.Open(Path) || File.GetSize() < sizeof(SnapshotHeader))
+		{
+			return false;
+		}
+
+		const uint64_t size = File.GetSize();
+		const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(File.GetData());
+		if (std::memcmp(header.Magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 || header.Version != SnapshotVersion || header.PointerSize != sizeof(void*))
+		{
+			return false;
+		}
+
+		if (header.SectionTableOffset % SnapshotAlignment != 0 || header.SectionTableOffset > size ||
+			header.NumSections > (size - header.SectionTableOffset) / sizeof(SnapshotSectionEntry))
+		{
+			return false;
+		}
+
+		const SnapshotSectionEntry* sections = reinterpret_cast<const SnapshotSectionEntry*>(File.GetData() + header.SectionTableOffset);
+		for (uint64_t i = 0; i < header.NumSections; ++i)
+		{
+			//written this way round so a corrupt count can't overflow past the check
+			const SnapshotSectionEntry& entry = sections[i];
+			if (entry.ElementSize == 0 || entry.Offset % SnapshotAlignment != 0 || entry.Offset > header.SectionTableOffset ||
+				entry.Count > (header.SectionTableOffset - entry.Offset) / entry.ElementSize)
+			{
+				return false;
+			}
+		}
+
+		Sections = sections;
+		NumSections = static_cast<size_t>(header.NumSections);
+		return true;
+	}
+
+	const SnapshotSectionEntry* SnapshotReader::FindEntry(SnapshotSection Section, uint32_t Instance) const
+	{
+		for (size_t i = 0; i < NumSections; ++i)
+		{
+			if (Sections[i].Section == static_cast<uint32_t>(Section) && Sections[i].Instance == Instance)
+			{
+				return &Sections[i];
+			}
+		}
+		return nullptr;
+	}
+}
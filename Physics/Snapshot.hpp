@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+#include "../Core/MappedFile.hpp"
+#include "Types.hpp"
+
+namespace Physics
+{
+	//Sections of a snapshot file - new ones go at the end, anything else bumps SnapshotVersion.
+	enum class SnapshotSection : uint32_t
+	{
+		Objects,
+		AwakeObjects,
+		Capsules,
+		Boxes,
+		Planes,
+		ShapeOwners, //one per shape type, the instance is the type
+		MeshInfo, //one per mesh for this and the next two, the instance is the mesh's shape index
+		MeshNodes,
+		MeshTriangles,
+		HandleSlots,
+		FreeHandleSlots,
+		DenseHandleSlots,
+		Contacts,
+		ContactFrame,
+		SleepingIslands,
+		SleepingIslandMembers,
+		FrameNumber
+	};
+
+	const uint32_t SnapshotVersion = 1;
+
+	//every section starts on a cache line, which covers the alignment of anything stored in them
+	const uint64_t SnapshotAlignment = 64;
+
+	struct SnapshotHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t PointerSize;
+		uint64_t SectionTableOffset;
+		uint64_t NumSections;
+	};
+
+	struct SnapshotSectionEntry
+	{
+		uint32_t Section;
+		uint32_t Instance;
+		uint64_t ElementSize;
+		uint64_t Offset;
+		uint64_t Count;
+	};
+
+	//Writes a snapshot straight to disk one section at a time, with the section table at the end.
+	//Sections are raw arrays in the writing build's memory layout - snapshots are for restarting the same build, not an exchange format.
+	class SnapshotWriter
+	{
+	public:
+		SnapshotWriter();
+
+		bool Open(const std::string& Path);
+
+		template<typename T>
+		void Write(SnapshotSection Section, uint32_t Instance, const T* Data, size_t Count)
+		{
+			WriteSection(Section, Instance, Data, sizeof(T), Count);
+		}
+
+		template<typename T, typename Allocator>
+		void Write(SnapshotSection Section, uint32_t Instance, const std::vector<T, Allocator>& Data)
+		{
+			Write(Section, Instance, Data.data(), Data.size());
+		}
+
+		//writes the section table and header and closes the file, false if anything along the way failed
+		bool Finish();
+
+	private:
+
+		void WriteSection(SnapshotSection Section, uint32_t Instance, const void* Data, size_t ElementSize, size_t Count);
+
+		//zero fill up to the next SnapshotAlignment boundary, returning the new offset
+		uint64_t Pad();
+
+		std::ofstream File;
+		uint64_t Offset;
+		std::vector<SnapshotSectionEntry> Sections;
+	};
+
+	//Maps a snapshot and hands out its sections in place - reading one is a single bulk copy out of the mapping, nothing is parsed.
+	class SnapshotReader
+	{
+	public:
+		SnapshotReader();
+
+		//false if the file can't be mapped, isn't a snapshot from this version and build, or its sections don't fit in it
+		bool Open(const std::string& Path);
+
+		//false if the section is missing or doesn't hold Ts
+		template<typename T>
+		bool Find(SnapshotSection Section, uint32_t Instance, const T*& OutData, size_t& OutCount) const
+		{
+			const SnapshotSectionEntry* entry = FindEntry(Section, Instance);
+			if (!entry || entry->ElementSize != sizeof(T))
+			{
+				return false;
+			}
+
+			OutData = reinterpret_cast<const T*>(File.GetData() + entry->Offset);
+			OutCount = static_cast<size_t>(entry->Count);
+			return true;
+		}
+
+		template<typename T, typename Allocator>
+		bool Read(SnapshotSection Section, uint32_t Instance, std::vector<T, Allocator>& Out) const
+		{
+			const T* data;
+			size_t count;
+			if (!Find(Section, Instance, data, count))
+			{
+				return false;
+			}
+
+			Out.assign(data, data + count);
+			return true;
+		}
+
+	private:
+
+		const SnapshotSectionEntry* FindEntry(SnapshotSection Section, uint32_t Instance) const;
+
+		Core::MappedFile File;
+		const SnapshotSectionEntry* Sections;
+		size_t NumSections;
+	};
+}
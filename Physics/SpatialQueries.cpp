@@ -0,0 +1,652 @@
+#include "SpatialQueries.hpp"
+#include "PhysicsManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Core;
+namespace Physics
+{
+	static const size_t MaxLeafObjects = 8;
+
+	//rays traced through the tree together - one bit each in the active mask
+	static const size_t RayPacketSize = 8;
+
+	//queries per job
+	static const size_t RaycastBatchSize = 64;
+	static const size_t OverlapBatchSize = 32;
+	static const size_t NearestBatchSize = 32;
+
+	//the tree is a median split, so this covers far more objects than fit in memory
+	static const int MaxTraversalDepth = 64;
+
+	static bool RayHitsSphere(const Vector4& Origin, const Vector4& Direction, const Vector4& Center, float Radius, float MaxDistance, float& OutDistance, Vector4& OutNormal)
+	{
+		const Vector4 offset = Origin - Center;
+		const float along = offset.dot3(Direction);
+		const float distanceSquared = offset.length3Squared() - Radius * Radius;
+		if (distanceSquared <= 0.0f)
+		{
+			OutDistance = 0.0f;
+			OutNormal = Direction * -1.0f;
+			return true;
+		}
+
+		const float discriminant = along * along - distanceSquared;
+		if (along > 0.0f || discriminant < 0.0f)
+		{
+			return false;
+		}
+
+		OutDistance = -along - std::sqrt(discriminant);
+		if (OutDistance > MaxDistance)
+		{
+			return false;
+		}
+		OutNormal = (offset + Direction * OutDistance) / Radius;
+		return true;
+	}
+
+	//the two cap spheres and the side of the cylinder between them
+	static bool RayHitsCapsule(const Vector4& Origin, const Vector4& Direction, const Vector4& Center, const CapsuleShape& Capsule, float MaxDistance, float& OutDistance, Vector4& OutNormal)
+	{
+		const Vector4 start = Center - Capsule.Axis * Capsule.HalfHeight;
+		const Vector4 end = Center + Capsule.Axis * Capsule.HalfHeight;
+		if ((Origin - ClosestPointOnSegment(Origin, start, end)).length3Squared() <= Capsule.Radius * Capsule.Radius)
+		{
+			OutDistance = 0.0f;
+			OutNormal = Direction * -1.0f;
+			return true;
+		}
+
+		bool bHit = false;
+		float distance;
+		Vector4 normal;
+		for (const Vector4& cap : { start, end })
+		{
+			if (RayHitsSphere(Origin, Direction, cap, Capsule.Radius, MaxDistance, distance, normal))
+			{
+				bHit = true;
+				MaxDistance = distance;
+				OutDistance = distance;
+				OutNormal = normal;
+			}
+		}
+
+		//infinite cylinder around the axis, only counted between the caps
+		const Vector4 offset = Origin - Center;
+		const float offsetAlong = offset.dot3(Capsule.Axis);
+		const float directionAlong = Direction.dot3(Capsule.Axis);
+		const Vector4 offsetAcross = offset - Capsule.Axis * offsetAlong;
+		const Vector4 directionAcross = Direction - Capsule.Axis * directionAlong;
+		const float a = directionAcross.length3Squared();
+		if (a > 1e-12f)
+		{
+			const float b = offsetAcross.dot3(directionAcross);
+			const float c = offsetAcross.length3Squared() - Capsule.Radius * Capsule.Radius;
+			const float discriminant = b * b - a * c;
+			if (discriminant >= 0.0f)
+			{
+				distance = (-b - std::sqrt(discriminant)) / a;
+				if (distance >= 0.0f && distance <= MaxDistance && std::abs(offsetAlong + directionAlong * distance) <= Capsule.HalfHeight)
+				{
+					bHit = true;
+					OutDistance = distance;
+					OutNormal = (offsetAcross + directionAcross * distance) / Capsule.Radius;
+				}
+			}
+		}
+		return bHit;
+	}
+
+	//slabs in the box's own axes, the normal is the face of the last slab entered
+	static bool RayHitsBox(const Vector4& Origin, const Vector4& Direction, const Vector4& Center, const BoxShape& Box, float MaxDistance, float& OutDistance, Vector4& OutNormal)
+	{
+		const Vector4 offset = Origin - Center;
+		float entry = 0.0f;
+		float exit = MaxDistance;
+		int entryAxis = -1;
+		float entrySign = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float start = offset.dot3(Box.Axes[axis]);
+			const float direction = Direction.dot3(Box.Axes[axis]);
+			const float extent = Box.HalfExtents[axis];
+			if (std::abs(direction) < 1e-12f)
+			{
+				if (std::abs(start) > extent)
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float slabEntry = (-extent - start) / direction;
+			float slabExit = (extent - start) / direction;
+			float sign = -1.0f;
+			if (slabEntry > slabExit)
+			{
+				std::swap(slabEntry, slabExit);
+				sign = 1.0f;
+			}
+
+			if (slabEntry > entry)
+			{
+				entry = slabEntry;
+				entryAxis = axis;
+				entrySign = sign;
+			}
+			exit = std::min(exit, slabExit);
+			if (entry > exit)
+			{
+				return false;
+			}
+		}
+
+		OutDistance = entry;
+		OutNormal = entryAxis < 0 ? Direction * -1.0f : Box.Axes[entryAxis] * entrySign;
+		return true;
+	}
+
+	//behind the plane counts as inside it
+	static bool RayHitsPlane(const Vector4& Origin, const Vector4& Direction, const PlaneShape& Plane, float MaxDistance, float& OutDistance, Vector4& OutNormal)
+	{
+		const float height = Plane.Normal.dot3(Origin) - Plane.Distance;
+		if (height <= 0.0f)
+		{
+			OutDistance = 0.0f;
+			OutNormal = Direction * -1.0f;
+			return true;
+		}
+
+		const float approach = Plane.Normal.dot3(Direction);
+		if (approach >= 0.0f)
+		{
+			return false;
+		}
+
+		OutDistance = -height / approach;
+		OutNormal = Plane.Normal;
+		return OutDistance <= MaxDistance;
+	}
+
+	static bool RayHitsObject(const RayQuery& Ray, const PhysicsObject& Object, const ShapeData& Shapes, float MaxDistance, float& OutDistance, Vector4& OutNormal)
+	{
+		switch (Object.Shape)
+		{
+		case ShapeType::Sphere:
+			return RayHitsSphere(Ray.Origin, Ray.Direction, Object.Position, Object.CollisionRadius, MaxDistance, OutDistance, OutNormal);
+		case ShapeType::Capsule:
+			return RayHitsCapsule(Ray.Origin, Ray.Direction, Object.Position, Shapes.Capsules[Object.ShapeIndex], MaxDistance, OutDistance, OutNormal);
+		case ShapeType::Box:
+			return RayHitsBox(Ray.Origin, Ray.Direction, Object.Position, Shapes.Boxes[Object.ShapeIndex], MaxDistance, OutDistance, OutNormal);
+		case ShapeType::Plane:
+			return RayHitsPlane(Ray.Origin, Ray.Direction, Shapes.Planes[Object.ShapeIndex], MaxDistance, OutDistance, OutNormal);
+		case ShapeType::Mesh:
+			return Shapes.Meshes[Object.ShapeIndex].Raycast(Ray.Origin, Ray.Direction, MaxDistance, OutDistance, OutNormal);
+		}
+		return false;
+	}
+
+	static bool SphereTouchesObject(const SphereQuery& Sphere, const PhysicsObject& Object, const ShapeData& Shapes)
+	{
+		switch (Object.Shape)
+		{
+		case ShapeType::Sphere:
+		{
+			const float reach = Sphere.Radius + Object.CollisionRadius;
+			return (Sphere.Center - Object.Position).length3Squared() <= reach * reach;
+		}
+		case ShapeType::Capsule:
+		{
+			const CapsuleShape& capsule = Shapes.Capsules[Object.ShapeIndex];
+			const Vector4 closest = ClosestPointOnSegment(Sphere.Center, Object.Position - capsule.Axis * capsule.HalfHeight, Object.Position + capsule.Axis * capsule.HalfHeight);
+			const float reach = Sphere.Radius + capsule.Radius;
+			return (Sphere.Center - closest).length3Squared() <= reach * reach;
+		}
+		case ShapeType::Box:
+		{
+			const Vector4 closest = ClosestPointOnBox(Sphere.Center, Object.Position, Shapes.Boxes[Object.ShapeIndex]);
+			return (Sphere.Center - closest).length3Squared() <= Sphere.Radius * Sphere.Radius;
+		}
+		case ShapeType::Plane:
+		{
+			const PlaneShape& plane = Shapes.Planes[Object.ShapeIndex];
+			return plane.Normal.dot3(Sphere.Center) - plane.Distance <= Sphere.Radius;
+		}
+		case ShapeType::Mesh:
+		{
+			Vector4 normal;
+			float penetration;
+			return Shapes.Meshes[Object.ShapeIndex].GetDeepestContact(Sphere.Center, Sphere.Radius, normal, penetration);
+		}
+		}
+		return false;
+	}
+
+	static float DistanceToBox(const Vector4& Point, const BoundingBox& Box)
+	{
+		float distanceSquared = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float outside = std::max(std::max(Box.Min[axis] - Point[axis], Point[axis] - Box.Max[axis]), 0.0f);
+			distanceSquared += outside * outside;
+		}
+		return std::sqrt(distanceSquared);
+	}
+
+	QueryScene::QueryScene(unsigned int NumThreads) :
+		CurrentBatches(&Batches),
+		CurrentRays(nullptr),
+		CurrentRayHits(nullptr),
+		CurrentSpheres(nullptr),
+		CurrentOverlapOffsets(nullptr),
+		CurrentNearestQueries(nullptr),
+		CurrentK(0),
+		CurrentNearestHits(nullptr),
+		Kind(QueryKind::Raycast),
+		CurrentKind(&Kind),
+		QueryJob(NumThreads, &CurrentBatches, &CurrentKind, this)
+	{}
+
+	void QueryScene::Update(PhysicsManager& Manager)
+	{
+		QueryMutex.lock();
+		Manager.CopyQueryState(Objects, Handles, Shapes);
+
+		WorldObjects.clear();
+		LeafObjects.clear();
+		for (size_t index = 0; index < Objects.size(); ++index)
+		{
+			if (IsWorldShape(Objects[index].Shape))
+			{
+				WorldObjects.push_back(index);
+			}
+			else
+			{
+				LeafObjects.push_back(static_cast<uint32_t>(index));
+			}
+		}
+
+		Nodes.clear();
+		if (!LeafObjects.empty())
+		{
+			BuildNode(0, LeafObjects.size());
+		}
+		QueryMutex.unlock();
+	}
+
+	size_t QueryScene::GetNumObjects() const
+	{
+		return Objects.size();
+	}
+
+	uint32_t QueryScene::BuildNode(size_t Begin, size_t End)
+	{
+		const uint32_t nodeIndex = static_cast<uint32_t>(Nodes.size());
+		Nodes.push_back(QueryNode());
+
+		QueryNode node;
+		node.Bounds = BoundingBox(Vector4(std::numeric_limits<float>::max()), Vector4(-std::numeric_limits<float>::max()));
+		BoundingBox centerBounds = node.Bounds;
+		for (size_t i = Begin; i < End; ++i)
+		{
+			const PhysicsObject& object = Objects[LeafObjects[i]];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				node.Bounds.Min[axis] = std::min(node.Bounds.Min[axis], object.Position[axis] - object.CollisionRadius);
+				node.Bounds.Max[axis] = std::max(node.Bounds.Max[axis], object.Position[axis] + object.CollisionRadius);
+				centerBounds.Min[axis] = std::min(centerBounds.Min[axis], object.Position[axis]);
+				centerBounds.Max[axis] = std::max(centerBounds.Max[axis], object.Position[axis]);
+			}
+		}
+		node.FirstObject = static_cast<uint32_t>(Begin);
+		node.RightChild = 0;
+		node.SplitAxis = 0;
+
+		if (End - Begin <= MaxLeafObjects)
+		{
+			node.NumObjects = static_cast<uint32_t>(End - Begin);
+			Nodes[nodeIndex] = node;
+			return nodeIndex;
+		}
+
+		//median split along the longest axis of the centers
+		for (uint32_t axis = 1; axis < 3; ++axis)
+		{
+			if (centerBounds.Max[axis] - centerBounds.Min[axis] > centerBounds.Max[node.SplitAxis] - centerBounds.Min[node.SplitAxis])
+			{
+				node.SplitAxis = axis;
+			}
+		}
+
+		const size_t middle = Begin + (End - Begin) / 2;
+		const uint32_t splitAxis = node.SplitAxis;
+		std::nth_element(LeafObjects.begin() + Begin, LeafObjects.begin() + middle, LeafObjects.begin() + End,
+			[&](uint32_t a, uint32_t b) { return Objects[a].Position[splitAxis] < Objects[b].Position[splitAxis]; });
+
+		node.NumObjects = 0;
+		BuildNode(Begin, middle);
+		node.RightChild = BuildNode(middle, End);
+		Nodes[nodeIndex] = node;
+		return nodeIndex;
+	}
+
+	void QueryScene::MakeBatches(size_t NumQueries, size_t BatchSize)
+	{
+		Batches.clear();
+		for (size_t begin = 0; begin < NumQueries; begin += BatchSize)
+		{
+			Batches.push_back(BatchRange{ begin, std::min(begin + BatchSize, NumQueries) });
+		}
+	}
+
+	void QueryScene::TraceRayPacket(const RayQuery* Rays, size_t NumRays, RayHit* OutHits) const
+	{
+		Vector4 inverseDirections[RayPacketSize];
+		for (size_t ray = 0; ray < NumRays; ++ray)
+		{
+			OutHits[ray] = RayHit{ Vector4(0.0f), InvalidObjectHandle, Rays[ray].MaxDistance, false };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				inverseDirections[ray][axis] = 1.0f / Rays[ray].Direction[axis];
+			}
+		}
+
+		//the closest hit so far is the ray's new length, so everything further away gets culled
+		auto testObject = [&](size_t Ray, size_t ObjectIndex)
+		{
+			float distance;
+			Vector4 normal;
+			if (RayHitsObject(Rays[Ray], Objects[ObjectIndex], Shapes, OutHits[Ray].Distance, distance, normal))
+			{
+				OutHits[Ray].Normal = normal;
+				OutHits[Ray].Handle = Handles[ObjectIndex];
+				OutHits[Ray].Distance = distance;
+				OutHits[Ray].bHit = true;
+			}
+		};
+
+		for (size_t object : WorldObjects)
+		{
+			for (size_t ray = 0; ray < NumRays; ++ray)
+			{
+				testObject(ray, object);
+			}
+		}
+
+		if (Nodes.empty())
+		{
+			return;
+		}
+
+		uint32_t stack[MaxTraversalDepth];
+		int stackSize = 0;
+		uint32_t nodeIndex = 0;
+		while (true)
+		{
+			//the whole packet visits a node if any of its rays reach it, but only those rays are tested in the leaves
+			const QueryNode& node = Nodes[nodeIndex];
+			uint32_t activeRays = 0;
+			for (size_t ray = 0; ray < NumRays; ++ray)
+			{
+				if (node.Bounds.IntersectsRay(Rays[ray].Origin, inverseDirections[ray], OutHits[ray].Distance))
+				{
+					activeRays |= 1u << ray;
+				}
+			}
+
+			if (activeRays != 0)
+			{
+				if (node.NumObjects == 0)
+				{
+					//nearer child first for the first active ray - in a coherent packet the rest mostly agree
+					size_t leadRay = 0;
+					while ((activeRays & (1u << leadRay)) == 0)
+					{
+						++leadRay;
+					}
+					const bool bRightFirst = Rays[leadRay].Direction[node.SplitAxis] < 0.0f;
+					stack[stackSize++] = bRightFirst ? nodeIndex + 1 : node.RightChild;
+					nodeIndex = bRightFirst ? node.RightChild : nodeIndex + 1;
+					continue;
+				}
+
+				for (uint32_t leafObject = node.FirstObject; leafObject < node.FirstObject + node.NumObjects; ++leafObject)
+				{
+					for (size_t ray = 0; ray < NumRays; ++ray)
+					{
+						if (activeRays & (1u << ray))
+						{
+							testObject(ray, LeafObjects[leafObject]);
+						}
+					}
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return;
+			}
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	void QueryScene::OverlapSphere(const SphereQuery& Query, std::vector<ObjectHandle>& OutObjects) const
+	{
+		for (size_t object : WorldObjects)
+		{
+			if (SphereTouchesObject(Query, Objects[object], Shapes))
+			{
+				OutObjects.push_back(Handles[object]);
+			}
+		}
+
+		if (Nodes.empty())
+		{
+			return;
+		}
+
+		const BoundingBox queryBounds(Query.Center - Vector4(Query.Radius), Query.Center + Vector4(Query.Radius));
+		uint32_t stack[MaxTraversalDepth];
+		int stackSize = 0;
+		uint32_t nodeIndex = 0;
+		while (true)
+		{
+			const QueryNode& node = Nodes[nodeIndex];
+			if (node.Bounds.Intersects(queryBounds))
+			{
+				if (node.NumObjects == 0)
+				{
+					stack[stackSize++] = node.RightChild;
+					nodeIndex = nodeIndex + 1;
+					continue;
+				}
+
+				for (uint32_t leafObject = node.FirstObject; leafObject < node.FirstObject + node.NumObjects; ++leafObject)
+				{
+					const uint32_t object = LeafObjects[leafObject];
+					if (SphereTouchesObject(Query, Objects[object], Shapes))
+					{
+						OutObjects.push_back(Handles[object]);
+					}
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return;
+			}
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	void QueryScene::FindNearestTo(const NearestQuery& Query, size_t K, NearestHit* OutHits) const
+	{
+		if (Nodes.empty())
+		{
+			return;
+		}
+
+		//OutHits is kept sorted - until it's full anything within range goes in, after that only what beats the furthest
+		size_t numFound = 0;
+		auto limit = [&]()
+		{
+			return numFound < K ? Query.MaxDistance : OutHits[K - 1].Distance;
+		};
+
+		uint32_t stack[MaxTraversalDepth];
+		int stackSize = 0;
+		uint32_t nodeIndex = 0;
+		while (true)
+		{
+			const QueryNode& node = Nodes[nodeIndex];
+			if (DistanceToBox(Query.Point, node.Bounds) <= limit())
+			{
+				if (node.NumObjects == 0)
+				{
+					//nearer child first, so the limit tightens before the other one is looked at
+					const uint32_t left = nodeIndex + 1;
+					const bool bRightFirst = DistanceToBox(Query.Point, Nodes[node.RightChild].Bounds) < DistanceToBox(Query.Point, Nodes[left].Bounds);
+					stack[stackSize++] = bRightFirst ? left : node.RightChild;
+					nodeIndex = bRightFirst ? node.RightChild : left;
+					continue;
+				}
+
+				for (uint32_t leafObject = node.FirstObject; leafObject < node.FirstObject + node.NumObjects; ++leafObject)
+				{
+					const uint32_t object = LeafObjects[leafObject];
+					const float distance = std::max((Query.Point - Objects[object].Position).length3() - Objects[object].CollisionRadius, 0.0f);
+					if (numFound < K ? distance > Query.MaxDistance : distance >= OutHits[K - 1].Distance)
+					{
+						continue;
+					}
+
+					size_t slot = std::min(numFound, K - 1);
+					while (slot > 0 && OutHits[slot - 1].Distance > distance)
+					{
+						OutHits[slot] = OutHits[slot - 1];
+						--slot;
+					}
+					OutHits[slot] = NearestHit{ Handles[object], distance };
+					numFound = std::min(numFound + 1, K);
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return;
+			}
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	void QueryScene::Raycast(const simd_vector<RayQuery>& Rays, std::vector<RayHit>& OutHits)
+	{
+		QueryMutex.lock();
+		OutHits.resize(Rays.size());
+		CurrentRays = &Rays;
+		CurrentRayHits = &OutHits;
+		MakeBatches(Rays.size(), RaycastBatchSize);
+		Kind = QueryKind::Raycast;
+		QueryJob.Work();
+		QueryMutex.unlock();
+	}
+
+	void QueryScene::OverlapSpheres(const simd_vector<SphereQuery>& Spheres, std::vector<ObjectHandle>& OutObjects, std::vector<size_t>& OutOffsets)
+	{
+		QueryMutex.lock();
+		//the workers leave each query's count one past it, which a running sum turns into the offsets
+		OutOffsets.assign(Spheres.size() + 1, 0);
+		CurrentSpheres = &Spheres;
+		CurrentOverlapOffsets = &OutOffsets;
+		MakeBatches(Spheres.size(), OverlapBatchSize);
+		if (OverlapResults.size() < Batches.size())
+		{
+			OverlapResults.resize(Batches.size());
+		}
+		Kind = QueryKind::Overlap;
+		QueryJob.Work();
+
+		for (size_t query = 0; query < Spheres.size(); ++query)
+		{
+			OutOffsets[query + 1] += OutOffsets[query];
+		}
+		OutObjects.clear();
+		OutObjects.reserve(OutOffsets.back());
+		for (size_t batch = 0; batch < Batches.size(); ++batch)
+		{
+			OutObjects.insert(OutObjects.end(), OverlapResults[batch].begin(), OverlapResults[batch].end());
+		}
+		QueryMutex.unlock();
+	}
+
+	void QueryScene::FindNearest(const simd_vector<NearestQuery>& Queries, size_t K, std::vector<NearestHit>& OutHits)
+	{
+		QueryMutex.lock();
+		OutHits.assign(Queries.size() * K, NearestHit{ InvalidObjectHandle, std::numeric_limits<float>::infinity() });
+		if (K > 0)
+		{
+			CurrentNearestQueries = &Queries;
+			CurrentK = K;
+			CurrentNearestHits = &OutHits;
+			MakeBatches(Queries.size(), NearestBatchSize);
+			Kind = QueryKind::Nearest;
+			QueryJob.Work();
+		}
+		QueryMutex.unlock();
+	}
+
+	void QueryWorkerFunction::operator () (std::vector<BatchRange>** Batches, QueryKind** Kind, size_t BatchIndex, QueryScene* Scene)
+	{
+		const BatchRange& batch = (**Batches)[BatchIndex];
+		switch (**Kind)
+		{
+		case QueryKind::Raycast:
+			TraceRays(batch, Scene);
+			break;
+		case QueryKind::Overlap:
+			OverlapSpheres(batch, BatchIndex, Scene);
+			break;
+		case QueryKind::Nearest:
+			FindNearest(batch, Scene);
+			break;
+		}
+	}
+
+	void QueryWorkerFunction::TraceRays(const BatchRange& Batch, QueryScene* Scene)
+	{
+		const simd_vector<RayQuery>& rays = *Scene->CurrentRays;
+		std::vector<RayHit>& hits = *Scene->CurrentRayHits;
+		for (size_t first = Batch.Begin; first < Batch.End; first += RayPacketSize)
+		{
+			Scene->TraceRayPacket(&rays[first], std::min(RayPacketSize, Batch.End - first), &hits[first]);
+		}
+	}
+
+	void QueryWorkerFunction::OverlapSpheres(const BatchRange& Batch, size_t BatchIndex, QueryScene* Scene)
+	{
+		const simd_vector<SphereQuery>& spheres = *Scene->CurrentSpheres;
+		std::vector<size_t>& counts = *Scene->CurrentOverlapOffsets;
+		std::vector<ObjectHandle>& results = Scene->OverlapResults[BatchIndex];
+		results.clear();
+		for (size_t query = Batch.Begin; query < Batch.End; ++query)
+		{
+			const size_t numBefore = results.size();
+			Scene->OverlapSphere(spheres[query], results);
+			counts[query + 1] = results.size() - numBefore;
+		}
+	}
+
+	void QueryWorkerFunction::FindNearest(const BatchRange& Batch, QueryScene* Scene)
+	{
+		const simd_vector<NearestQuery>& queries = *Scene->CurrentNearestQueries;
+		std::vector<NearestHit>& hits = *Scene->CurrentNearestHits;
+		const size_t k = Scene->CurrentK;
+		for (size_t query = Batch.Begin; query < Batch.End; ++query)
+		{
+			Scene->FindNearestTo(queries[query], k, &hits[query * k]);
+		}
+	}
+}
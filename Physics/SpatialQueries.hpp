@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+#include "../Core/Task.hpp"
+#include "../Core/BoundingBox.hpp"
+
+#include "Types.hpp"
+#include "Shapes.hpp"
+
+namespace Physics
+{
+	class PhysicsManager;
+	class QueryScene;
+
+	struct RayQuery
+	{
+		Core::Vector4 Origin;
+		Core::Vector4 Direction; //unit
+		float MaxDistance;
+	};
+
+	//closest hit along a ray, Handle is InvalidObjectHandle and Distance the ray's MaxDistance if nothing was hit
+	struct RayHit
+	{
+		Core::Vector4 Normal; //of the surface hit, against the ray - the reverse of the ray if it starts inside
+		ObjectHandle Handle;
+		float Distance;
+		bool bHit;
+	};
+
+	struct SphereQuery
+	{
+		Core::Vector4 Center;
+		float Radius;
+	};
+
+	struct NearestQuery
+	{
+		Core::Vector4 Point;
+		float MaxDistance;
+	};
+
+	//Distance is to the object's bounding sphere, 0 if the point is inside it
+	struct NearestHit
+	{
+		ObjectHandle Handle;
+		float Distance;
+	};
+
+	//node of the scene's BVH, laid out depth first like StaticMesh's: an internal node's left child is the next node
+	struct QueryNode
+	{
+		Core::BoundingBox Bounds;
+		uint32_t RightChild;
+		uint32_t FirstObject; //into the scene's leaf order
+		uint32_t NumObjects; //0 for internal nodes
+		uint32_t SplitAxis;
+	};
+
+	//which query the scene's job is running
+	enum class QueryKind
+	{
+		Raycast,
+		Overlap,
+		Nearest
+	};
+
+	//every kind of query shares the scene's one pool, switching on the kind of the call
+	struct QueryWorkerFunction
+	{
+		void operator () (std::vector<BatchRange>** Batches, QueryKind** Kind, size_t BatchIndex, QueryScene* Scene);
+
+	private:
+		static void TraceRays(const BatchRange& Batch, QueryScene* Scene);
+		//each batch collects its objects on its own, the counts go one past each query in the offsets
+		static void OverlapSpheres(const BatchRange& Batch, size_t BatchIndex, QueryScene* Scene);
+		static void FindNearest(const BatchRange& Batch, QueryScene* Scene);
+	};
+
+	//Read-only copy of a PhysicsManager's state with its own BVH, for gameplay queries that shouldn't wait on or race the simulation.
+	//Update it once a frame (or whenever the results need to catch up), then query from any thread. Each batch is spread over the
+	//scene's workers, batches from different threads take turns. Results name objects by handle, so they stay good after the
+	//manager's indices move. Planes and meshes are hit by rays and overlaps but aren't in the nearest queries, which only
+	//look at the objects' bounding spheres.
+	class QueryScene
+	{
+	public:
+		QueryScene(unsigned int NumThreads = 1);
+		QueryScene(const QueryScene& other) = delete;
+		QueryScene& operator=(const QueryScene& other) = delete;
+
+		//copies the manager's latest frame and rebuilds the tree over it - meshes are copied too, so it's not free with big ones
+		void Update(PhysicsManager& Manager);
+
+		//one hit per ray, in the same order. Consecutive rays are traced through the tree together in packets,
+		//so it pays to keep rays going roughly the same way next to each other.
+		void Raycast(const simd_vector<RayQuery>& Rays, std::vector<RayHit>& OutHits);
+
+		//everything touching each sphere - query i's objects are OutObjects[OutOffsets[i], OutOffsets[i + 1])
+		void OverlapSpheres(const simd_vector<SphereQuery>& Spheres, std::vector<ObjectHandle>& OutObjects, std::vector<size_t>& OutOffsets);
+
+		//the K nearest objects to each point within its MaxDistance, closest first - query i's are OutHits[i * K, (i + 1) * K),
+		//with the unused ones left at InvalidObjectHandle and an infinite distance
+		void FindNearest(const simd_vector<NearestQuery>& Queries, size_t K, std::vector<NearestHit>& OutHits);
+
+		size_t GetNumObjects() const;
+
+	private:
+
+		friend struct QueryWorkerFunction;
+
+		uint32_t BuildNode(size_t Begin, size_t End);
+		void MakeBatches(size_t NumQueries, size_t BatchSize);
+
+		void TraceRayPacket(const RayQuery* Rays, size_t NumRays, RayHit* OutHits) const;
+		void OverlapSphere(const SphereQuery& Query, std::vector<ObjectHandle>& OutObjects) const;
+		void FindNearestTo(const NearestQuery& Query, size_t K, NearestHit* OutHits) const;
+
+		//one query at a time, they share the job, the batches and the current query pointers
+		std::mutex QueryMutex;
+
+		simd_vector<PhysicsObject> Objects;
+		std::vector<ObjectHandle> Handles;
+		ShapeData Shapes;
+
+		//planes and meshes, tested against every ray and overlap rather than sitting in the tree
+		std::vector<size_t> WorldObjects;
+		simd_vector<QueryNode> Nodes;
+		//object indices in leaf order
+		std::vector<uint32_t> LeafObjects;
+
+		std::vector<BatchRange> Batches;
+		decltype(Batches)* CurrentBatches;
+
+		const simd_vector<RayQuery>* CurrentRays;
+		std::vector<RayHit>* CurrentRayHits;
+
+		const simd_vector<SphereQuery>* CurrentSpheres;
+		//per batch, concatenated once the batch is done
+		std::vector<std::vector<ObjectHandle>> OverlapResults;
+		std::vector<size_t>* CurrentOverlapOffsets;
+
+		const simd_vector<NearestQuery>* CurrentNearestQueries;
+		size_t CurrentK;
+		std::vector<NearestHit>* CurrentNearestHits;
+
+		QueryKind Kind;
+		decltype(Kind)* CurrentKind;
+		Task<std::vector<BatchRange>, QueryKind, QueryWorkerFunction, QueryScene> QueryJob;
+	};
+}
@@ -0,0 +1,492 @@
+#include "StaticMesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Core;
+namespace Physics
+{
+	//3 bits of count in QuantizedBVHNode::Data
+	static const size_t MaxLeafTriangles = 4;
+	static const uint32_t LeafCountShift = 29;
+	static const uint32_t LeafIndexMask = (1u << LeafCountShift) - 1;
+
+	static const float QuantizedRange = 65535.0f;
+
+	//deep enough for a median split of anything that fits in the 29 bit triangle index
+	static const int MaxTraversalDepth = 64;
+
+	static Vector4 Cross(const Vector4& a, const Vector4& b)
+	{
+		return Vector4(a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X);
+	}
+
+	//Voronoi region walk, from Ericson's Real-Time Collision Detection
+	static Vector4 ClosestPointOnTriangle(const Vector4& Point, const MeshTriangle& Triangle)
+	{
+		const Vector4& a = Triangle.Vertices[0];
+		const Vector4& b = Triangle.Vertices[1];
+		const Vector4& c = Triangle.Vertices[2];
+		const Vector4 ab = b - a;
+		const Vector4 ac = c - a;
+
+		const Vector4 ap = Point - a;
+		const float d1 = ab.dot3(ap);
+		const float d2 = ac.dot3(ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+		{
+			return a;
+		}
+
+		const Vector4 bp = Point - b;
+		const float d3 = ab.dot3(bp);
+		const float d4 = ac.dot3(bp);
+		if (d3 >= 0.0f && d4 <= d3)
+		{
+			return b;
+		}
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			return a + ab * (d1 / (d1 - d3));
+		}
+
+		const Vector4 cp = Point - c;
+		const float d5 = ab.dot3(cp);
+		const float d6 = ac.dot3(cp);
+		if (d6 >= 0.0f && d5 <= d6)
+		{
+			return c;
+		}
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			return a + ac * (d2 / (d2 - d6));
+		}
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+
+		//inside the face
+		const float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	static bool NodeOverlaps(const QuantizedBVHNode& Node, const uint16_t Min[3], const uint16_t Max[3])
+	{
+		return Node.Min[0] <= Max[0] && Node.Max[0] >= Min[0] &&
+			Node.Min[1] <= Max[1] && Node.Max[1] >= Min[1] &&
+			Node.Min[2] <= Max[2] && Node.Max[2] >= Min[2];
+	}
+
+	//depth-first walk calling Visit(firstTriangle, count) for every overlapping leaf, stops early if Visit returns false
+	template<typename Visitor>
+	static void VisitLeaves(const std::vector<QuantizedBVHNode>& Nodes, const uint16_t Min[3], const uint16_t Max[3], Visitor Visit)
+	{
+		uint32_t stack[MaxTraversalDepth];
+		int stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true)
+		{
+			const QuantizedBVHNode& node = Nodes[nodeIndex];
+			if (NodeOverlaps(node, Min, Max))
+			{
+				const uint32_t count = node.Data >> LeafCountShift;
+				if (count == 0)
+				{
+					stack[stackSize++] = node.Data;
+					nodeIndex = nodeIndex + 1;
+					continue;
+				}
+
+				if (!Visit(node.Data & LeafIndexMask, count))
+				{
+					return;
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return;
+			}
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	//Moller-Trumbore, front faces only
+	static bool RayHitsTriangle(const Vector4& Origin, const Vector4& Direction, const MeshTriangle& Triangle, float& OutDistance)
+	{
+		if (Direction.dot3(Triangle.Normal) >= 0.0f)
+		{
+			return false;
+		}
+
+		const Vector4 edgeB = Triangle.Vertices[1] - Triangle.Vertices[0];
+		const Vector4 edgeC = Triangle.Vertices[2] - Triangle.Vertices[0];
+		const Vector4 p = Cross(Direction, edgeC);
+		const float determinant = edgeB.dot3(p);
+		if (std::abs(determinant) < 1e-12f)
+		{
+			return false;
+		}
+
+		const float inverseDeterminant = 1.0f / determinant;
+		const Vector4 offset = Origin - Triangle.Vertices[0];
+		const float u = offset.dot3(p) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+
+		const Vector4 q = Cross(offset, edgeB);
+		const float v = Direction.dot3(q) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+
+		OutDistance = edgeC.dot3(q) * inverseDeterminant;
+		return OutDistance >= 0.0f;
+	}
+
+	//everything but the nodes and triangles, which get sections of their own
+	struct SavedMeshInfo
+	{
+		BoundingBox Bounds;
+		Vector4 QuantizationScale;
+	};
+
+	StaticMesh::StaticMesh() :
+		Bounds(Vector4(0.0f), Vector4(0.0f))
+	{}
+
+	StaticMesh::StaticMesh(const simd_vector<Vector4>& Vertices, const std::vector<unsigned int>& Indices)
+	{
+		const size_t numTriangles = Indices.size() / 3;
+
+		simd_vector<MeshTriangle> sourceTriangles(numTriangles);
+		simd_vector<Vector4> centroids(numTriangles);
+		Bounds = BoundingBox(Vector4(std::numeric_limits<float>::max()), Vector4(-std::numeric_limits<float>::max()));
+		for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+		{
+			MeshTriangle& newTriangle = sourceTriangles[triangle];
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				const Vector4& vertex = Vertices[Indices[triangle * 3 + corner]];
+				newTriangle.Vertices[corner] = Vector4(vertex.X, vertex.Y, vertex.Z);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					Bounds.Min[axis] = std::min(Bounds.Min[axis], vertex[axis]);
+					Bounds.Max[axis] = std::max(Bounds.Max[axis], vertex[axis]);
+				}
+			}
+
+			const Vector4 normal = Cross(newTriangle.Vertices[1] - newTriangle.Vertices[0], newTriangle.Vertices[2] - newTriangle.Vertices[0]);
+			const float length = normal.length3();
+			newTriangle.Normal = length > 0.0f ? normal / length : Vector4(0.0f, 1.0f, 0.0f);
+			centroids[triangle] = (newTriangle.Vertices[0] + newTriangle.Vertices[1] + newTriangle.Vertices[2]) / 3.0f;
+		}
+
+		if (numTriangles == 0)
+		{
+			Bounds = BoundingBox(Vector4(0.0f), Vector4(0.0f));
+			return;
+		}
+
+		//flat meshes have a zero extent on some axis, anything nonzero quantizes fine there
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			QuantizationScale[axis] = QuantizedRange / std::max(Bounds.Max[axis] - Bounds.Min[axis], 1e-6f);
+		}
+
+		std::vector<uint32_t> order(numTriangles);
+		for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+		{
+			order[triangle] = static_cast<uint32_t>(triangle);
+		}
+
+		Nodes.reserve(2 * numTriangles / MaxLeafTriangles + 1);
+		BuildNode(order, 0, numTriangles, centroids, sourceTriangles);
+
+		//store the triangles in leaf order, so a leaf reads one contiguous run
+		Triangles.reserve(numTriangles);
+		for (uint32_t triangle : order)
+		{
+			Triangles.push_back(sourceTriangles[triangle]);
+		}
+	}
+
+	uint32_t StaticMesh::BuildNode(std::vector<uint32_t>& Order, size_t Begin, size_t End, const simd_vector<Vector4>& Centroids, const simd_vector<MeshTriangle>& SourceTriangles)
+	{
+		const uint32_t nodeIndex = static_cast<uint32_t>(Nodes.size());
+		Nodes.push_back(QuantizedBVHNode());
+
+		BoundingBox bounds(Vector4(std::numeric_limits<float>::max()), Vector4(-std::numeric_limits<float>::max()));
+		BoundingBox centroidBounds = bounds;
+		for (size_t i = Begin; i < End; ++i)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (auto& vertex : SourceTriangles[Order[i]].Vertices)
+				{
+					bounds.Min[axis] = std::min(bounds.Min[axis], vertex[axis]);
+					bounds.Max[axis] = std::max(bounds.Max[axis], vertex[axis]);
+				}
+				centroidBounds.Min[axis] = std::min(centroidBounds.Min[axis], Centroids[Order[i]][axis]);
+				centroidBounds.Max[axis] = std::max(centroidBounds.Max[axis], Centroids[Order[i]][axis]);
+			}
+		}
+
+		//round outwards so the quantized box always contains the real one
+		QuantizedBVHNode node;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			node.Min[axis] = static_cast<uint16_t>(std::max(std::floor((bounds.Min[axis] - Bounds.Min[axis]) * QuantizationScale[axis]), 0.0f));
+			node.Max[axis] = static_cast<uint16_t>(std::min(std::ceil((bounds.Max[axis] - Bounds.Min[axis]) * QuantizationScale[axis]), QuantizedRange));
+		}
+
+		if (End - Begin <= MaxLeafTriangles)
+		{
+			node.Data = static_cast<uint32_t>(Begin) | static_cast<uint32_t>((End - Begin) << LeafCountShift);
+			Nodes[nodeIndex] = node;
+			return nodeIndex;
+		}
+
+		//median split along the longest axis of the centroids
+		int splitAxis = 0;
+		for (int axis = 1; axis < 3; ++axis)
+		{
+			if (centroidBounds.Max[axis] - centroidBounds.Min[axis] > centroidBounds.Max[splitAxis] - centroidBounds.Min[splitAxis])
+			{
+				splitAxis = axis;
+			}
+		}
+
+		const size_t middle = Begin + (End - Begin) / 2;
+		std::nth_element(Order.begin() + Begin, Order.begin() + middle, Order.begin() + End,
+			[&](uint32_t a, uint32_t b) { return Centroids[a][splitAxis] < Centroids[b][splitAxis]; });
+
+		BuildNode(Order, Begin, middle, Centroids, SourceTriangles);
+		node.Data = BuildNode(Order, middle, End, Centroids, SourceTriangles);
+		Nodes[nodeIndex] = node;
+		return nodeIndex;
+	}
+
+	bool StaticMesh::QuantizeSphere(const Vector4& Center, float Radius, uint16_t OutMin[3], uint16_t OutMax[3]) const
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float min = (Center[axis] - Radius - Bounds.Min[axis]) * QuantizationScale[axis];
+			const float max = (Center[axis] + Radius - Bounds.Min[axis]) * QuantizationScale[axis];
+			if (max < 0.0f || min > QuantizedRange)
+			{
+				return false;
+			}
+
+			OutMin[axis] = static_cast<uint16_t>(std::max(std::floor(min), 0.0f));
+			OutMax[axis] = static_cast<uint16_t>(std::min(std::ceil(max), QuantizedRange));
+		}
+		return true;
+	}
+
+	bool StaticMesh::Overlaps(const Vector4& Center, float Radius) const
+	{
+		uint16_t min[3], max[3];
+		if (Nodes.empty() || !QuantizeSphere(Center, Radius, min, max))
+		{
+			return false;
+		}
+
+		bool bOverlaps = false;
+		VisitLeaves(Nodes, min, max, [&](uint32_t, uint32_t)
+		{
+			bOverlaps = true;
+			return false;
+		});
+		return bOverlaps;
+	}
+
+	bool StaticMesh::GetDeepestContact(const Vector4& Center, float Radius, Vector4& OutNormal, float& OutPenetration) const
+	{
+		uint16_t min[3], max[3];
+		if (Nodes.empty() || !QuantizeSphere(Center, Radius, min, max))
+		{
+			return false;
+		}
+
+		bool bTouching = false;
+		float deepest = 0.0f;
+		VisitLeaves(Nodes, min, max, [&](uint32_t first, uint32_t count)
+		{
+			for (uint32_t triangle = first; triangle < first + count; ++triangle)
+			{
+				const MeshTriangle& face = Triangles[triangle];
+				const float height = (Center - face.Vertices[0]).dot3(face.Normal);
+				if (height <= -Radius)
+				{
+					continue;
+				}
+
+				const Vector4 offset = Center - ClosestPointOnTriangle(Center, face);
+				const float distanceSquared = offset.length3Squared();
+				if (distanceSquared >= Radius * Radius)
+				{
+					continue;
+				}
+
+				Vector4 normal;
+				float penetration;
+				if (height > 0.0f)
+				{
+					const float distance = std::sqrt(distanceSquared);
+					normal = offset / distance;
+					penetration = Radius - distance;
+				}
+				else if (distanceSquared <= height * height * 1.0001f)
+				{
+					//pushed through the face (or sitting exactly on it) - back out the front, however deep
+					normal = face.Normal;
+					penetration = Radius - height;
+				}
+				else
+				{
+					//behind the plane and off to the side, the neighbouring face owns this one
+					continue;
+				}
+
+				if (!bTouching || penetration > deepest)
+				{
+					bTouching = true;
+					deepest = penetration;
+					OutNormal = normal;
+				}
+			}
+			return true;
+		});
+
+		OutPenetration = deepest;
+		return bTouching;
+	}
+
+	const BoundingBox& StaticMesh::GetBounds() const
+	{
+		return Bounds;
+	}
+
+	size_t StaticMesh::GetNumTriangles() const
+	{
+		return Triangles.size();
+	}
+
+	size_t StaticMesh::GetNumNodes() const
+	{
+		return Nodes.size();
+	}
+
+	bool StaticMesh::Raycast(const Vector4& Origin, const Vector4& Direction, float MaxDistance, float& OutDistance, Vector4& OutNormal) const
+	{
+		if (Nodes.empty())
+		{
+			return false;
+		}
+
+		Vector4 inverseDirection;
+		Vector4 inverseScale;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			inverseDirection[axis] = 1.0f / Direction[axis];
+			inverseScale[axis] = 1.0f / QuantizationScale[axis];
+		}
+
+		bool bHit = false;
+		float closest = MaxDistance;
+		uint32_t stack[MaxTraversalDepth];
+		int stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true)
+		{
+			const QuantizedBVHNode& node = Nodes[nodeIndex];
+			BoundingBox nodeBounds;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				nodeBounds.Min[axis] = Bounds.Min[axis] + node.Min[axis] * inverseScale[axis];
+				nodeBounds.Max[axis] = Bounds.Min[axis] + node.Max[axis] * inverseScale[axis];
+			}
+
+			if (nodeBounds.IntersectsRay(Origin, inverseDirection, closest))
+			{
+				const uint32_t count = node.Data >> LeafCountShift;
+				if (count == 0)
+				{
+					stack[stackSize++] = node.Data;
+					nodeIndex = nodeIndex + 1;
+					continue;
+				}
+
+				const uint32_t first = node.Data & LeafIndexMask;
+				for (uint32_t triangle = first; triangle < first + count; ++triangle)
+				{
+					float distance;
+					if (RayHitsTriangle(Origin, Direction, Triangles[triangle], distance) && distance <= closest)
+					{
+						bHit = true;
+						closest = distance;
+						OutNormal = Triangles[triangle].Normal;
+					}
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				break;
+			}
+			nodeIndex = stack[--stackSize];
+		}
+
+		OutDistance = closest;
+		return bHit;
+	}
+
+	void StaticMesh::SaveSnapshot(SnapshotWriter& Writer, uint32_t Instance) const
+	{
+		const SavedMeshInfo info = { Bounds, QuantizationScale };
+		Writer.Write(SnapshotSection::MeshInfo, Instance, &info, 1);
+		Writer.Write(SnapshotSection::MeshNodes, Instance, Nodes);
+		Writer.Write(SnapshotSection::MeshTriangles, Instance, Triangles);
+	}
+
+	bool StaticMesh::LoadSnapshot(const SnapshotReader& Reader, uint32_t Instance)
+	{
+		const SavedMeshInfo* info;
+		size_t numInfos;
+		if (!Reader.Find(SnapshotSection::MeshInfo, Instance, info, numInfos) || numInfos != 1 ||
+			!Reader.Read(SnapshotSection::MeshNodes, Instance, Nodes) || !Reader.Read(SnapshotSection::MeshTriangles, Instance, Triangles))
+		{
+			return false;
+		}
+
+		Bounds = info->Bounds;
+		QuantizationScale = info->QuantizationScale;
+
+		//the traversal trusts the tree, so make sure every link stays inside it - children always come after their parent
+		for (size_t node = 0; node < Nodes.size(); ++node)
+		{
+			const uint32_t count = Nodes[node].Data >> LeafCountShift;
+			const uint32_t index = Nodes[node].Data & LeafIndexMask;
+			const bool bValid = count > 0 ? index + count <= Triangles.size() : index > node + 1 && index < Nodes.size();
+			if (!bValid)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Types.hpp"
+#include "Snapshot.hpp"
+#include "../Core/BoundingBox.hpp"
+
+namespace Physics
+{
+	struct MeshTriangle
+	{
+		Core::Vector4 Vertices[3];
+		Core::Vector4 Normal; //unit, (B - A) x (C - A) - the front side
+	};
+
+	//BVH node with its bounds quantized to 16 bits per axis against the mesh bounds (rounded outwards, so never too small).
+	//Nodes are laid out depth first: an internal node's left child is the next node, Data holds the index of the right one.
+	struct QuantizedBVHNode
+	{
+		uint16_t Min[3];
+		uint16_t Max[3];
+		//leaf: first triangle in the low 29 bits, triangle count in the top 3 - internal: right child index, top bits 0
+		uint32_t Data;
+	};
+
+	//Static triangle soup in world space, with a BVH built once at load and never touched again.
+	//Triangles are one sided, with the front where (B - A) x (C - A) points. A sphere pushed through a face is pushed back out
+	//the front rather than out the back, so thin ground holds up under heavy piles.
+	class StaticMesh
+	{
+	public:
+		//Indices are triples into Vertices
+		StaticMesh(const simd_vector<Core::Vector4>& Vertices, const std::vector<unsigned int>& Indices);
+
+		//empty, for loading a snapshot into
+		StaticMesh();
+
+		//cheap early out for the broadphase: does any leaf's bounds overlap the sphere's bounds
+		bool Overlaps(const Core::Vector4& Center, float Radius) const;
+
+		//deepest triangle the sphere touches, normal pointing from the mesh to the sphere - false if it touches none
+		bool GetDeepestContact(const Core::Vector4& Center, float Radius, Core::Vector4& OutNormal, float& OutPenetration) const;
+
+		//closest front face hit by Origin + t * Direction for t in [0, MaxDistance], Direction unit - false if none
+		bool Raycast(const Core::Vector4& Origin, const Core::Vector4& Direction, float MaxDistance, float& OutDistance, Core::Vector4& OutNormal) const;
+
+		const Core::BoundingBox& GetBounds() const;
+		size_t GetNumTriangles() const;
+		size_t GetNumNodes() const;
+
+		//the built tree is saved as is, so loading doesn't rebuild it - Instance tells the meshes in a snapshot apart
+		void SaveSnapshot(SnapshotWriter& Writer, uint32_t Instance) const;
+		bool LoadSnapshot(const SnapshotReader& Reader, uint32_t Instance);
+
+	private:
+
+		uint32_t BuildNode(std::vector<uint32_t>& Order, size_t Begin, size_t End, const simd_vector<Core::Vector4>& Centroids, const simd_vector<MeshTriangle>& SourceTriangles);
+
+		//quantized bounds of the sphere, false if it's entirely outside the mesh
+		bool QuantizeSphere(const Core::Vector4& Center, float Radius, uint16_t OutMin[3], uint16_t OutMax[3]) const;
+
+		Core::BoundingBox Bounds;
+		Core::Vector4 QuantizationScale; //per axis, quantized units per world unit
+
+		std::vector<QuantizedBVHNode> Nodes;
+		//in leaf order, so each leaf's triangles are contiguous
+		simd_vector<MeshTriangle> Triangles;
+	};
+}
@@ -1,22 +1,51 @@
 #include <thread>
+#include <algorithm>
+#include <cstring>
 
 #include "TaskFunctions.hpp"
 #include "PhysicsManager.hpp"
 
 namespace Physics
 {
-	void DetectCollisionsWorkerFunction::operator() (simd_vector<PhysicsObject>** CollisionObjects, std::vector<CollisionPair>** CollisionPairs, size_t CollisionObjectIndex, PhysicsManager* Manager)
+	//SplitMix64 finalizer
+	static uint64_t MixBits(uint64_t Value)
 	{
-		PhysicsObject& first = (**CollisionObjects)[CollisionObjectIndex];
+		Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+		return Value ^ (Value >> 31);
+	}
+
+	//a random looking color from the pair and the frame rather than a shared random engine, so it doesn't matter which thread gets there first
+	static Core::Vector4 ImpactColor(size_t IndexA, size_t IndexB, uint64_t Frame)
+	{
+		const uint64_t bits = MixBits(MakePairKey(IndexA, IndexB) ^ MixBits(Frame));
+		const float scale = 1.0f / 2097152.0f; //21 bits per channel
+		return Core::Vector4((bits & 0x1fffff) * scale, ((bits >> 21) & 0x1fffff) * scale, ((bits >> 42) & 0x1fffff) * scale, 1.0f);
+	}
+
+	void DetectCollisionsWorkerFunction::operator() (std::vector<size_t>** AwakeObjects, CollisionPairList** CollisionPairs, size_t AwakeIndex, PhysicsManager* Manager)
+	{
+		PhysicsObject& first = (*Manager->StateFrontBuffer)[(**AwakeObjects)[AwakeIndex]];
 
-		int stateIndex = 0;
-		
+		//the grid leaves out awake objects on levels finer than ours, those pairs are only found from the smaller object
+		const bool bGrid = Manager->Broadphase == BroadphaseType::HierarchicalGrid;
 		std::vector<PhysicsObject*> potentialColliders;
-		Manager->CollisionOctree.GetPotentialColliders(first.Position, first.CollisionRadius, potentialColliders);
+		if (bGrid)
+		{
+			Manager->CollisionGrid.GetPotentialColliders(first.Position, first.CollisionRadius, potentialColliders);
+		}
+		else
+		{
+			Manager->CollisionOctree.GetPotentialColliders(first.Position, first.CollisionRadius, potentialColliders);
+		}
+		const unsigned int firstLevel = bGrid ? Manager->CollisionGrid.GetLevel(first.CollisionRadius) : 0;
+
+		std::vector<PhysicsObject*> colliders;
 		for (auto second : potentialColliders)
 		{
-			//don't check it against itself
-			if (&first == second)
+			//pairs of awake objects are found from both sides, only keep the one from the lower index
+			//sleepers never query, so their pairs have to be kept from the awake side
+			if (second == &first || (!second->bAsleep && second->Index < first.Index && (!bGrid || Manager->CollisionGrid.GetLevel(second->CollisionRadius) == firstLevel)))
 			{
 				continue;
 			}
@@ -25,50 +54,235 @@ namespace Physics
 			const float totalRadiusSquared = (first.CollisionRadius + second->CollisionRadius) * (first.CollisionRadius + second->CollisionRadius);
 			if (distanceSquared < totalRadiusSquared)
 			{
-				PairsMutex.lock();
-				(**CollisionPairs).push_back(std::make_pair(&first, second));
-				PairsMutex.unlock();
+				colliders.push_back(second);
+			}
+		}
+
+		//planes are infinite, so they stay out of the octree and everyone checks them directly
+		auto& frontBuffer = *Manager->StateFrontBuffer;
+		for (size_t planeIndex : Manager->Shapes.Owners[static_cast<size_t>(ShapeType::Plane)])
+		{
+			const PlaneShape& plane = Manager->Shapes.Planes[frontBuffer[planeIndex].ShapeIndex];
+			if (plane.Normal.dot3(first.Position) - plane.Distance < first.CollisionRadius)
+			{
+				colliders.push_back(&frontBuffer[planeIndex]);
+			}
+		}
+
+		//meshes only collide with spheres so far, and only get the BVH's leaf bounds test here - the triangles are left to the narrowphase
+		if (first.Shape == ShapeType::Sphere)
+		{
+			for (size_t meshIndex : Manager->Shapes.Owners[static_cast<size_t>(ShapeType::Mesh)])
+			{
+				if (Manager->Shapes.Meshes[frontBuffer[meshIndex].ShapeIndex].Overlaps(first.Position, first.CollisionRadius))
+				{
+					colliders.push_back(&frontBuffer[meshIndex]);
+				}
+			}
+		}
+
+		if (!colliders.empty())
+		{
+			//objects straddling node boundaries live in more than one leaf, so the same collider can come back more than once
+			std::sort(colliders.begin(), colliders.end());
+			colliders.erase(std::unique(colliders.begin(), colliders.end()), colliders.end());
+
+			//always store the lower index first so the contact normal points the same way every frame
+			PairsMutex.lock();
+			for (auto second : colliders)
+			{
+				(**CollisionPairs).push_back(first.Index < second->Index ? std::make_pair(&first, second) : std::make_pair(second, &first));
+			}
+			PairsMutex.unlock();
+		}
+	}
+
+	void PrepareContactsWorkerFunction::operator() (std::vector<BatchRange>** Batches, simd_vector<Contact>** Contacts, size_t BatchIndex, PhysicsManager* Manager)
+	{
+		using namespace Core;
+		const BatchRange& batch = (**Batches)[BatchIndex];
+		auto& collisionPairs = *Manager->CurrentPairsBuffer;
+		auto& backBuffer = *Manager->StateBackBuffer;
+
+		//every pair in a batch has the same shapes in the same order, so the test is looked up once for all of them
+		const ShapeType firstShape = collisionPairs[batch.Begin].first->Shape;
+		const ShapeType secondShape = collisionPairs[batch.Begin].second->Shape;
+		const ContactGeometryFunction computeGeometry = ContactGeometryTable[static_cast<size_t>(firstShape)][static_cast<size_t>(secondShape)];
+		//two spheres are tested in less time than it takes to check whether the cached contact can stand in for the test
+		const bool bReuseContacts = firstShape != ShapeType::Sphere || secondShape != ShapeType::Sphere;
+
+		for (size_t pairIndex = batch.Begin; pairIndex < batch.End; ++pairIndex)
+		{
+			const PhysicsObject& first = *collisionPairs[pairIndex].first;
+			const PhysicsObject& second = *collisionPairs[pairIndex].second;
+			//contacts are presized to match the pairs, so every thread writes its own slots
+			Contact& contact = (**Contacts)[pairIndex];
+
+			//orientations never change, so a cached normal stays valid for any shape as long as the offset barely moves
+			const Vector4 relativePosition = first.Position - second.Position;
+			const CachedContact* cached = Manager->ContactCache.Find(first.Index, second.Index);
+			if (bReuseContacts && cached != nullptr && Manager->ContactCache.CanReuse(*cached, relativePosition))
+			{
+				//barely moved since the last full test - keep the normal and just track the change in separation along it
+				contact = cached->Data;
+				contact.Penetration = cached->Data.BasePenetration - (relativePosition - cached->Data.RelativePosition).dot3(contact.Normal);
+			}
+			else
+			{
+				computeGeometry(first, second, Manager->Shapes, contact);
+				contact.BasePenetration = contact.Penetration;
+			}
+
+			//the bounding spheres overlapped but the shapes are clearly apart - dropped before the solve
+			//(a gap within the slop is kept, resting contacts drift in and out of it and need to keep their impulse)
+			if (contact.Penetration < -Manager->Solver.Settings.PenetrationSlop)
+			{
+				continue;
+			}
+
+			//the back buffer has this frame's external forces and impulses, the pair still points at last frame's state
+			const PhysicsObject& firstState = backBuffer[first.Index];
+			const PhysicsObject& secondState = backBuffer[second.Index];
+			const auto& accelerations = Manager->ForceAccelerations;
+			Manager->Solver.PrepareContact(firstState, secondState, accelerations[first.Index], accelerations[second.Index], Manager->CurrentDeltaTime, cached != nullptr ? cached->Data.NormalImpulse : 0.0f, contact);
+
+			//recolor on impact only, so resting contacts don't flicker
+			if ((first.Velocity - second.Velocity).dot3(contact.Normal) < 0.0f)
+			{
+				const Vector4 color = ImpactColor(first.Index, second.Index, Manager->FrameNumber);
+				backBuffer[first.Index].Color = color;
+				backBuffer[second.Index].Color = color;
+			}
+		}
+	}
+
+	void SolveContactsWorkerFunction::operator () (std::vector<BatchRange>** Batches, simd_vector<Contact>** Contacts, size_t BatchIndex, PhysicsManager* Manager)
+	{
+		//islands never share a movable object, and immovable ones are only read
+		Manager->Solver.SolveIslandBatch(**Contacts, *Manager->StateBackBuffer, (**Batches)[BatchIndex]);
+	}
+
+	void ContinuousCollisionWorkerFunction::operator () (std::vector<size_t>** FastObjects, std::vector<float>** TimesOfImpact, size_t FastIndex, PhysicsManager* Manager)
+	{
+		using namespace Core;
+		const size_t objectIndex = (**FastObjects)[FastIndex];
+		const auto& frontBuffer = *Manager->StateFrontBuffer;
+		const auto& backBuffer = *Manager->StateBackBuffer;
+
+		//the front buffer has where everything started the frame, the back buffer where integration put it
+		const PhysicsObject& start = frontBuffer[objectIndex];
+		const Vector4 displacement = backBuffer[objectIndex].Position - start.Position;
+
+		//anything whose bounds at the start of the frame overlap the sweep is in one of the leaves we visit - other fast
+		//objects are tested against their own sweeps afterwards
+		const BoundingBox& sweptBounds = Manager->FastBounds[FastIndex];
+		std::vector<PhysicsObject*> potentialColliders;
+		if (Manager->Broadphase == BroadphaseType::HierarchicalGrid)
+		{
+			Manager->CollisionGrid.GetObjectsInBounds(sweptBounds, potentialColliders);
+		}
+		else
+		{
+			Manager->CollisionOctree.GetObjectsInBounds(sweptBounds, potentialColliders);
+		}
+
+		const float contactOverlap = Manager->ContinuousSettings.ContactOverlap;
+		float earliest = 1.0f;
+		for (auto other : potentialColliders)
+		{
+			if (other == &start)
+			{
+				continue;
 			}
-			++stateIndex;
+
+			const Vector4 otherDisplacement = backBuffer[other->Index].Position - other->Position;
+			const float distance = std::max(start.CollisionRadius + other->CollisionRadius - contactOverlap, 0.0f);
+			earliest = std::min(earliest, SweptSphereTimeOfImpact(start.Position, displacement, other->Position, otherDisplacement, distance));
+		}
+
+		for (size_t planeIndex : Manager->Shapes.Owners[static_cast<size_t>(ShapeType::Plane)])
+		{
+			const PlaneShape& plane = Manager->Shapes.Planes[frontBuffer[planeIndex].ShapeIndex];
+			const float distance = std::max(start.CollisionRadius - contactOverlap, 0.0f);
+			earliest = std::min(earliest, SweptSpherePlaneTimeOfImpact(start.Position, displacement, plane.Normal, plane.Distance, distance));
+		}
+
+		(**TimesOfImpact)[FastIndex] = earliest;
+	}
+
+	void BatchWorkerFunction::operator () (std::vector<BatchRange>** Batches, BatchJobKind** Kind, size_t BatchIndex, PhysicsManager* Manager)
+	{
+		const BatchRange& batch = (**Batches)[BatchIndex];
+		switch (**Kind)
+		{
+		case BatchJobKind::Integration:
+			IntegrateObjects(batch, Manager);
+			break;
+		case BatchJobKind::Accelerations:
+			EvaluateAccelerations(batch, Manager);
+			break;
+		case BatchJobKind::Spawn:
+			InitializeObjects(batch, Manager);
+			break;
+		case BatchJobKind::Placement:
+			FaultInObjects(batch, Manager);
+			break;
 		}
 	}
 
-	void ResolveCollisionsWorkerFunction::operator() (decltype(PhysicsManager::CollisionPairs)** CollisionPairs, decltype(PhysicsManager::StateFrontBuffer)* BackBuffer, size_t PairIndex, PhysicsManager* Manager)
+	void BatchWorkerFunction::IntegrateObjects(const BatchRange& Batch, PhysicsManager* Manager)
 	{
 		using namespace Core;
-		auto& backBuffer = **BackBuffer;
-		auto& collisionPair = (**CollisionPairs)[PairIndex];
+		auto& backBuffer = *Manager->StateBackBuffer;
+		const size_t* indices = Manager->AwakeObjects.data() + Batch.Begin;
+		const size_t count = Batch.End - Batch.Begin;
+		const float deltaTime = Manager->CurrentDeltaTime;
 
-		auto firstObject = collisionPair.first;
-		auto secondObject = collisionPair.second;
+		//every stage of the step sees the generators at its own position and velocity, so the higher order methods are
+		//actually higher order for springs, attractors and drag
+		auto acceleration = [Manager](const PhysicsObject& object, const Vector4& position, const Vector4& velocity)
+		{
+			return Manager->GetAcceleration(object, position, velocity);
+		};
 
-		//from second to first
-		Vector4 collisionNormal = (firstObject->Position - secondObject->Position).getNormalized3();
+		//Don't need to lock - batches never overlap, and the back buffer velocities have already been through the contact solver
+		Integrate(Manager->Integrator, backBuffer, indices, count, deltaTime, acceleration);
 
-		//only do anything if they're approaching each other (avoid oscillation between interpenetrating spheres)
-		if (firstObject->Velocity.dot3(collisionNormal) - secondObject->Velocity.dot3(collisionNormal) < 0.0f)
+		for (size_t i = 0; i < count; ++i)
 		{
-			float a1 = firstObject->Velocity.dot3(collisionNormal);
-			float a2 = secondObject->Velocity.dot3(collisionNormal);
+			PhysicsObject& object = backBuffer[indices[i]];
+			object.Force = Vector4(0.0f);
+			Manager->Sleep.UpdateSleepTimer(object, deltaTime);
+		}
+	}
 
-			float p = (2.0f * (a1 - a2)) / 2.0f /*m1 + m2, assume 1.0 mass for now*/;
+	void BatchWorkerFunction::EvaluateAccelerations(const BatchRange& Batch, PhysicsManager* Manager)
+	{
+		const auto& backBuffer = *Manager->StateBackBuffer;
+		for (size_t i = Batch.Begin; i < Batch.End; ++i)
+		{
+			const size_t index = Manager->AwakeObjects[i];
+			const PhysicsObject& object = backBuffer[index];
+			Manager->ForceAccelerations[index] = Manager->GetAcceleration(object, object.Position, object.Velocity);
+		}
+	}
 
-			backBuffer[firstObject->Index].Velocity = firstObject->Velocity - collisionNormal * p;
-			backBuffer[secondObject->Index].Velocity = secondObject->Velocity + collisionNormal * p;
+	void BatchWorkerFunction::InitializeObjects(const BatchRange& Batch, PhysicsManager* Manager)
+	{
+		using namespace Core;
+		for (size_t spawnIndex = Batch.Begin; spawnIndex < Batch.End; ++spawnIndex)
+		{
+			SpawnParameters parameters{ Vector4(0.0f), Vector4(0.0f), 1.0f, 1.0f, 1.0f };
+			(*Manager->CurrentSpawnGenerator)(spawnIndex, parameters);
 
-			Vector4 color(colorDist(RandomEngine), colorDist(RandomEngine), colorDist(RandomEngine), 1.0f);
-			backBuffer[firstObject->Index].Color = color;
-			backBuffer[secondObject->Index].Color = color;
+			Manager->PendingObjects[Manager->SpawnOffset + spawnIndex] = PhysicsManager::MakeObject(parameters.Position, parameters.Velocity,
+				parameters.Radius, parameters.Mass, parameters.Restitution, ShapeType::Sphere, 0);
 		}
 	}
 
-	void ApplyVelocitiesWorkerFunction::operator () (simd_vector<PhysicsObject>** FrontBuffer, simd_vector<PhysicsObject>** BackBuffer, size_t StateIndex, PhysicsManager* Manager)
+	void BatchWorkerFunction::FaultInObjects(const BatchRange& Batch, PhysicsManager* Manager)
 	{
-		//Forward Euler for now
-		//Don't need to lock - 2 threads with this function will never try to write to the same position in the array
-		Core::Vector4 position((**FrontBuffer)[StateIndex].Position);
-		(**BackBuffer)[StateIndex].Position = (**FrontBuffer)[StateIndex].Position + (**FrontBuffer)[StateIndex].Velocity * Manager->CurrentDeltaTime;
-		//TODO this is a hack for testing
-		(**BackBuffer)[StateIndex].Velocity -= position.getNormalized3() * 0.01f;
+		//no objects in it yet, it's only written so the first touch of its pages comes from this thread
+		std::memset(static_cast<void*>(Manager->PlacementStorage + Batch.Begin), 0, (Batch.End - Batch.Begin) * sizeof(PhysicsObject));
 	}
 }
\ No newline at end of file
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <mutex>
-#include <random>
 
 #include "Types.hpp"
 
@@ -9,28 +8,56 @@ namespace Physics
 {
 	class PhysicsManager;
 
-	typedef std::pair<PhysicsObject*, PhysicsObject*> CollisionPair;
-
+	//runs over the awake objects only - sleepers are still in the octree to be found, but never query it themselves
 	struct DetectCollisionsWorkerFunction
 	{
 		std::mutex PairsMutex;
-		void operator () (simd_vector<PhysicsObject>** CollisionObjects, std::vector<CollisionPair>** CollisionPairs, size_t CollisionObjectIndex, PhysicsManager* Manager);
+		void operator () (std::vector<size_t>** AwakeObjects, CollisionPairList** CollisionPairs, size_t AwakeIndex, PhysicsManager* Manager);
+	};
+
+	//turns each collision pair in a narrowphase batch into a contact for the solver
+	struct PrepareContactsWorkerFunction
+	{
+		void operator () (std::vector<BatchRange>** Batches, simd_vector<Contact>** Contacts, size_t BatchIndex, PhysicsManager* Manager);
 	};
 
-	struct ResolveCollisionsWorkerFunction
+	//solves a batch of whole contact islands, see ContactSolver::BuildIslandBatches
+	struct SolveContactsWorkerFunction
 	{
-		std::default_random_engine RandomEngine;
-		std::uniform_real_distribution<float> colorDist;
+		void operator () (std::vector<BatchRange>** Batches, simd_vector<Contact>** Contacts, size_t BatchIndex, PhysicsManager* Manager);
+	};
 
-		ResolveCollisionsWorkerFunction()
-			: colorDist(0.0f, 1.0f)
-		{}
+	//finds the earliest time of impact for each fast-moving object, using bounds expanded by its motion this frame against
+	//where the others started it - fast objects are swept against each other once the job is done
+	//non-spheres sweep their bounding sphere, which can stop them a little short
+	struct ContinuousCollisionWorkerFunction
+	{
+		void operator () (std::vector<size_t>** FastObjects, std::vector<float>** TimesOfImpact, size_t FastIndex, PhysicsManager* Manager);
+	};
 
-		void operator () (std::vector<CollisionPair>** CollisionPairs, simd_vector<PhysicsObject>** FrontBuffer, size_t PairIndex, PhysicsManager* Manager);
+	//what a BatchJob call runs on each of its batches
+	enum class BatchJobKind
+	{
+		Integration,
+		Accelerations,
+		Spawn,
+		Placement
 	};
 
-	struct ApplyVelocitiesWorkerFunction
+	//The manager's batched work that doesn't need a pool of its own shares one, switching on the kind of the call - see
+	//PhysicsManager::RunBatches.
+	struct BatchWorkerFunction
 	{
-		void operator () (simd_vector<PhysicsObject>** FrontBuffer, simd_vector<PhysicsObject>** BackBuffer, size_t StateIndex, PhysicsManager* Manager);
+		void operator () (std::vector<BatchRange>** Batches, BatchJobKind** Kind, size_t BatchIndex, PhysicsManager* Manager);
+
+	private:
+		//runs the selected integrator over a batch of the awake object list
+		static void IntegrateObjects(const BatchRange& Batch, PhysicsManager* Manager);
+		//evaluates the generators once for a batch of the awake object list, for the contact solver
+		static void EvaluateAccelerations(const BatchRange& Batch, PhysicsManager* Manager);
+		//builds a batch of bulk-spawned objects from the spawn generator, straight into the pending objects
+		static void InitializeObjects(const BatchRange& Batch, PhysicsManager* Manager);
+		//faults in a slice of the raw storage for a state buffer, so its pages land on the NUMA node of the thread that works on that slice
+		static void FaultInObjects(const BatchRange& Batch, PhysicsManager* Manager);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "Trajectory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace Core;
+namespace Physics
+{
+	static const char TrajectoryMagic[8] = { 'P', 'H', 'Y', 'S', 'T', 'R', 'A', 'J' };
+
+	//a sixteen millionth of the keyframe's bounds, and a typical frame's move fits in two bytes
+	static const uint32_t PositionBits = 24;
+	static const uint32_t MaxQuantized = (1u << PositionBits) - 1;
+
+	//Room left around the objects on every side of a keyframe's bounds, as a fraction of their extent plus a fixed amount,
+	//so a scene has to grow by a fair bit before it needs a keyframe early. Costs a little precision.
+	static const double BoundsMargin = 0.25;
+	static const double MinBoundsMargin = 1.0;
+
+	//deltas are signed, zigzag folds them so small magnitudes of either sign stay small
+	static uint32_t ZigZag(uint32_t Delta)
+	{
+		return (Delta << 1) ^ (0u - (Delta >> 31));
+	}
+
+	static uint32_t UnZigZag(uint32_t Value)
+	{
+		return (Value >> 1) ^ (0u - (Value & 1));
+	}
+
+	static void PushVarint(uint64_t Value, std::vector<unsigned char>& Out)
+	{
+		while (Value >= 0x80)
+		{
+			Out.push_back(static_cast<unsigned char>(Value | 0x80));
+			Value >>= 7;
+		}
+		Out.push_back(static_cast<unsigned char>(Value));
+	}
+
+	static bool ReadVarint(const unsigned char*& Data, const unsigned char* End, uint64_t& OutValue)
+	{
+		OutValue = 0;
+		for (int shift = 0; shift < 64 && Data < End; shift += 7)
+		{
+			const unsigned char byte = *Data++;
+			OutValue |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//a zero byte can't start the varint of anything but zero, so it marks a run of zeros, followed by the run length minus one
+	static void EncodeValues(const std::vector<uint32_t>& Values, std::vector<unsigned char>& Out)
+	{
+		for (size_t i = 0; i < Values.size();)
+		{
+			if (Values[i] != 0)
+			{
+				PushVarint(Values[i++], Out);
+				continue;
+			}
+
+			size_t run = 1;
+			while (i + run < Values.size() && Values[i + run] == 0)
+			{
+				++run;
+			}
+			Out.push_back(0);
+			PushVarint(run - 1, Out);
+			i += run;
+		}
+	}
+
+	static bool DecodeValues(const unsigned char* Data, const unsigned char* End, std::vector<uint32_t>& Values)
+	{
+		for (size_t i = 0; i < Values.size();)
+		{
+			uint64_t value;
+			if (Data < End && *Data == 0)
+			{
+				++Data;
+				if (!ReadVarint(Data, End, value) || value >= Values.size() - i)
+				{
+					return false;
+				}
+				std::fill(Values.begin() + i, Values.begin() + i + static_cast<size_t>(value) + 1, 0u);
+				i += static_cast<size_t>(value) + 1;
+			}
+			else
+			{
+				if (!ReadVarint(Data, End, value) || value > 0xffffffffu)
+				{
+					return false;
+				}
+				Values[i++] = static_cast<uint32_t>(value);
+			}
+		}
+		return Data == End;
+	}
+
+	TrajectoryRecorder::TrajectoryRecorder(size_t KeyframeInterval, size_t MaxQueuedFrames) :
+		BoundsMin{ 0.0f, 0.0f, 0.0f },
+		BoundsMax{ 0.0f, 0.0f, 0.0f },
+		QuantizationScale{ 0.0, 0.0, 0.0 },
+		KeyframeInterval(std::max<size_t>(KeyframeInterval, 1)),
+		bOpen(false),
+		bClosing(false),
+		bFailed(false),
+		NumClampedValues(0),
+		Frames(std::max<size_t>(MaxQueuedFrames, 1)),
+		FramesSinceKeyframe(0)
+	{
+		for (size_t frame = 0; frame < Frames.size(); ++frame)
+		{
+			FreeFrames.push_back(frame);
+		}
+	}
+
+	TrajectoryRecorder::~TrajectoryRecorder()
+	{
+		Close();
+	}
+
+	bool TrajectoryRecorder::Open(const std::string& Path)
+	{
+		if (bOpen)
+		{
+			return false;
+		}
+
+		File.open(Path, std::ios::binary | std::ios::trunc);
+		if (!File)
+		{
+			return false;
+		}
+
+		TrajectoryHeader header;
+		std::memcpy(header.Magic, TrajectoryMagic, sizeof(TrajectoryMagic));
+		header.Version = TrajectoryVersion;
+		header.PositionBits = PositionBits;
+		File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		bOpen = true;
+		bClosing = false;
+		bFailed = !File;
+		NumClampedValues = 0;
+		PreviousQuantized.clear();
+		FramesSinceKeyframe = 0;
+		Writer = std::thread(&TrajectoryRecorder::WriteFrames, this);
+		return true;
+	}
+
+	void TrajectoryRecorder::RecordFrame(const simd_vector<PhysicsObject>& Objects, bool bObjectsChanged)
+	{
+		if (!bOpen)
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		QueueChanged.wait(lock, [this] { return !FreeFrames.empty(); });
+		const size_t index = FreeFrames.back();
+		FreeFrames.pop_back();
+		lock.unlock();
+
+		//nobody else touches a buffer between taking it off the free list and queueing it
+		QueuedFrame& frame = Frames[index];
+		frame.Positions.resize(Objects.size());
+		for (size_t object = 0; object < Objects.size(); ++object)
+		{
+			frame.Positions[object] = Objects[object].Position;
+		}
+		frame.bForceKeyframe = bObjectsChanged;
+
+		lock.lock();
+		QueuedFrames.push_back(index);
+		lock.unlock();
+		QueueChanged.notify_all();
+	}
+
+	bool TrajectoryRecorder::Close()
+	{
+		if (!bOpen)
+		{
+			return !bFailed;
+		}
+
+		QueueMutex.lock();
+		bClosing = true;
+		QueueMutex.unlock();
+		QueueChanged.notify_all();
+		Writer.join();
+
+		File.close();
+		bFailed |= File.fail();
+		bOpen = false;
+		return !bFailed;
+	}
+
+	uint64_t TrajectoryRecorder::GetNumClampedValues() const
+	{
+		return NumClampedValues;
+	}
+
+	void TrajectoryRecorder::WriteFrames()
+	{
+		for (;;)
+		{
+			std::unique_lock<std::mutex> lock(QueueMutex);
+			QueueChanged.wait(lock, [this] { return !QueuedFrames.empty() || bClosing; });
+			if (QueuedFrames.empty())
+			{
+				return;
+			}
+			const size_t index = QueuedFrames.front();
+			QueuedFrames.pop_front();
+			lock.unlock();
+
+			EncodeFrame(Frames[index]);
+
+			lock.lock();
+			FreeFrames.push_back(index);
+			lock.unlock();
+			QueueChanged.notify_all();
+		}
+	}
+
+	void TrajectoryRecorder::FitBounds(const simd_vector<Vector4>& Positions)
+	{
+		double low[3] = { 0.0, 0.0, 0.0 };
+		double high[3] = { 0.0, 0.0, 0.0 };
+		bool bAny = false;
+		for (auto& position : Positions)
+		{
+			if (!std::isfinite(position.X) || !std::isfinite(position.Y) || !std::isfinite(position.Z))
+			{
+				continue;
+			}
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				low[axis] = bAny ? std::min(low[axis], static_cast<double>(position[axis])) : position[axis];
+				high[axis] = bAny ? std::max(high[axis], static_cast<double>(position[axis])) : position[axis];
+			}
+			bAny = true;
+		}
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double margin = (high[axis] - low[axis]) * BoundsMargin + MinBoundsMargin;
+			BoundsMin[axis] = static_cast<float>(low[axis] - margin);
+			BoundsMax[axis] = static_cast<float>(high[axis] + margin);
+			QuantizationScale[axis] = MaxQuantized / std::max(static_cast<double>(BoundsMax[axis]) - BoundsMin[axis], 1e-6);
+		}
+	}
+
+	bool TrajectoryRecorder::Quantize(const simd_vector<Vector4>& Positions)
+	{
+		uint64_t numClamped = 0;
+		for (size_t object = 0; object < Positions.size(); ++object)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const double value = Positions[object][axis];
+				uint32_t& quantized = Quantized[object * 3 + axis];
+				if (!std::isfinite(value))
+				{
+					//no bounds would hold it, NaN goes to the low one
+					quantized = value > 0.0 ? MaxQuantized : 0;
+					++numClamped;
+					continue;
+				}
+
+				const double scaled = (value - BoundsMin[axis]) * QuantizationScale[axis] + 0.5;
+				if (scaled < 0.0 || scaled >= MaxQuantized + 1.0)
+				{
+					return false;
+				}
+				quantized = static_cast<uint32_t>(scaled);
+			}
+		}
+
+		NumClampedValues += numClamped;
+		return true;
+	}
+
+	void TrajectoryRecorder::EncodeFrame(const QueuedFrame& Frame)
+	{
+		const size_t numValues = Frame.Positions.size() * 3;
+		Quantized.resize(numValues);
+
+		//deltas only make sense against the same objects in the same order, across the same bounds
+		bool bKeyframe = Frame.bForceKeyframe || FramesSinceKeyframe >= KeyframeInterval || PreviousQuantized.size() != numValues;
+		if (bKeyframe || !Quantize(Frame.Positions))
+		{
+			//something got out, so it's a keyframe after all
+			bKeyframe = true;
+			FitBounds(Frame.Positions);
+			Quantize(Frame.Positions);
+		}
+		FramesSinceKeyframe = bKeyframe ? 1 : FramesSinceKeyframe + 1;
+
+		Encoded.clear();
+		if (bKeyframe)
+		{
+			EncodeValues(Quantized, Encoded);
+		}
+		else
+		{
+			//reuse the previous frame's buffer for the deltas, it's replaced by this frame's values right after
+			for (size_t value = 0; value < numValues; ++value)
+			{
+				PreviousQuantized[value] = ZigZag(Quantized[value] - PreviousQuantized[value]);
+			}
+			EncodeValues(PreviousQuantized, Encoded);
+		}
+		std::swap(Quantized, PreviousQuantized);
+
+		TrajectoryFrameHeader header;
+		header.NumObjects = static_cast<uint32_t>(Frame.Positions.size());
+		header.bKeyframe = bKeyframe ? 1u : 0u;
+		header.PayloadSize = Encoded.size();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			header.BoundsMin[axis] = BoundsMin[axis];
+			header.BoundsMax[axis] = BoundsMax[axis];
+		}
+		File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		File.write(reinterpret_cast<const char*>(Encoded.data()), static_cast<std::streamsize>(Encoded.size()));
+		bFailed |= File.fail();
+	}
+
+	TrajectoryReader::TrajectoryReader() :
+		CurrentFrame(InvalidObjectIndex)
+	{}
+
+	bool TrajectoryReader::Open(const std::string& Path)
+	{
+		Frames.clear();
+		CurrentFrame = InvalidObjectIndex;
+		if (!File.Open(Path) || File.GetSize() < sizeof(TrajectoryHeader))
+		{
+			return false;
+		}
+
+		TrajectoryHeader header;
+		std::memcpy(&header, File.GetData(), sizeof(header));
+		if (std::memcmp(header.Magic, TrajectoryMagic, sizeof(TrajectoryMagic)) != 0 || header.Version != TrajectoryVersion ||
+			header.PositionBits == 0 || header.PositionBits > 32)
+		{
+			return false;
+		}
+
+		const double maxQuantized = static_cast<double>((1ull << header.PositionBits) - 1);
+
+		//frame headers aren't aligned in the file, so they're copied out rather than read in place
+		const unsigned char* data = File.GetData();
+		const uint64_t size = File.GetSize();
+		uint64_t offset = sizeof(TrajectoryHeader);
+		while (size - offset >= sizeof(TrajectoryFrameHeader))
+		{
+			TrajectoryFrameHeader frame;
+			std::memcpy(&frame, data + offset, sizeof(frame));
+			offset += sizeof(frame);
+			if (frame.PayloadSize > size - offset)
+			{
+				break;
+			}
+
+			FrameEntry entry;
+			entry.Payload = data + offset;
+			entry.PayloadSize = frame.PayloadSize;
+			entry.NumObjects = frame.NumObjects;
+			entry.bKeyframe = frame.bKeyframe != 0;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				entry.BoundsMin[axis] = frame.BoundsMin[axis];
+				entry.DequantizationScale[axis] = std::max(static_cast<double>(frame.BoundsMax[axis]) - frame.BoundsMin[axis], 1e-6) / maxQuantized;
+			}
+			Frames.push_back(entry);
+			offset += frame.PayloadSize;
+		}
+
+		//the recorder always starts on a keyframe, anything else isn't one of its files
+		return !Frames.empty() && Frames.front().bKeyframe;
+	}
+
+	size_t TrajectoryReader::GetNumFrames() const
+	{
+		return Frames.size();
+	}
+
+	bool TrajectoryReader::ReadFrame(size_t Frame, simd_vector<Vector4>& OutPositions)
+	{
+		if (Frame >= Frames.size())
+		{
+			return false;
+		}
+
+		size_t keyframe = Frame;
+		while (!Frames[keyframe].bKeyframe)
+		{
+			--keyframe;
+		}
+
+		//carry on from the last frame read if it's on the way, rather than going back to the keyframe
+		const bool bContinue = CurrentFrame != InvalidObjectIndex && CurrentFrame >= keyframe && CurrentFrame <= Frame;
+		for (size_t frame = bContinue ? CurrentFrame + 1 : keyframe; frame <= Frame; ++frame)
+		{
+			if (!DecodeFrame(frame))
+			{
+				CurrentFrame = InvalidObjectIndex;
+				return false;
+			}
+		}
+
+		const FrameEntry& entry = Frames[Frame];
+		const size_t numObjects = entry.NumObjects;
+		OutPositions.resize(numObjects);
+		for (size_t object = 0; object < numObjects; ++object)
+		{
+			const uint32_t* quantized = &CurrentQuantized[object * 3];
+			OutPositions[object] = Vector4(
+				static_cast<float>(entry.BoundsMin[0] + quantized[0] * entry.DequantizationScale[0]),
+				static_cast<float>(entry.BoundsMin[1] + quantized[1] * entry.DequantizationScale[1]),
+				static_cast<float>(entry.BoundsMin[2] + quantized[2] * entry.DequantizationScale[2]));
+		}
+		return true;
+	}
+
+	bool TrajectoryReader::DecodeFrame(size_t Frame)
+	{
+		const FrameEntry& entry = Frames[Frame];
+		const size_t numValues = static_cast<size_t>(entry.NumObjects) * 3;
+		if (!entry.bKeyframe && CurrentQuantized.size() != numValues)
+		{
+			return false;
+		}
+
+		Decoded.resize(numValues);
+		if (!DecodeValues(entry.Payload, entry.Payload + entry.PayloadSize, Decoded))
+		{
+			return false;
+		}
+
+		if (entry.bKeyframe)
+		{
+			std::swap(CurrentQuantized, Decoded);
+		}
+		else
+		{
+			for (size_t value = 0; value < numValues; ++value)
+			{
+				CurrentQuantized[value] += UnZigZag(Decoded[value]);
+			}
+		}
+
+		CurrentFrame = Frame;
+		return true;
+	}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <atomic>
+
+#include "../Core/MappedFile.hpp"
+#include "Types.hpp"
+
+namespace Physics
+{
+	//Recordings of every object's position, one frame per physics frame. Positions are fixed point across bounds fitted to
+	//the objects at each keyframe, stored absolute in keyframes and as the difference from the previous frame in between.
+	//An object leaving the bounds starts a new keyframe early, so only non-finite positions are ever clamped. Each frame's
+	//values are packed as variable-length integers, with runs of zeros - anything that didn't move - collapsed.
+
+	const uint32_t TrajectoryVersion = 2;
+
+	struct TrajectoryHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t PositionBits;
+	};
+
+	//the bounds are the keyframe's, repeated in the frames after it
+	struct TrajectoryFrameHeader
+	{
+		uint32_t NumObjects;
+		uint32_t bKeyframe;
+		uint64_t PayloadSize;
+		float BoundsMin[3];
+		float BoundsMax[3];
+	};
+
+	//Encodes and writes frames on a background thread. Frames wait for it in a fixed pool of buffers, so memory stays bounded -
+	//if the writer falls that far behind, RecordFrame blocks until it catches up rather than dropping frames.
+	class TrajectoryRecorder
+	{
+	public:
+		//a keyframe every KeyframeInterval frames bounds how far back a seek has to start decoding
+		TrajectoryRecorder(size_t KeyframeInterval = 60, size_t MaxQueuedFrames = 8);
+		TrajectoryRecorder(const TrajectoryRecorder& other) = delete;
+		~TrajectoryRecorder();
+
+		//writes the header and starts the writer thread
+		bool Open(const std::string& Path);
+
+		//copies out the positions, everything else happens on the writer thread
+		//bObjectsChanged forces a keyframe, for when objects have moved to other indices since the last frame
+		void RecordFrame(const simd_vector<PhysicsObject>& Objects, bool bObjectsChanged);
+
+		//finishes writing whatever is queued and stops the writer thread, false if any write failed
+		bool Close();
+
+		//coordinates written as the nearest bound because they were infinite or NaN, so far
+		uint64_t GetNumClampedValues() const;
+
+	private:
+
+		struct QueuedFrame
+		{
+			simd_vector<Core::Vector4> Positions;
+			bool bForceKeyframe;
+		};
+
+		void WriteFrames();
+		void EncodeFrame(const QueuedFrame& Frame);
+
+		//fit the bounds around Positions for a new keyframe
+		void FitBounds(const simd_vector<Core::Vector4>& Positions);
+		//into Quantized across the current bounds, false if a position is outside them
+		bool Quantize(const simd_vector<Core::Vector4>& Positions);
+
+		//the current keyframe's - plain arrays rather than vectors, so a heap-allocated recorder doesn't need aligned new
+		//the scale is a double, in float the rounding far from the origin costs a few steps of the fixed point
+		float BoundsMin[3];
+		float BoundsMax[3];
+		double QuantizationScale[3];
+		size_t KeyframeInterval;
+
+		std::ofstream File;
+		std::thread Writer;
+		bool bOpen;
+		bool bClosing;
+		bool bFailed;
+		std::atomic<uint64_t> NumClampedValues;
+
+		//buffers go from free to queued on the simulation thread, and back once the writer thread is done with them
+		std::vector<QueuedFrame> Frames;
+		std::vector<size_t> FreeFrames;
+		std::deque<size_t> QueuedFrames;
+		std::mutex QueueMutex;
+		std::condition_variable QueueChanged;
+
+		//writer thread only
+		std::vector<uint32_t> Quantized;
+		std::vector<uint32_t> PreviousQuantized;
+		std::vector<unsigned char> Encoded;
+		size_t FramesSinceKeyframe;
+	};
+
+	//Random access to a recording - a frame is decoded from the keyframe before it, or straight on from the last one read.
+	class TrajectoryReader
+	{
+	public:
+		TrajectoryReader();
+
+		//maps the file and indexes every frame, a recording cut off partway through a frame reads up to the last whole one
+		bool Open(const std::string& Path);
+
+		size_t GetNumFrames() const;
+
+		//positions in the frame's object order, false if Frame is out of range or its data is corrupt
+		bool ReadFrame(size_t Frame, simd_vector<Core::Vector4>& OutPositions);
+
+	private:
+
+		bool DecodeFrame(size_t Frame);
+
+		struct FrameEntry
+		{
+			const unsigned char* Payload;
+			uint64_t PayloadSize;
+			uint32_t NumObjects;
+			bool bKeyframe;
+			double BoundsMin[3];
+			double DequantizationScale[3];
+		};
+
+		Core::MappedFile File;
+		std::vector<FrameEntry> Frames;
+
+		//last frame decoded, still quantized
+		size_t CurrentFrame;
+		std::vector<uint32_t> CurrentQuantized;
+		std::vector<uint32_t> Decoded;
+	};
+}
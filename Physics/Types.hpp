@@ -2,23 +2,109 @@
 #define TYPES_HPP
 
 #include <vector>
+#include <cstdint>
+#include <functional>
 
 #include "../Core/AlignedAllocator.hpp"
 #include "../Core/Vector4.hpp"
 
-template<typename value_type> using simd_vector = std::vector<value_type, aligned_allocator<value_type, 16>>;
+//big ones (the state buffers, contacts and so on) get huge pages, see large_page_allocator
+template<typename value_type> using simd_vector = std::vector<value_type, large_page_allocator<value_type, 16>>;
 
 namespace Physics
 {
+	//parameters for everything but spheres live in per-type buckets, see Shapes.hpp
+	enum class ShapeType : unsigned char
+	{
+		Sphere,
+		Capsule,
+		Box,
+		Plane,
+		Mesh
+	};
+	const size_t ShapeTypeCount = 5;
+
+	//static world geometry that's kept out of the octree and queried separately
+	inline bool IsWorldShape(ShapeType Shape)
+	{
+		return Shape == ShapeType::Plane || Shape == ShapeType::Mesh;
+	}
+
 	struct PhysicsObject
 	{
 		Core::Vector4 Position;
 		Core::Vector4 Velocity;
 		Core::Vector4 Color;
-		//just spheres for now, subclass for other shapes later (CollidesWith(other) method)
-		float CollisionRadius;
-		size_t Index; //TODO eww
+		Core::Vector4 Force; //external forces applied this frame, held through the step and cleared by integration
+		float CollisionRadius; //bounding sphere for the broadphase, the actual radius for spheres
+		float InverseMass; //0 for immovable objects
+		float Restitution;
+		float SleepTimer; //seconds spent below the sleep speed threshold
+		size_t Index; //dense index, changes when other objects are removed - hold an ObjectHandle to keep track of an object
+		size_t SleepIsland; //key of the sleeping island this object belongs to, only valid while asleep
+		bool bAsleep;
+		ShapeType Shape;
+		size_t ShapeIndex; //into the bucket for Shape, unused for spheres
 	};
+
+	typedef std::pair<PhysicsObject*, PhysicsObject*> CollisionPair;
+	//on cache line boundaries, and on huge pages once it gets big
+	typedef std::vector<CollisionPair, large_page_allocator<CollisionPair, 64>> CollisionPairList;
+
+	//stable reference to an object, see ObjectHandleTable
+	struct ObjectHandle
+	{
+		uint32_t Slot;
+		uint32_t Generation;
+	};
+
+	//never valid, for results with no object to point at
+	const ObjectHandle InvalidObjectHandle = { ~0u, 0 };
+
+	//per-object parameters filled in by a bulk spawn generator, preset to a unit sphere at rest
+	struct SpawnParameters
+	{
+		Core::Vector4 Position;
+		Core::Vector4 Velocity;
+		float Radius;
+		float Mass;
+		float Restitution;
+	};
+
+	//called with the object's number in the batch, from the manager's worker threads
+	typedef std::function<void(size_t, SpawnParameters&)> SpawnGenerator;
+
+	//removed objects in a remap table, and lookups of handles that don't have an object (yet)
+	const size_t InvalidObjectIndex = ~static_cast<size_t>(0);
+
+	//[Begin, End) slice of some other array, for jobs that work on batches instead of single elements
+	struct BatchRange
+	{
+		size_t Begin;
+		size_t End;
+	};
+
+	//a single contact, built from a collision pair and consumed by the contact solver
+	struct Contact
+	{
+		Core::Vector4 Normal; //from B to A
+		Core::Vector4 RelativePosition; //A - B when the normal was last computed
+		size_t IndexA;
+		size_t IndexB;
+		float Penetration;
+		float BasePenetration; //Penetration at RelativePosition, reused contacts measure from this
+		float NormalMass; //1 / (inverse mass A + inverse mass B)
+		float VelocityBias; //target separating speed from restitution and positional correction
+		float NormalImpulse; //accumulated across iterations, cached for warm starting
+	};
+
+	//order-independent key for a pair of object indices
+	inline uint64_t MakePairKey(size_t IndexA, size_t IndexB)
+	{
+		const uint64_t low = IndexA < IndexB ? IndexA : IndexB;
+		const uint64_t high = IndexA < IndexB ? IndexB : IndexA;
+		return (high << 32) | low;
+	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../Physics/Regression.hpp"
+
+using namespace Physics;
+
+struct NamedConfiguration
+{
+	std::string Name;
+	RegressionConfiguration Configuration;
+};
+
+static NamedConfiguration MakeConfiguration(const std::string& Name, int NumThreads, bool bDeterministic, std::function<void(PhysicsManager&)> Configure = nullptr)
+{
+	NamedConfiguration named;
+	named.Name = Name;
+	named.Configuration.NumThreads = NumThreads;
+	named.Configuration.bDeterministic = bDeterministic;
+	named.Configuration.Configure = Configure;
+	return named;
+}
+
+//Runs the seeded regression scene in every configuration that has to match the single threaded deterministic reference,
+//and exits with 1 if any of them doesn't - for running after a build. Arguments, all optional: threads, objects, frames.
+//Only deterministic runs are checked, without it the contact order changes between runs and a long enough scene drifts apart.
+//The threaded runs get at least two threads, so they go through the parallel paths, the island by island solve included.
+int main(int argc, char** argv)
+{
+	const int numThreads = std::max(argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency()), 2);
+
+	RegressionScene scene;
+	if (argc > 2)
+	{
+		scene.NumObjects = std::strtoul(argv[2], nullptr, 10);
+	}
+	if (argc > 3)
+	{
+		scene.NumFrames = std::strtoul(argv[3], nullptr, 10);
+	}
+
+	auto grid = [](PhysicsManager& manager)
+	{
+		manager.SetBroadphase(BroadphaseType::HierarchicalGrid);
+	};
+
+	std::vector<NamedConfiguration> configurations;
+	configurations.push_back(MakeConfiguration("single thread", 1, true));
+	configurations.push_back(MakeConfiguration("threaded", numThreads, true));
+	configurations.push_back(MakeConfiguration("threaded, hierarchical grid", numThreads, true, grid));
+
+	size_t numFailed = 0;
+	for (auto& named : configurations)
+	{
+		std::cout << named.Name << " (" << named.Configuration.NumThreads << " threads)" << std::endl;
+		const RegressionReport report = RunRegression(scene, named.Configuration, RegressionTolerances());
+		PrintRegressionReport(report, std::cout);
+		if (!report.bPassed)
+		{
+			++numFailed;
+		}
+	}
+
+	std::cout << configurations.size() - numFailed << " of " << configurations.size() << " configurations passed" << std::endl;
+	return numFailed == 0 ? 0 : 1;
+}